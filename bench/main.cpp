@@ -0,0 +1,44 @@
+#include <benchmarks.hpp>
+#include <dispatch.hpp>
+#include <iostream>
+#include <string>
+
+// usage: cltvt_bench [label] [--quick]
+// Writes tests/benchmark_<label>.csv, label being e.g. a commit hash so that runs of several commits can be compared.
+int main(int argc, char* argv[])
+{
+    using namespace cltvt;
+
+    std::string label = "latest";
+    BenchmarkSettings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--quick")
+        {
+            settings.num_time_steps = { 1000, 10000 };
+            settings.step_budget = 2000000;
+            settings.repetitions = 1;
+        }
+        else
+            label = arg;
+    }
+
+    // CLTVT_SIMD_ISA=scalar, avx2 or avx512 forces the kernels, e.g. to compare the variants.
+    std::cout << "SIMD kernels: " << simd_isa_name(simd_isa()) << std::endl;
+
+    std::vector<BenchmarkResult> results;
+    for (const auto& benchmark : {
+        benchmark_normals,
+        benchmark_paths,
+        benchmark_vt_simulation,
+        benchmark_special_functions,
+        benchmark_black_scholes })
+    {
+        const std::vector<BenchmarkResult> part = benchmark(settings);
+        results.insert(results.end(), part.begin(), part.end());
+    }
+
+    write_benchmark_results(results, label, root_dir() + "/tests/benchmark_" + label + ".csv");
+    return 0;
+}
\ No newline at end of file
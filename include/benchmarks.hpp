@@ -0,0 +1,57 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <string>
+#include <vector>
+
+namespace cltvt
+{
+    // One timed measurement: the best time over the repetitions of a run processing num_items items (normals, steps,
+    // prices, ...) of the given unit. Path benchmarks count time steps as items and also give num_paths paths of
+    // num_steps steps, other benchmarks have num_paths = 0.
+    struct BenchmarkResult
+    {
+        std::string name;
+        std::string variant;
+        size_t num_steps;
+        size_t num_threads;
+        size_t num_paths;
+        size_t num_items;
+        std::string unit;
+        double seconds;
+
+        double ns_per_item() const;
+
+        double items_per_second() const;
+
+        double paths_per_second() const;
+    };
+
+    struct BenchmarkSettings
+    {
+        // Numbers of time steps of the path benchmarks.
+        std::vector<size_t> num_time_steps;
+        // Thread counts of the scaling benchmarks, powers of two up to the number of hardware threads if empty.
+        std::vector<size_t> num_threads;
+        // Time steps simulated by each run of a path benchmark, the number of paths being step_budget / N.
+        size_t step_budget;
+        size_t repetitions;
+
+        BenchmarkSettings();
+    };
+
+    std::vector<BenchmarkResult> benchmark_normals(const BenchmarkSettings& settings);
+
+    std::vector<BenchmarkResult> benchmark_paths(const BenchmarkSettings& settings);
+
+    // Sequential, parallel and batch VT simulation for each N and thread count, the parallel simulation of
+    // ModelVolatilityTarget<BlackScholesStepper> through its concrete type (model) and AnyVolatilityTarget (any_model),
+    // its batch simulation (model_batch), and the parallel and batch simulations on Heston (heston, heston_batch).
+    std::vector<BenchmarkResult> benchmark_vt_simulation(const BenchmarkSettings& settings);
+
+    std::vector<BenchmarkResult> benchmark_special_functions(const BenchmarkSettings& settings);
+
+    std::vector<BenchmarkResult> benchmark_black_scholes(const BenchmarkSettings& settings);
+
+    // Prints results as a table and writes them, with label (e.g. a commit hash) in the first column, to a CSV file.
+    void write_benchmark_results(const std::vector<BenchmarkResult>& results, const std::string& label, const std::string& path);
+}
\ No newline at end of file
@@ -1,65 +1,190 @@
-#pragma once
-#include <preliminaries.hpp>
-#include <vector>
-#include <memory>
-
-namespace cltvt
-{
-    class BlackScholes;
-    typedef std::shared_ptr<BlackScholes> BlackScholesPtr;
-
-    class BlackScholes
-    {
-    public:
-        BlackScholes(
-            const double discount_rate,
-            const double repo_rate,
-            const double volatility,
-            const double init_level = 1.0
-        );
-
-        static BlackScholesPtr create(
-            const double discount_rate,
-            const double repo_rate,
-            const double volatility,
-            const double init_level = 1.0
-        );
-
-        double discount_rate() const;
-
-        double repo_rate() const;
-
-        double volatility() const;
-
-        double init_level() const;
-
-        double get_call_price(const double strike, const double tenor) const;
-
-        double get_put_price(const double strike, const double tenor) const;
-
-        double get_vega(const double strike, const double tenor) const;
-
-        double get_call_rho(const double strike, const double tenor) const;
-
-        double get_put_rho(const double strike, const double tenor) const;
-
-        void populate_path(
-            std::vector<double>& stock_path, 
-            const std::vector<double>& dtimes,
-            const std::vector<double>& random_normals
-        ) const;
-
-        void simulate_stock_levels(
-            std::vector<double>& stock_levels,
-            const std::vector<double>& dtimes,
-            const size_t num_samples,
-            const size_t seed = DEFAULT_RNG_SEED
-        ) const;
-
-    private:
-        double m_discount_rate;
-        double m_repo_rate;
-        double m_volatility;
-        double m_init_level;
-    };
+#pragma once
+#include <preliminaries.hpp>
+#include <random_number_generator.hpp>
+#include <quasi_random.hpp>
+#include <statistics.hpp>
+#include <vector>
+#include <memory>
+
+namespace cltvt
+{
+    class BlackScholes;
+    typedef std::shared_ptr<BlackScholes> BlackScholesPtr;
+
+    // Price and sensitivities of an option, the repo rate being the dividend yield: rho and repo_rho are the derivatives
+    // with respect to the discount and repo rates, and theta is minus the derivative with respect to the tenor.
+    struct BlackScholesGreeks
+    {
+        double price;
+        double delta;
+        double gamma;
+        double vega;
+        double rho;
+        double repo_rho;
+        double theta;
+    };
+
+    // Discounted Black prices of calls and puts with forwards[i], strikes[i], total volatilities sigma sqrt(T) and
+    // discount factors[i], several at a time with the SIMD kernels selected at runtime and simd::normal_cdf.
+    void black_call_prices(
+        const double* forwards,
+        const double* strikes,
+        const double* total_vols,
+        const double* discount_factors,
+        double* prices,
+        const size_t size
+    );
+
+    void black_put_prices(
+        const double* forwards,
+        const double* strikes,
+        const double* total_vols,
+        const double* discount_factors,
+        double* prices,
+        const size_t size
+    );
+
+    class BlackScholes
+    {
+    public:
+        BlackScholes(
+            const double discount_rate,
+            const double repo_rate,
+            const double volatility,
+            const double init_level = 1.0
+        );
+
+        static BlackScholesPtr create(
+            const double discount_rate,
+            const double repo_rate,
+            const double volatility,
+            const double init_level = 1.0
+        );
+
+        double discount_rate() const;
+
+        double repo_rate() const;
+
+        double volatility() const;
+
+        double init_level() const;
+
+        double get_call_price(const double strike, const double tenor) const;
+
+        double get_put_price(const double strike, const double tenor) const;
+
+        // Prices of (strikes[i], tenors[i]), i < size, with the batch Black kernel. They agree with get_call_price and
+        // get_put_price to about 1e-15, the normal CDF being computed differently.
+        void get_call_prices(const double* strikes, const double* tenors, double* prices, const size_t size) const;
+
+        void get_put_prices(const double* strikes, const double* tenors, double* prices, const size_t size) const;
+
+        // prices[i * strikes.size() + j] is the price of strikes[j] at tenors[i]. The forward, discount factor and total
+        // volatility are computed once per tenor.
+        void get_call_price_surface(
+            const std::vector<double>& strikes,
+            const std::vector<double>& tenors,
+            std::vector<double>& prices
+        ) const;
+
+        void get_put_price_surface(
+            const std::vector<double>& strikes,
+            const std::vector<double>& tenors,
+            std::vector<double>& prices
+        ) const;
+
+        // Closed-form Greeks, all from one computation of d1 and d2, and with the price of the batch Black kernel.
+        BlackScholesGreeks get_call_greeks(const double strike, const double tenor) const;
+
+        BlackScholesGreeks get_put_greeks(const double strike, const double tenor) const;
+
+        // greeks[i] are the Greeks of (strikes[i], tenors[i]), i < size.
+        void get_call_greeks(const double* strikes, const double* tenors, BlackScholesGreeks* greeks, const size_t size) const;
+
+        void get_put_greeks(const double* strikes, const double* tenors, BlackScholesGreeks* greeks, const size_t size) const;
+
+        // Vega of a call or a put.
+        double get_vega(const double strike, const double tenor) const;
+
+        // Minus the derivative with respect to the repo rate, i.e. -get_call_greeks(strike, tenor).repo_rho.
+        double get_call_rho(const double strike, const double tenor) const;
+
+        double get_put_rho(const double strike, const double tenor) const;
+
+        // Volatility at which the model, with its rates and initial level, gives price, e.g. to quote Monte Carlo prices
+        // in volatility. Accurate to about 1e-12 relative plus 1e-14 * price / (vega * volatility), the effect of the
+        // rounding of the price, which dominates in the money with little time value and near the upper bound. Prices
+        // at or below the intrinsic value give 0, prices at or above the upper bound (discounted forward or strike) give
+        // INF, both up to a few roundings of the price.
+        double get_call_implied_volatility(const double price, const double strike, const double tenor) const;
+
+        double get_put_implied_volatility(const double price, const double strike, const double tenor) const;
+
+        // volatilities[i] is the implied volatility of prices[i] at (strikes[i], tenors[i]), i < size.
+        void get_call_implied_volatilities(
+            const double* prices,
+            const double* strikes,
+            const double* tenors,
+            double* volatilities,
+            const size_t size
+        ) const;
+
+        void get_put_implied_volatilities(
+            const double* prices,
+            const double* strikes,
+            const double* tenors,
+            double* volatilities,
+            const size_t size
+        ) const;
+
+        void populate_path(
+            std::vector<double>& stock_path, 
+            const std::vector<double>& dtimes,
+            const std::vector<double>& random_normals
+        ) const;
+
+        // Writes the size + 1 levels of the path to stock_path, e.g. an array of a SimulationWorkspace.
+        void populate_path(double* stock_path, const double* dtimes, const double* normals, const size_t size) const;
+
+        double simulate_stock_level(StandardNormalGenerator& rng, const std::vector<double>& dtimes) const;
+
+        double simulate_stock_level(const PathNormalGenerator& rng, const size_t path, const std::vector<double>& dtimes) const;
+
+        // Stock level along the next path of rng, which must have been built on dtimes.
+        double simulate_stock_level(SobolPathGenerator& rng, const std::vector<double>& dtimes) const;
+
+        void simulate_stock_levels(
+            std::vector<double>& stock_levels,
+            const std::vector<double>& dtimes,
+            const size_t num_samples,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Sample i is path i of PathNormalGenerator(seed), independently of num_threads (0 means all hardware threads).
+        void simulate_stock_levels_parallel(
+            std::vector<double>& stock_levels,
+            const std::vector<double>& dtimes,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Randomised quasi-Monte Carlo: replications[r] receives the levels of num_samples paths of
+        // SobolPathGenerator(dtimes, seed, r), see VolatilityTarget::simulate_vt_levels_sobol.
+        void simulate_stock_levels_sobol(
+            const std::vector<AccumulatorPtr>& replications,
+            const std::vector<double>& dtimes,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+    private:
+        double evolve_level(double level, const double* dtimes, const double* normals, const size_t size) const;
+
+        double m_discount_rate;
+        double m_repo_rate;
+        double m_volatility;
+        double m_init_level;
+    };
 }
\ No newline at end of file
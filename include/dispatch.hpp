@@ -0,0 +1,202 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <cstdint>
+#include <string>
+
+namespace cltvt
+{
+    struct BlackScholesGreeks;
+    struct HestonQEStep;
+
+    // Instruction sets of the kernel variants. SCALAR is the reference, one value at a time, and runs anywhere.
+    enum class SimdIsa
+    {
+        SCALAR,
+        AVX2,
+        AVX512
+    };
+
+    // Widest lane count of any variant. Kernels that work on whole lanes take lane counts that are multiples of it.
+    const size_t MAX_SIMD_WIDTH = 8;
+
+    // The vectorised kernels of the library, compiled once per instruction set (simd_kernels_*.cpp, see
+    // simd_kernels.hpp). Kernels taking a size handle every item, the remainder included; those taking num_lanes need
+    // a multiple of width. Only correctly rounded operations are used and the variants are compiled without FMA
+    // contraction (see simd.hpp), so every variant gives the same bits. test_simd_dispatch checks it.
+    struct SimdKernels
+    {
+        SimdIsa isa;
+        size_t width;
+
+        // Normals from 64 random bits each, through Vec::load_uniform and the inverse normal CDF.
+        void (*normals_from_bits)(const uint64_t* bits, double* out, const size_t size);
+        // out may be p.
+        void (*inverse_normal_cdf)(const double* p, double* out, const size_t size);
+        // out may be x.
+        void (*exp)(const double* x, double* out, const size_t size);
+
+        void (*black_prices)(
+            const bool call,
+            const double* forwards,
+            const double* strikes,
+            const double* total_vols,
+            const double* discount_factors,
+            double* prices,
+            const size_t size
+        );
+        // Prices of one tenor, given by its forward, total volatility and discount factor, for every strike.
+        void (*black_strike_prices)(
+            const bool call,
+            const double forward,
+            const double total_vol,
+            const double discount_factor,
+            const double* strikes,
+            double* prices,
+            const size_t size
+        );
+        void (*black_scholes_greeks)(
+            const bool call,
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const double volatility,
+            const double* strikes,
+            const double* tenors,
+            BlackScholesGreeks* greeks,
+            const size_t size
+        );
+        void (*black_scholes_implied_volatilities)(
+            const bool call,
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const double* prices,
+            const double* strikes,
+            const double* tenors,
+            double* volatilities,
+            const size_t size
+        );
+
+        // num_steps steps of num_lanes VT paths with the same parameters, normals holding num_steps rows of num_lanes.
+        void (*advance_vt_lanes)(
+            double* levels,
+            double* vars,
+            const double* normals,
+            const size_t num_steps,
+            const size_t num_lanes,
+            const double drift_dt,
+            const double vol_sqrt_dt,
+            const double rate_dt,
+            const double target_vol,
+            const double lamb,
+            const double var_weight
+        );
+        // num_steps steps of num_lanes VT paths with the same parameters on their own stock returns, rets holding
+        // num_steps rows of num_lanes.
+        void (*advance_vt_returns)(
+            double* levels,
+            double* vars,
+            const double* rets,
+            const size_t num_steps,
+            const size_t num_lanes,
+            const double rate_dt,
+            const double target_vol,
+            const double lamb,
+            const double var_weight
+        );
+        // num_steps steps of num_lanes VT strategies with their own parameters on the same stock returns.
+        void (*advance_vt_sweep)(
+            double* levels,
+            double* vars,
+            const double* rets,
+            const size_t num_steps,
+            const size_t num_lanes,
+            const double rate_dt,
+            const double* target_vols,
+            const double* lambs,
+            const double* var_weights
+        );
+        // Same with the derivatives with respect to the volatility and the discount rate, see
+        // VolatilityTargetSweep::advance_vt_path_derivatives for the layout of state and d_rets.
+        void (*advance_vt_derivatives)(
+            double* state,
+            const size_t num_lanes,
+            const double* rets,
+            const double* d_rets,
+            const size_t num_steps,
+            const double dt,
+            const double rate_dt,
+            const double* target_vols,
+            const double* lambs,
+            const double* var_weights
+        );
+
+        // Black-Scholes stock returns expm1(drift_dt + vol_sqrt_dt * normals[i]). out may be normals.
+        void (*lognormal_returns)(
+            const double* normals,
+            double* out,
+            const size_t size,
+            const double drift_dt,
+            const double vol_sqrt_dt
+        );
+        // See HestonQEStep::advance_lanes.
+        void (*advance_heston_lanes)(
+            const HestonQEStep* step,
+            double* vars,
+            double* rets,
+            const double* normals,
+            const size_t num_steps,
+            const size_t num_lanes
+        );
+
+        // log (a[i]; q)_infinity from the tables of QPochhammer.
+        void (*q_pochhammer_log)(
+            const double* a,
+            double* out,
+            const size_t size,
+            const double q,
+            const double log_q,
+            const double* powers,
+            const size_t num_powers,
+            const double* coeffs,
+            const size_t num_coeffs
+        );
+
+        // exp of the Chebyshev series of LimitMultipliers at x = -u_scale log(lambda) - 1. us or vs may be nullptr.
+        void (*limit_multipliers)(
+            const double* lambdas,
+            double* us,
+            double* vs,
+            const size_t size,
+            const double u_scale,
+            const double* log_u_coeffs,
+            const double* log_v_coeffs,
+            const size_t num_coeffs
+        );
+    };
+
+    std::string simd_isa_name(const SimdIsa isa);
+
+    // True if the variant was compiled in and the CPU and the OS support its instruction set.
+    bool simd_isa_available(const SimdIsa isa);
+
+    // Widest available instruction set.
+    SimdIsa detect_simd_isa();
+
+    // Instruction set of the kernels in use: detect_simd_isa(), unless the environment variable CLTVT_SIMD_ISA (scalar,
+    // avx2 or avx512) names an available one when the kernels are first used, or set_simd_isa forced one.
+    SimdIsa simd_isa();
+
+    // Forces the variant of every kernel, e.g. to compare it with the scalar reference. Throws if isa is not available.
+    // Must not be called while kernels are running.
+    void set_simd_isa(const SimdIsa isa);
+
+    const SimdKernels& simd_kernels();
+
+    const SimdKernels& scalar_kernels();
+
+    // nullptr when the library was built without the variant.
+    const SimdKernels* avx2_kernels();
+
+    const SimdKernels* avx512_kernels();
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <volatility_target.hpp>
+#include <random_number_generator.hpp>
+#include <vector>
+
+namespace cltvt
+{
+    // Estimate extrapolated to N -> infinity from the estimates on a ladder of num_time_steps.
+    struct ExtrapolatedEstimate
+    {
+        double value;
+        double standard_error;
+        // Confidence interval of value, which only accounts for the Monte Carlo error, not for the error terms left out
+        // of the fit: residuals much larger than the standard errors mean the orders should be revised.
+        double lower;
+        double upper;
+        // Coefficients c_j of the fit Q(N) = value + sum_j c_j N^(-orders[j]).
+        std::vector<double> coefficients;
+
+        // Estimates on the ladder, their standard errors, and their residuals from the fit.
+        std::vector<size_t> num_time_steps;
+        std::vector<double> estimates;
+        std::vector<double> standard_errors;
+        std::vector<double> residuals;
+    };
+
+    // Richardson extrapolation of VT estimates over a geometric ladder of num_time_steps. Every path is simulated on
+    // all grids at once with common random numbers: the normal of a grid's step is the sum of the normals of the
+    // finest steps it spans divided by the square root of their number, so all grids follow the same stock path and
+    // the differences between their estimates are far less noisy than the estimates themselves.
+    //
+    // Q(N) = Q_infinity + sum_j c_j N^(-orders[j]) is fitted to the ladder by least squares. The extrapolated value is
+    // a fixed linear combination of the estimates on the ladder, so its standard error is that of the per-path
+    // combination of the grids' samples (linearised for the volatility).
+    class VolatilityTargetLadder
+    {
+    public:
+        // Grids of target.num_time_steps() / ratio^(num_grids - 1), ..., target.num_time_steps() steps, which must be
+        // divisible by ratio^(num_grids - 1).
+        VolatilityTargetLadder(const VolatilityTarget& target, const size_t num_grids, const size_t ratio = 2);
+
+        size_t num_grids() const;
+
+        // Strategy of grid k, the finest being num_grids() - 1.
+        const VolatilityTarget& grid(const size_t k) const;
+
+        // Price of a call on the VT level. orders holds the exponents of the error terms, e.g. { 1.0 } for an error in
+        // 1 / N or { 0.5, 1.0 } to add a term in 1 / sqrt(N), and there must be fewer of them than grids. Sample i is
+        // path i of PathNormalGenerator(seed) on the finest grid, so the estimate does not depend on num_threads.
+        ExtrapolatedEstimate extrapolate_call_price(
+            const double strike,
+            const size_t num_samples,
+            const std::vector<double>& orders = std::vector<double>(1, 1.0),
+            const double confidence = 0.95,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Volatility of the VT level, sqrt(Var(log level) / tenor).
+        ExtrapolatedEstimate extrapolate_volatility(
+            const size_t num_samples,
+            const std::vector<double>& orders = std::vector<double>(1, 1.0),
+            const double confidence = 0.95,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+    private:
+        enum class Quantity
+        {
+            CALL_PRICE,
+            VOLATILITY
+        };
+
+        ExtrapolatedEstimate extrapolate(
+            const Quantity quantity,
+            const double strike,
+            const size_t num_samples,
+            const std::vector<double>& orders,
+            const double confidence,
+            const size_t num_threads,
+            const size_t seed
+        ) const;
+
+        // Levels of VolatilityTarget::BATCH_LANES paths starting at first_path on every grid. levels and vars hold one
+        // row of lanes per grid and normals chunk_steps() rows of lanes.
+        void simulate_batch(
+            const PathNormalGenerator& rng,
+            const size_t first_path,
+            double* levels,
+            double* vars,
+            double* normals
+        ) const;
+
+        // Finest steps simulated at a time, a multiple of the steps spanned by a step of the coarsest grid.
+        size_t chunk_steps() const;
+
+        std::vector<VolatilityTarget> m_grids;
+        size_t m_ratio;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <special_functions.hpp>
+#include <cmath>
+#include <vector>
+#include <memory>
+
+namespace cltvt
+{
+    class Heston;
+    typedef std::shared_ptr<Heston> HestonPtr;
+
+    // Constants of a step of length dt of Andersen's quadratic-exponential (QE) scheme (Andersen, 2008), with
+    // gamma1 = gamma2 = 1/2, the switching value psi_c = 3/2 and the martingale correction, which makes the discounted
+    // stock an exact martingale of the discretisation. The correction needs 2 mgf_coeff scale < 1 and mgf_coeff < beta,
+    // with mgf_coeff = k2 + k4 / 2, which holds for every step when the correlation is not positive. With a positive
+    // correlation, steps from large variances can break it, and those fall back to the drift k0 + k1 var of the scheme
+    // without the correction, as Andersen suggests.
+    struct HestonQEStep
+    {
+        static const double PSI_C;
+
+        double drift_dt;
+        double rate_dt;
+        // The conditional mean of the next variance is decay * var + mean_shift and its variance
+        // var_s2 * var + const_s2.
+        double decay;
+        double mean_shift;
+        double var_s2;
+        double const_s2;
+        double k0;
+        double k1;
+        double k2;
+        double k3;
+        double k4;
+        double mgf_coeff;
+
+        // Simple return of the stock over the step, advancing var. normals[0] drives the variance and normals[1] the
+        // stock.
+        double advance(double& var, const double* normals) const
+        {
+            const double m = decay * var + mean_shift;
+            const double m2 = m * m;
+            const double s2 = var_s2 * var + const_s2;
+            double next_var;
+            // Log of E[exp(mgf_coeff next_var)], the martingale correction.
+            double log_mgf;
+            // psi = s2 / m^2 is only formed in the exponential branch, which small time steps rarely take.
+            if (s2 <= PSI_C * m2)
+            {
+                const double two_over_psi = 2.0 * m2 / s2;
+                const double b2 = two_over_psi - 1.0 + std::sqrt(two_over_psi * (two_over_psi - 1.0));
+                const double scale = m / (1.0 + b2);
+                const double x = std::sqrt(b2) + normals[0];
+                next_var = scale * x * x;
+                const double shrink = 1.0 - 2.0 * mgf_coeff * scale;
+                log_mgf = shrink > 0.0
+                    ? mgf_coeff * b2 * scale / shrink - 0.5 * std::log(shrink)
+                    : uncorrected_log_mgf(var);
+            }
+            else
+            {
+                const double p = (s2 - m2) / (s2 + m2);
+                const double beta = (1.0 - p) / m;
+                const double tail = normal_cdf(-normals[0]);
+                next_var = tail >= 1.0 - p ? 0.0 : std::log((1.0 - p) / tail) / beta;
+                log_mgf = beta > mgf_coeff
+                    ? std::log(p + beta * (1.0 - p) / (beta - mgf_coeff))
+                    : uncorrected_log_mgf(var);
+            }
+            const double log_return = drift_dt - log_mgf - 0.5 * k3 * var + k2 * next_var
+                + std::sqrt(k3 * var + k4 * next_var) * normals[1];
+            var = next_var;
+            return std::expm1(log_return);
+        }
+
+        // Value of log_mgf in advance that gives the uncorrected drift k0 + k1 var.
+        double uncorrected_log_mgf(const double var) const
+        {
+            return -k0 - (k1 + 0.5 * k3) * var;
+        }
+
+        // Advances num_lanes paths (a multiple of MAX_SIMD_WIDTH) by num_steps steps in structure-of-arrays layout, with
+        // the SIMD kernels selected at runtime. vars holds one value per lane, normals holds 2 * num_steps rows of
+        // num_lanes normals, the variance row of each step first, and rets receives num_steps rows of num_lanes simple
+        // stock returns. The values are those of advance up to rounding.
+        void advance_lanes(
+            double* vars,
+            double* rets,
+            const double* normals,
+            const size_t num_steps,
+            const size_t num_lanes
+        ) const;
+    };
+
+    // Heston model: dS / S = (r - q) dt + sqrt(v) dW, dv = kappa (theta - v) dt + xi sqrt(v) dZ with d<W, Z> = rho dt,
+    // r being the discount rate and q the repo rate. Paths are discretised with the QE scheme, so each step takes two
+    // normals: the first drives the variance and the second the stock.
+    class Heston
+    {
+    public:
+        Heston(
+            const double discount_rate,
+            const double repo_rate,
+            const double kappa,
+            const double theta,
+            const double vol_of_vol,
+            const double correlation,
+            const double init_var,
+            const double init_level = 1.0
+        );
+
+        static HestonPtr create(
+            const double discount_rate,
+            const double repo_rate,
+            const double kappa,
+            const double theta,
+            const double vol_of_vol,
+            const double correlation,
+            const double init_var,
+            const double init_level = 1.0
+        );
+
+        double discount_rate() const;
+
+        double repo_rate() const;
+
+        double kappa() const;
+
+        double theta() const;
+
+        double vol_of_vol() const;
+
+        double correlation() const;
+
+        double init_var() const;
+
+        double init_level() const;
+
+        HestonQEStep qe_step(const double dt) const;
+
+        // Expected variance at time t, theta + (init_var - theta) exp(-kappa t). The QE scheme matches it exactly.
+        double expected_var(const double t) const;
+
+        // random_normals holds 2 * dtimes.size() normals, those of step i at 2 * i and 2 * i + 1.
+        void populate_path(
+            std::vector<double>& stock_path,
+            const std::vector<double>& dtimes,
+            const std::vector<double>& random_normals
+        ) const;
+
+        // Writes the size + 1 stock levels of the path to stock_path and, if var_path is not nullptr, the size + 1
+        // variances to var_path.
+        void populate_path(
+            double* stock_path,
+            double* var_path,
+            const double* dtimes,
+            const double* normals,
+            const size_t size
+        ) const;
+
+    private:
+        double m_discount_rate;
+        double m_repo_rate;
+        double m_kappa;
+        double m_theta;
+        double m_vol_of_vol;
+        double m_correlation;
+        double m_init_var;
+        double m_init_level;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CLTVT_HAS_RDTSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+namespace cltvt
+{
+    // Phases of a simulation: drawing normals, building stock paths, the VT level and variance recursion, and
+    // storing or accumulating the results.
+    enum class SimulationPhase
+    {
+        RNG,
+        PATH,
+        VT_RECURSION,
+        OUTPUT
+    };
+
+    const size_t NUM_SIMULATION_PHASES = 4;
+
+    struct ThreadCounters
+    {
+        uint64_t cycles[NUM_SIMULATION_PHASES];
+        uint64_t paths;
+        uint64_t bytes_allocated;
+    };
+
+    struct InstrumentationReport
+    {
+        // Sums over the threads.
+        ThreadCounters total;
+        // One entry per thread that counted anything since the last reset, in the order the threads first counted.
+        std::vector<ThreadCounters> threads;
+
+        std::string to_json() const;
+
+        void write_json(const std::string& path) const;
+    };
+
+    // Counters of the simulate_vt_levels and simulate_stock_levels hot paths. They are only updated when the library
+    // is compiled with CLTVT_INSTRUMENTATION defined, otherwise the CLTVT_* macros below expand to the bare statements
+    // and report() is all zeros. Cycles are time stamp counter ticks (rdtsc) on x86 and steady_clock nanoseconds on
+    // other targets. reset and report must not run while a simulation is counting.
+    namespace instrumentation
+    {
+        inline uint64_t read_cycles()
+        {
+#ifdef CLTVT_HAS_RDTSC
+            return __rdtsc();
+#else
+            return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        // Counters of the calling thread, registered on first use.
+        ThreadCounters& thread_counters();
+
+        void reset();
+
+        InstrumentationReport report();
+    }
+}
+
+#ifdef CLTVT_INSTRUMENTATION
+#define CLTVT_TIME_PHASE(phase, statement) \
+    { \
+        const uint64_t cltvt_phase_start = cltvt::instrumentation::read_cycles(); \
+        statement; \
+        cltvt::instrumentation::thread_counters().cycles[size_t(phase)] += \
+            cltvt::instrumentation::read_cycles() - cltvt_phase_start; \
+    }
+#define CLTVT_COUNT_PATHS(n) cltvt::instrumentation::thread_counters().paths += (n)
+// Counts the bytes allocated by growing vector to size elements, to be used before the resize or reserve.
+#define CLTVT_COUNT_ALLOCATION(vector, size) \
+    { \
+        if ((vector).capacity() < (size)) \
+            cltvt::instrumentation::thread_counters().bytes_allocated += (size) * sizeof((vector)[0]); \
+    }
+#else
+#define CLTVT_TIME_PHASE(phase, statement) { statement; }
+#define CLTVT_COUNT_PATHS(n)
+#define CLTVT_COUNT_ALLOCATION(vector, size)
+#endif
\ No newline at end of file
@@ -1,7 +1,145 @@
-#pragma once
-#include <preliminaries.hpp>
-
-namespace cltvt
-{
-    double integrate(const Function& f, const double a, const double b, const size_t N = 5000);
+#pragma once
+#include <preliminaries.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace cltvt
+{
+    double integrate(const Function& f, const double a, const double b, const size_t N = 5000);
+
+    struct QuadratureResult
+    {
+        double value;
+        double error;
+        size_t num_evaluations;
+        // Whether error is within the tolerance, false if max_intervals intervals were used before it was.
+        bool converged;
+    };
+
+    namespace quadrature
+    {
+        // Nodes and weights of the 15-point Kronrod rule on [-1, 1] (nodes x > 0, the odd ones being the nodes of the
+        // embedded 7-point Gauss rule, then the centre) and the weights of the Gauss rule, from QUADPACK.
+        extern const double KRONROD_NODES[8];
+        extern const double KRONROD_WEIGHTS[8];
+        extern const double GAUSS_WEIGHTS[4];
+
+        struct Interval
+        {
+            double a;
+            double b;
+            double value;
+            double error;
+
+            bool operator<(const Interval& other) const { return error < other.error; }
+        };
+
+        // Kronrod estimate of the integral over [a, b], with the error estimate of QUADPACK's qk15: the difference
+        // with the Gauss estimate, scaled down when the integrand is smooth at the scale of the interval.
+        template <class F>
+        Interval gauss_kronrod(const F& f, const double a, const double b)
+        {
+            const double centre = 0.5 * (a + b);
+            const double half_length = 0.5 * (b - a);
+            double values[15];
+            values[14] = f(centre);
+            double gauss = GAUSS_WEIGHTS[3] * values[14];
+            double kronrod = KRONROD_WEIGHTS[7] * values[14];
+            double kronrod_abs = std::abs(kronrod);
+            for (size_t j = 0; j < 7; ++j)
+            {
+                const double x = half_length * KRONROD_NODES[j];
+                values[2 * j] = f(centre - x);
+                values[2 * j + 1] = f(centre + x);
+                const double sum = values[2 * j] + values[2 * j + 1];
+                kronrod += KRONROD_WEIGHTS[j] * sum;
+                kronrod_abs += KRONROD_WEIGHTS[j] * (std::abs(values[2 * j]) + std::abs(values[2 * j + 1]));
+                if (j % 2 == 1)
+                    gauss += GAUSS_WEIGHTS[j / 2] * sum;
+            }
+            const double mean = 0.5 * kronrod;
+            double kronrod_dev = KRONROD_WEIGHTS[7] * std::abs(values[14] - mean);
+            for (size_t j = 0; j < 7; ++j)
+                kronrod_dev += KRONROD_WEIGHTS[j] * (std::abs(values[2 * j] - mean) + std::abs(values[2 * j + 1] - mean));
+
+            const double scale = std::abs(half_length);
+            Interval interval;
+            interval.a = a;
+            interval.b = b;
+            interval.value = kronrod * half_length;
+            interval.error = std::abs((kronrod - gauss) * half_length);
+            kronrod_abs *= scale;
+            kronrod_dev *= scale;
+            if (kronrod_dev != 0.0 && interval.error != 0.0)
+                interval.error = kronrod_dev * std::min(1.0, std::pow(200.0 * interval.error / kronrod_dev, 1.5));
+            interval.error = std::max(interval.error, 50.0 * std::numeric_limits<double>::epsilon() * kronrod_abs);
+            return interval;
+        }
+
+        template <class F>
+        QuadratureResult integrate_finite(
+            const F& f,
+            const double a,
+            const double b,
+            const double abs_tol,
+            const double rel_tol,
+            const size_t max_intervals
+        )
+        {
+            std::vector<Interval> intervals(1, gauss_kronrod(f, a, b));
+            QuadratureResult result;
+            result.value = intervals[0].value;
+            result.error = intervals[0].error;
+            result.num_evaluations = 15;
+            result.converged = result.error <= std::max(abs_tol, rel_tol * std::abs(result.value));
+            while (!result.converged && intervals.size() < max_intervals)
+            {
+                std::pop_heap(intervals.begin(), intervals.end());
+                const Interval worst = intervals.back();
+                const double middle = 0.5 * (worst.a + worst.b);
+                intervals.back() = gauss_kronrod(f, worst.a, middle);
+                std::push_heap(intervals.begin(), intervals.end());
+                intervals.push_back(gauss_kronrod(f, middle, worst.b));
+                std::push_heap(intervals.begin(), intervals.end());
+                result.num_evaluations += 30;
+
+                result.value = 0.0;
+                result.error = 0.0;
+                for (const Interval& interval : intervals)
+                {
+                    result.value += interval.value;
+                    result.error += interval.error;
+                }
+                result.converged = result.error <= std::max(abs_tol, rel_tol * std::abs(result.value));
+            }
+            return result;
+        }
+    }
+
+    // Adaptive Gauss-Kronrod quadrature: the interval with the largest error estimate is bisected until the total error
+    // is at most max(abs_tol, rel_tol * |value|), or until max_intervals intervals are used, in which case converged is
+    // false. b may be INF, [a, INF) being then mapped to [0, 1) by x = a + t / (1 - t). f is any callable, so it can be
+    // inlined.
+    template <class F>
+    QuadratureResult integrate_adaptive(
+        const F& f,
+        const double a,
+        const double b,
+        const double abs_tol = 1e-10,
+        const double rel_tol = 1e-10,
+        const size_t max_intervals = 100
+    )
+    {
+        ASSERT(a < b, "a < b must be true");
+        ASSERT(max_intervals > 0, "max_intervals > 0 must be true");
+        if (b < INF)
+            return quadrature::integrate_finite(f, a, b, abs_tol, rel_tol, max_intervals);
+
+        auto g = [&f, a](const double t) {
+            const double s = 1.0 / (1.0 - t);
+            return f(a + t * s) * s * s;
+        };
+        return quadrature::integrate_finite(g, 0.0, 1.0, abs_tol, rel_tol, max_intervals);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <black_scholes.hpp>
+#include <vector>
+#include <memory>
+
+namespace cltvt
+{
+    // Multipliers of the Black-Scholes limit of the VT level: the limit has volatility target_volatility * sqrt(V) and
+    // repo rate U * target_volatility / volatility * repo_rate. Computed by adaptive quadrature of the q-Pochhammer
+    // integrals, rescaled by 1 - lambda so that they stay well conditioned as lambda -> 1, where both tend to 1.
+    double multiplier_U(const double lambda);
+
+    double multiplier_V(const double lambda);
+
+    class LimitMultipliers;
+    typedef std::shared_ptr<LimitMultipliers> LimitMultipliersPtr;
+
+    // Chebyshev interpolants of log U and log V in u = -log(lambda) over lambda in [lambda_min, 1], of degree
+    // num_nodes - 1, built once from multiplier_U and multiplier_V at num_nodes Chebyshev extreme points. In u both are
+    // smooth up to lambda = 1 (u = 0), where the node takes their limit 1, and their logarithms are close to linear as
+    // lambda -> 0. The default table is accurate to about 1e-11.
+    class LimitMultipliers
+    {
+    public:
+        LimitMultipliers(const double lambda_min = 0.01, const size_t num_nodes = 48);
+
+        static LimitMultipliersPtr create(const double lambda_min = 0.01, const size_t num_nodes = 48);
+
+        double lambda_min() const;
+
+        size_t num_nodes() const;
+
+        double U(const double lambda) const;
+
+        double V(const double lambda) const;
+
+        // Writes U and V at lambdas[i] to us[i] and vs[i], several lambdas at a time with the SIMD kernels
+        // selected at runtime. The values are the same as those of U and V.
+        void evaluate(const double* lambdas, double* us, double* vs, const size_t size) const;
+
+        // Black-Scholes limit of the VT level of a strategy with parameters lambda and target_volatility on sde.
+        BlackScholesPtr limit_sde(
+            const BlackScholes& sde,
+            const double lambda,
+            const double target_volatility,
+            const double init_level
+        ) const;
+
+        // prices[i] is the price of a call with strike and tenor under the limit of lambdas[i], computed with evaluate
+        // and black_call_prices.
+        void limit_call_prices(
+            const BlackScholes& sde,
+            const double target_volatility,
+            const double init_level,
+            const double strike,
+            const double tenor,
+            const double* lambdas,
+            double* prices,
+            const size_t size
+        ) const;
+
+    private:
+        double m_lambda_min;
+        double m_u_scale;
+        std::vector<double> m_log_u_coeffs;
+        std::vector<double> m_log_v_coeffs;
+    };
+}
\ No newline at end of file
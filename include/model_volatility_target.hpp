@@ -0,0 +1,427 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <black_scholes.hpp>
+#include <heston.hpp>
+#include <dispatch.hpp>
+#include <random_number_generator.hpp>
+#include <statistics.hpp>
+#include <parallel.hpp>
+#include <instrumentation.hpp>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <memory>
+
+namespace cltvt
+{
+    class VolatilityTarget;
+
+    class AnyVolatilityTarget;
+    typedef std::shared_ptr<AnyVolatilityTarget> AnyVolatilityTargetPtr;
+
+    // Stock dynamics over rebalancing steps of a fixed length dt, the template parameter of ModelVolatilityTarget.
+    // A stepper is built once per strategy, so everything that does not depend on the path is computed by its
+    // constructor, and it provides:
+    //   typedef ... Model;                    Stepper(const Model& model, const double dt)
+    //   typedef ... State;                    state of the model other than the stock, e.g. its variance
+    //   static const size_t NUM_FACTORS;      normals drawn per step
+    //   State init_state() const;
+    //   double step(State& state, const double* normals) const;    simple return of the stock over the next step
+    //   double rate_dt() const;                                    return of cash over a step
+    // and, for the batch simulations, which keep the state of the paths in structure-of-arrays layout:
+    //   static const size_t NUM_LANE_STATES;   values of State per path
+    //   void init_lanes(double* states, const size_t num_lanes) const;
+    //   void step_lanes(double* states, double* rets, const double* normals, const size_t num_steps,
+    //       const size_t num_lanes) const;
+    // states holding NUM_LANE_STATES rows of num_lanes values, normals num_steps * NUM_FACTORS rows of num_lanes
+    // normals and rets receiving num_steps rows of num_lanes returns. num_lanes is a multiple of MAX_SIMD_WIDTH.
+    // step is defined in the class so that it is inlined into the VT recursion.
+    class BlackScholesStepper
+    {
+    public:
+        typedef BlackScholes Model;
+
+        struct State
+        {
+        };
+
+        static const size_t NUM_FACTORS = 1;
+
+        BlackScholesStepper(const BlackScholes& sde, const double dt);
+
+        State init_state() const { return State(); }
+
+        double step(State&, const double* normals) const
+        {
+            return std::expm1(m_drift_dt + m_vol_sqrt_dt * normals[0]);
+        }
+
+        double rate_dt() const { return m_rate_dt; }
+
+        static const size_t NUM_LANE_STATES = 0;
+
+        void init_lanes(double*, const size_t) const {}
+
+        void step_lanes(
+            double* states,
+            double* rets,
+            const double* normals,
+            const size_t num_steps,
+            const size_t num_lanes
+        ) const;
+
+    private:
+        double m_drift_dt;
+        double m_vol_sqrt_dt;
+        double m_rate_dt;
+    };
+
+    // Heston dynamics with the QE scheme, the state being the variance.
+    class HestonQEStepper
+    {
+    public:
+        typedef Heston Model;
+
+        struct State
+        {
+            double var;
+        };
+
+        static const size_t NUM_FACTORS = 2;
+
+        HestonQEStepper(const Heston& model, const double dt);
+
+        State init_state() const { return State{ m_init_var }; }
+
+        double step(State& state, const double* normals) const
+        {
+            return m_step.advance(state.var, normals);
+        }
+
+        double rate_dt() const { return m_step.rate_dt; }
+
+        static const size_t NUM_LANE_STATES = 1;
+
+        void init_lanes(double* states, const size_t num_lanes) const;
+
+        void step_lanes(
+            double* states,
+            double* rets,
+            const double* normals,
+            const size_t num_steps,
+            const size_t num_lanes
+        ) const;
+
+    private:
+        HestonQEStep m_step;
+        double m_init_var;
+    };
+
+    // Volatility target strategy on a model chosen at run time. Calls are dispatched once per path or per simulation,
+    // never per step. Sample i of the simulations is path i of PathNormalGenerator(seed), its step j using the normals
+    // NUM_FACTORS * j to NUM_FACTORS * (j + 1) - 1 of the path.
+    class AnyVolatilityTarget
+    {
+    public:
+        virtual ~AnyVolatilityTarget() {}
+
+        virtual size_t num_time_steps() const = 0;
+
+        virtual double tenor() const = 0;
+
+        virtual double simulate_vt_level(const PathNormalGenerator& rng, const size_t path) const = 0;
+
+        virtual void simulate_vt_levels_parallel(
+            std::vector<double>& vt_levels,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const = 0;
+
+        virtual void simulate_vt_levels_parallel(
+            Accumulator& acc,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const = 0;
+
+        // Same paths as simulate_vt_levels_parallel (equal up to rounding), simulated BATCH_LANES paths at a time in
+        // structure-of-arrays layout with the SIMD kernels selected at runtime.
+        virtual void simulate_vt_levels_batch(
+            std::vector<double>& vt_levels,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const = 0;
+
+        virtual void simulate_vt_levels_batch(
+            Accumulator& acc,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const = 0;
+    };
+
+    // Volatility target strategy on the stock of a model known at compile time: Stepper::step is inlined into the VT
+    // recursion, which the compiler can then schedule as one loop with the constants of both in registers. The class
+    // is final, so calls through the concrete type, including those of the simulations to simulate_vt_level, are not
+    // virtual either. With BlackScholesStepper the levels are those of
+    // VolatilityTarget::simulate_vt_level(const PathNormalGenerator&, path), which also has the Greeks, control
+    // variates and batch simulations specific to Black-Scholes.
+    template <class Stepper>
+    class ModelVolatilityTarget final : public AnyVolatilityTarget
+    {
+    public:
+        typedef typename Stepper::Model Model;
+
+        static const size_t BATCH_STEPS = 64;
+
+        static const size_t BATCH_LANES = 16;
+
+        ModelVolatilityTarget(
+            const Model& model,
+            const double lamb,
+            const size_t num_time_steps,
+            const double target_volatility,
+            const double tenor,
+            const double init_var,
+            const double init_level
+        )
+            :
+            m_stepper(model, tenor / num_time_steps),
+            m_lamb(lamb),
+            m_num_time_steps(num_time_steps),
+            m_target_vol(target_volatility),
+            m_tenor(tenor),
+            m_init_var(init_var),
+            m_init_level(init_level),
+            m_dt(tenor / num_time_steps),
+            m_var_weight((1.0 - lamb) / m_dt)
+        {
+            ASSERT(m_lamb > 0.0 && m_lamb < 1.0, "0.0 < lamb < 1.0 must be true (lamb=" + std::to_string(m_lamb) + ")");
+            ASSERT(m_target_vol > 0.0, "target_volatility must be positive");
+            ASSERT(m_tenor > 0.0, "tenor must be positive");
+            ASSERT(m_num_time_steps > 1, "num_time_steps > 1 must be true");
+            ASSERT(m_init_var > 1e-12, "init_var must be positive");
+            ASSERT(m_init_level > 1e-12, "init_level must be positive");
+        }
+
+        static std::shared_ptr<ModelVolatilityTarget> create(
+            const Model& model,
+            const double lamb,
+            const size_t num_time_steps,
+            const double target_volatility,
+            const double tenor,
+            const double init_var,
+            const double init_level
+        )
+        {
+            return std::make_shared<ModelVolatilityTarget>(
+                model, lamb, num_time_steps, target_volatility, tenor, init_var, init_level
+            );
+        }
+
+        const Stepper& stepper() const { return m_stepper; }
+
+        size_t num_time_steps() const override { return m_num_time_steps; }
+
+        double tenor() const override { return m_tenor; }
+
+        double simulate_vt_level(const PathNormalGenerator& rng, const size_t path) const override
+        {
+            double normals[BATCH_STEPS * Stepper::NUM_FACTORS];
+            typename Stepper::State state = m_stepper.init_state();
+            double level = m_init_level;
+            double var = m_init_var;
+            for (size_t step = 0; step < m_num_time_steps; step += BATCH_STEPS)
+            {
+                const size_t num_steps = std::min(BATCH_STEPS, m_num_time_steps - step);
+                CLTVT_TIME_PHASE(
+                    SimulationPhase::RNG,
+                    rng.generate(path, step * Stepper::NUM_FACTORS, normals, num_steps * Stepper::NUM_FACTORS)
+                );
+                CLTVT_TIME_PHASE(SimulationPhase::VT_RECURSION, advance_vt_path(state, level, var, normals, num_steps));
+            }
+            return level;
+        }
+
+        void simulate_vt_levels_parallel(
+            std::vector<double>& vt_levels,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const override
+        {
+            CLTVT_COUNT_ALLOCATION(vt_levels, num_samples);
+            vt_levels.resize(num_samples);
+            const PathNormalGenerator rng(seed);
+            auto simulate_block = [&](const size_t block, const size_t) {
+                const size_t begin = block * SIMULATION_BLOCK_SIZE;
+                const size_t end = std::min(begin + SIMULATION_BLOCK_SIZE, num_samples);
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const double level = simulate_vt_level(rng, i);
+                    CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, vt_levels[i] = level);
+                }
+                CLTVT_COUNT_PATHS(end - begin);
+            };
+            ThreadPool::instance().run(num_blocks(num_samples), num_threads, simulate_block);
+        }
+
+        void simulate_vt_levels_parallel(
+            Accumulator& acc,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const override
+        {
+            const PathNormalGenerator rng(seed);
+            auto simulate_range = [&](const size_t begin, const size_t end, Accumulator& partial) {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const double level = simulate_vt_level(rng, i);
+                    CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, partial.add(level));
+                }
+                CLTVT_COUNT_PATHS(end - begin);
+            };
+            accumulate_parallel(acc, num_samples, num_threads, simulate_range);
+        }
+
+        void simulate_vt_levels_batch(
+            std::vector<double>& vt_levels,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const override
+        {
+            CLTVT_COUNT_ALLOCATION(vt_levels, num_samples);
+            vt_levels.resize(num_samples);
+            const PathNormalGenerator rng(seed);
+            auto simulate_block = [&](const size_t block, const size_t) {
+                double levels[BATCH_LANES];
+                const size_t begin = block * SIMULATION_BLOCK_SIZE;
+                const size_t end = std::min(begin + SIMULATION_BLOCK_SIZE, num_samples);
+                for (size_t first = begin; first < end; first += BATCH_LANES)
+                {
+                    simulate_vt_batch(rng, first, levels);
+                    CLTVT_TIME_PHASE(
+                        SimulationPhase::OUTPUT,
+                        std::copy(levels, levels + std::min(BATCH_LANES, end - first), vt_levels.begin() + first)
+                    );
+                }
+                CLTVT_COUNT_PATHS(end - begin);
+            };
+            ThreadPool::instance().run(num_blocks(num_samples), num_threads, simulate_block);
+        }
+
+        void simulate_vt_levels_batch(
+            Accumulator& acc,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const override
+        {
+            const PathNormalGenerator rng(seed);
+            auto simulate_range = [&](const size_t begin, const size_t end, Accumulator& partial) {
+                double levels[BATCH_LANES];
+                for (size_t first = begin; first < end; first += BATCH_LANES)
+                {
+                    simulate_vt_batch(rng, first, levels);
+                    const size_t num_lanes = std::min(BATCH_LANES, end - first);
+                    CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, for (size_t lane = 0; lane < num_lanes; ++lane) partial.add(levels[lane]));
+                }
+                CLTVT_COUNT_PATHS(end - begin);
+            };
+            accumulate_parallel(acc, num_samples, num_threads, simulate_range);
+        }
+
+    private:
+        // Levels of paths [first_path, first_path + BATCH_LANES) of rng: the stepper writes the stock returns of
+        // BATCH_STEPS steps at a time and the VT recursion runs on them.
+        void simulate_vt_batch(const PathNormalGenerator& rng, const size_t first_path, double* levels) const
+        {
+            const size_t num_factors = Stepper::NUM_FACTORS;
+            // One row more than needed, so that steppers without lane states do not declare an empty array.
+            double states[(Stepper::NUM_LANE_STATES + 1) * BATCH_LANES];
+            double vars[BATCH_LANES];
+            double rets[BATCH_STEPS * BATCH_LANES];
+            double normals[BATCH_STEPS * num_factors * BATCH_LANES];
+            std::fill(levels, levels + BATCH_LANES, m_init_level);
+            std::fill(vars, vars + BATCH_LANES, m_init_var);
+            m_stepper.init_lanes(states, BATCH_LANES);
+            for (size_t step = 0; step < m_num_time_steps; step += BATCH_STEPS)
+            {
+                const size_t num_steps = std::min(BATCH_STEPS, m_num_time_steps - step);
+                CLTVT_TIME_PHASE(
+                    SimulationPhase::RNG,
+                    rng.generate_paths(first_path, BATCH_LANES, step * num_factors, num_steps * num_factors, normals)
+                );
+                CLTVT_TIME_PHASE(SimulationPhase::PATH, m_stepper.step_lanes(states, rets, normals, num_steps, BATCH_LANES));
+                CLTVT_TIME_PHASE(
+                    SimulationPhase::VT_RECURSION,
+                    simd_kernels().advance_vt_returns(
+                        levels,
+                        vars,
+                        rets,
+                        num_steps,
+                        BATCH_LANES,
+                        m_stepper.rate_dt(),
+                        m_target_vol,
+                        m_lamb,
+                        m_var_weight
+                    )
+                );
+            }
+        }
+
+        void advance_vt_path(
+            typename Stepper::State& state,
+            double& level,
+            double& var,
+            const double* normals,
+            const size_t num_steps
+        ) const
+        {
+            // Local copies, which the compiler can keep in registers as level and var cannot alias them.
+            const Stepper stepper = m_stepper;
+            const double rate_dt = stepper.rate_dt();
+            const double lamb = m_lamb;
+            const double target_vol = m_target_vol;
+            const double var_weight = m_var_weight;
+            double l = level;
+            double v = var;
+            for (size_t i = 0; i < num_steps; ++i)
+            {
+                const double ret = stepper.step(state, normals + i * Stepper::NUM_FACTORS);
+                const double w = target_vol / std::sqrt(v);
+                l *= 1.0 + (1.0 - w) * rate_dt + w * ret;
+                v = lamb * v + var_weight * ret * ret;
+            }
+            level = l;
+            var = v;
+        }
+
+        Stepper m_stepper;
+        double m_lamb;
+        size_t m_num_time_steps;
+        double m_target_vol;
+        double m_tenor;
+        double m_init_var;
+        double m_init_level;
+        double m_dt;
+        double m_var_weight;
+    };
+
+    template <class Stepper>
+    const size_t ModelVolatilityTarget<Stepper>::BATCH_STEPS;
+
+    template <class Stepper>
+    const size_t ModelVolatilityTarget<Stepper>::BATCH_LANES;
+
+    typedef ModelVolatilityTarget<BlackScholesStepper> BlackScholesVolatilityTarget;
+
+    typedef ModelVolatilityTarget<HestonQEStepper> HestonVolatilityTarget;
+
+    // The strategy of target on its Black-Scholes model, for runtime model choice next to other models.
+    AnyVolatilityTargetPtr create_any_volatility_target(const VolatilityTarget& target);
+}
\ No newline at end of file
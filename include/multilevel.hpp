@@ -0,0 +1,131 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <volatility_target.hpp>
+#include <random_number_generator.hpp>
+#include <statistics.hpp>
+#include <vector>
+
+namespace cltvt
+{
+    // One level of a multilevel estimate.
+    struct MultilevelLevel
+    {
+        size_t num_time_steps;
+        size_t num_samples;
+        // Mean and variance of the samples of the level: P_l - P_{l-1} on coupled paths with num_time_steps and
+        // num_time_steps / 2 steps, or P_l alone on the coarsest level used. For the volatility they are linearised
+        // around the estimate.
+        double mean;
+        double variance;
+        // Time steps simulated per sample.
+        size_t cost;
+        double seconds;
+    };
+
+    struct MultilevelEstimate
+    {
+        double value;
+        double standard_error;
+        // Levels used, coarsest first.
+        std::vector<MultilevelLevel> levels;
+        // Time steps simulated, the pilot samples of the dropped levels included.
+        double cost;
+        // Time steps that plain Monte Carlo on the finest grid would need for the same standard error, with the
+        // variance of the finest level's paths.
+        double single_level_cost;
+        double seconds;
+
+        double cost_reduction() const;
+    };
+
+    // Multilevel Monte Carlo (Giles, 2008) for a VolatilityTarget: the expectation on its grid of num_time_steps steps
+    // is the expectation on a coarse grid plus the expectations of the differences between successive grids, each
+    // halving the time step. The two grids of a difference are simulated on the same stock path, the normal of a coarse
+    // step being (z_1 + z_2) / sqrt(2) of the two fine steps it spans, so that its variance is a fraction of that of the
+    // levels themselves and cheap coarse paths carry most of the variance.
+    //
+    // The estimate has no bias with respect to the finest grid, so its root mean square error is its standard error.
+    // Samples are allocated to levels in rounds, N_l proportional to sqrt(V_l / C_l) for the variance V_l and the cost
+    // C_l of a sample, until the target standard error is met. The strategy's variance estimate has the same memory in
+    // steps on every grid, so V_l does not vanish as the grids get finer: after the pilot samples, the coarsest levels
+    // are dropped if starting from a finer one is predicted to be cheaper.
+    class MultilevelVolatilityTarget
+    {
+    public:
+        // Levels of target.num_time_steps() / 2^(num_levels - 1), ..., target.num_time_steps() steps, which must be
+        // divisible by 2^(num_levels - 1).
+        MultilevelVolatilityTarget(const VolatilityTarget& target, const size_t num_levels);
+
+        size_t num_levels() const;
+
+        // Strategy of level l, the finest being num_levels() - 1.
+        const VolatilityTarget& level(const size_t l) const;
+
+        // Price of a call on the VT level. Samples i of level l are path (l << 40) + i of PathNormalGenerator(seed),
+        // so the estimate does not depend on num_threads.
+        MultilevelEstimate estimate_call_price(
+            const double strike,
+            const double target_standard_error,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Volatility of the VT level, sqrt(Var(log level) / tenor), from the estimates of the first two moments of the
+        // log level on the same samples.
+        MultilevelEstimate estimate_volatility(
+            const double target_standard_error,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+    private:
+        enum class Quantity
+        {
+            CALL_PRICE,
+            VOLATILITY
+        };
+
+        // Samples of a level: the functionals (x, y) of the fine levels and their differences with those of the coarse
+        // levels. For the price x = y is the discounted payoff, for the volatility x is the log level and y its square.
+        struct LevelSamples
+        {
+            RunningCovariance fine;
+            RunningCovariance corrections;
+
+            void merge(const LevelSamples& other);
+        };
+
+        MultilevelEstimate estimate(
+            const Quantity quantity,
+            const double strike,
+            const double target_standard_error,
+            const size_t num_threads,
+            const size_t seed
+        ) const;
+
+        // Adds samples [first_sample, first_sample + num_samples) of level l, on the fine grid alone unless coupled.
+        void add_samples(
+            LevelSamples& samples,
+            const Quantity quantity,
+            const double strike,
+            const size_t l,
+            const bool coupled,
+            const size_t first_sample,
+            const size_t num_samples,
+            const size_t num_threads,
+            const size_t seed
+        ) const;
+
+        // Levels of VolatilityTarget::BATCH_LANES paths of level l starting at first_path, on the fine grid and, if
+        // coarse is not nullptr, on the coarse grid.
+        void simulate_batch(
+            const size_t l,
+            const PathNormalGenerator& rng,
+            const size_t first_path,
+            double* fine,
+            double* coarse
+        ) const;
+
+        std::vector<VolatilityTarget> m_levels;
+    };
+}
\ No newline at end of file
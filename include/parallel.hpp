@@ -0,0 +1,67 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+namespace cltvt
+{
+    size_t resolve_num_threads(const size_t num_threads);
+
+    size_t num_blocks(const size_t num_items, const size_t block_size = SIMULATION_BLOCK_SIZE);
+
+    class ThreadPool
+    {
+    public:
+        static ThreadPool& instance();
+
+        ~ThreadPool();
+
+        // Runs task(task_index, thread_index) for every task_index in [0, num_tasks) on at most num_threads
+        // threads (0 means all hardware threads). The calling thread takes part as thread_index 0.
+        template <class Task>
+        void run(const size_t num_tasks, const size_t num_threads, Task& task)
+        {
+            run_tasks(num_tasks, num_threads, &ThreadPool::invoke<Task>, &task);
+        }
+
+    private:
+        typedef void (*Invoker)(void*, const size_t, const size_t);
+
+        ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        template <class Task>
+        static void invoke(void* task, const size_t task_index, const size_t thread_index)
+        {
+            (*static_cast<Task*>(task))(task_index, thread_index);
+        }
+
+        void run_tasks(const size_t num_tasks, const size_t num_threads, Invoker invoker, void* task);
+
+        void execute(const size_t thread_index);
+
+        void worker_loop(const size_t thread_index);
+
+        std::vector<std::thread> m_workers;
+        std::mutex m_run_mutex;
+        std::mutex m_mutex;
+        std::condition_variable m_start_cv;
+        std::condition_variable m_done_cv;
+        size_t m_generation;
+        size_t m_job_threads;
+        size_t m_pending;
+        bool m_stop;
+        Invoker m_invoker;
+        void* m_task;
+        size_t m_num_tasks;
+        std::atomic<size_t> m_next_task;
+        std::exception_ptr m_error;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <random_number_generator.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace cltvt
+{
+    // Sobol sequence in Gray code order, with the primitive polynomials and initial direction numbers of Joe and Kuo
+    // (2008) in dimensions 2 to MAX_DIMENSION. Each point can be randomised by a digital shift, i.e. its 32-bit
+    // coordinates are XORed with uniform random words, which keeps the low discrepancy while making every point
+    // uniform, so independent shifts give independent unbiased estimates. This is a random digital shift only, not
+    // Owen scrambling: the points of a replication are a translate of the plain sequence, so the error does not get
+    // the faster convergence of scrambled nets on smooth integrands.
+    class SobolGenerator
+    {
+    public:
+        // Direction numbers are only tabulated up to this dimension: paths with more steps get pseudo-random normals
+        // beyond it, see SobolPathGenerator.
+        static const size_t MAX_DIMENSION = 19;
+
+        // If shifted, the digital shift is derived from (seed, stream), otherwise the plain sequence is generated.
+        SobolGenerator(
+            const size_t dimension,
+            const bool shifted = false,
+            const size_t seed = DEFAULT_RNG_SEED,
+            const size_t stream = 0
+        );
+
+        size_t dimension() const;
+
+        // Writes the next point, dimension() values in (0, 1), to out. Coordinates are mapped to the centres of
+        // cells of width 2^-32, so the origin, which is the first point of the plain sequence, has no infinite normal.
+        void next(double* out);
+
+        // Writes the next point mapped through the inverse normal CDF.
+        void next_normals(double* out);
+
+    private:
+        size_t m_dimension;
+        uint32_t m_index;
+        std::vector<uint32_t> m_directions;
+        std::vector<uint32_t> m_state;
+        std::vector<uint32_t> m_shift;
+    };
+
+    // Brownian bridge on the times t_1 < ... < t_n given by their increments: maps n standard normals to the n
+    // normalised increments (W(t_i) - W(t_i-1)) / sqrt(t_i - t_i-1). The first normal sets W(t_n), the next ones
+    // the midpoints in bisection order, so most of the variance of the path is carried by the first normals.
+    class BrownianBridge
+    {
+    public:
+        BrownianBridge(const std::vector<double>& dtimes);
+
+        size_t size() const;
+
+        // normals and out hold size() values and may not alias.
+        void transform(const double* normals, double* out) const;
+
+    private:
+        std::vector<size_t> m_bridge_index;
+        std::vector<size_t> m_left_index;
+        std::vector<size_t> m_right_index;
+        std::vector<double> m_left_weight;
+        std::vector<double> m_right_weight;
+        std::vector<double> m_std_dev;
+        std::vector<double> m_sqrt_dtimes;
+    };
+
+    // Normals of whole paths built with a Brownian bridge whose first min(n, SobolGenerator::MAX_DIMENSION) normals
+    // come from a digitally shifted Sobol sequence and the others from PathNormalGenerator(seed), so the paths have the
+    // same law as with independent normals. Only those first MAX_DIMENSION normals are quasi-random: the bridge puts
+    // most of the variance of the path in them, but the steps of a fine grid are mostly driven by pseudo-random
+    // normals. Replication r of a seed uses its own shift and the pseudo-random normals of the paths from (r + 1)
+    // 2^PADDING_PATH_BITS on, so the estimates of different replications are independent of each other and of Monte
+    // Carlo runs on paths below 2^PADDING_PATH_BITS of the same seed, and their spread estimates the error of their
+    // mean.
+    class SobolPathGenerator
+    {
+    public:
+        static const size_t PADDING_PATH_BITS = 40;
+
+        SobolPathGenerator(const std::vector<double>& dtimes, const size_t seed = DEFAULT_RNG_SEED, const size_t replication = 0);
+
+        size_t size() const;
+
+        // Returns the size() normals of the next path, valid until the next call.
+        const double* next_path();
+
+    private:
+        BrownianBridge m_bridge;
+        SobolGenerator m_sobol;
+        PathNormalGenerator m_padding;
+        size_t m_padding_path;
+        std::vector<double> m_normals;
+        std::vector<double> m_path;
+    };
+}
\ No newline at end of file
@@ -1,26 +1,89 @@
-#pragma once
-#include <preliminaries.hpp>
-#include <random>
-
-namespace cltvt
-{
-    class StandardNormalGenerator
-    {
-    public:
-        StandardNormalGenerator(const size_t seed = DEFAULT_RNG_SEED);
-
-        void seed(const size_t seed = DEFAULT_RNG_SEED)
-        {
-            m_rng.seed(seed);
-            m_seed = seed;
-        }
-
-        void reset() { seed(m_seed); }
-        void populate_standard_normals(std::vector<double>& rn_out, const size_t size);
-
-    private:
-        size_t m_seed;
-        std::mt19937_64 m_rng;
-        std::normal_distribution<double> m_dist;
-    };
+#pragma once
+#include <preliminaries.hpp>
+#include <random>
+#include <cstdint>
+#include <vector>
+
+namespace cltvt
+{
+    // REFERENCE draws from std::normal_distribution on std::mt19937_64 one value at a time. INVERSE_CDF draws
+    // uniforms from LANES interleaved xoshiro256** generators, which vectorise, and maps them through a
+    // vectorised inverse normal CDF.
+    enum class NormalMethod
+    {
+        REFERENCE,
+        INVERSE_CDF
+    };
+
+    class StandardNormalGenerator
+    {
+    public:
+        static const size_t LANES = 8;
+
+        StandardNormalGenerator(
+            const size_t seed = DEFAULT_RNG_SEED,
+            const size_t stream = 0,
+            const NormalMethod method = NormalMethod::REFERENCE
+        );
+
+        // stream 0 is the sequence of std::mt19937_64 seeded with seed, other streams are independent
+        // sequences derived from (seed, stream), used to give each simulation block its own generator.
+        void seed(const size_t seed = DEFAULT_RNG_SEED, const size_t stream = 0);
+
+        void reset() { seed(m_seed, m_stream); }
+
+        NormalMethod method() const { return m_method; }
+
+        double next();
+
+        // Writes size normals to out. The values are the same as size calls to next().
+        void generate(double* out, const size_t size);
+
+        void populate_standard_normals(std::vector<double>& rn_out, const size_t size);
+
+    private:
+        void next_round(uint64_t* out);
+
+        uint64_t next_bits();
+
+        size_t m_seed;
+        size_t m_stream;
+        NormalMethod m_method;
+        std::mt19937_64 m_rng;
+        std::normal_distribution<double> m_dist;
+        uint64_t m_lanes[4][LANES];
+        uint64_t m_round[LANES];
+        size_t m_round_pos;
+    };
+
+    // Counter-based generator: the normal of (path, step) is the inverse normal CDF of one 64-bit word of
+    // Philox4x32-10 (Salmon et al., 2011) keyed by seed at counter (step / 2, path). Any path, range of paths or
+    // range of steps can therefore be generated on its own, in any order and on any thread.
+    class PathNormalGenerator
+    {
+    public:
+        PathNormalGenerator(const size_t seed = DEFAULT_RNG_SEED);
+
+        size_t seed() const { return m_seed; }
+
+        double normal(const size_t path, const size_t step) const;
+
+        // Writes the normals of steps [first_step, first_step + num_steps) of path to out.
+        void generate(const size_t path, const size_t first_step, double* out, const size_t num_steps) const;
+
+        // Writes the normals of paths [first_path, first_path + num_paths) and steps [first_step, first_step + num_steps)
+        // to out, step by step: out[i * num_paths + j] is the normal of step first_step + i of path first_path + j.
+        void generate_paths(
+            const size_t first_path,
+            const size_t num_paths,
+            const size_t first_step,
+            const size_t num_steps,
+            double* out
+        ) const;
+
+        void populate_standard_normals(std::vector<double>& rn_out, const size_t path, const size_t size) const;
+
+    private:
+        size_t m_seed;
+    };
 }
\ No newline at end of file
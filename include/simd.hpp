@@ -0,0 +1,444 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Name of the inline namespace below. The translation units of the kernel variants compiled with other instruction
+// sets define it first, so that their copies of these inline functions get their own symbols and cannot be picked by
+// the linker for code that must run on any CPU.
+#ifndef CLTVT_SIMD_NAMESPACE
+#define CLTVT_SIMD_NAMESPACE native
+#endif
+
+namespace cltvt
+{
+    namespace simd
+    {
+    inline namespace CLTVT_SIMD_NAMESPACE
+    {
+        // Vec1, Vec4 (AVX2) and Vec8 (AVX-512) expose the same operations, so the kernels below are written once
+        // as templates. Only correctly rounded operations are used (no fused multiply-add), which makes every
+        // lane width produce the same bits, provided the compiler does not contract a multiply and an add into a
+        // fused multiply-add either: the translation units using them must be built with -ffp-contract=off (GCC
+        // and Clang, whose defaults contract once FMA is enabled, which the simd_kernels_*.cpp units force with
+        // pragmas) or /fp:precise without /fp:contract (MSVC, set in the project files).
+
+        struct Vec1
+        {
+            static const size_t width = 1;
+            typedef bool Mask;
+
+            Vec1() {}
+            Vec1(const double x) : v(x) {}
+
+            static Vec1 load(const double* p) { return Vec1(*p); }
+            void store(double* p) const { *p = v; }
+
+            // (k + 1/2) / 2^52 for the top 52 bits k of each word, a uniform in (0, 1) that never rounds to 0 or 1.
+            static Vec1 load_uniform(const uint64_t* bits)
+            {
+                return Vec1((double(*bits >> 12) + 0.5) * (1.0 / 4503599627370496.0));
+            }
+
+            double v;
+        };
+
+        inline Vec1 operator+(const Vec1 a, const Vec1 b) { return Vec1(a.v + b.v); }
+        inline Vec1 operator-(const Vec1 a, const Vec1 b) { return Vec1(a.v - b.v); }
+        inline Vec1 operator*(const Vec1 a, const Vec1 b) { return Vec1(a.v * b.v); }
+        inline Vec1 operator/(const Vec1 a, const Vec1 b) { return Vec1(a.v / b.v); }
+        inline bool operator<(const Vec1 a, const Vec1 b) { return a.v < b.v; }
+        inline bool operator>(const Vec1 a, const Vec1 b) { return a.v > b.v; }
+        inline Vec1 sqrt(const Vec1 a) { return Vec1(std::sqrt(a.v)); }
+        inline Vec1 min(const Vec1 a, const Vec1 b) { return Vec1(a.v < b.v ? a.v : b.v); }
+        inline Vec1 max(const Vec1 a, const Vec1 b) { return Vec1(a.v > b.v ? a.v : b.v); }
+        inline Vec1 round(const Vec1 a) { return Vec1((a.v + 6755399441055744.0) - 6755399441055744.0); }
+        inline Vec1 select(const bool mask, const Vec1 a, const Vec1 b) { return mask ? a : b; }
+        inline bool all(const bool mask) { return mask; }
+
+        inline Vec1 pow2n(const Vec1 n)
+        {
+            const uint64_t bits = uint64_t(int64_t(n.v) + 1023) << 52;
+            double x;
+            std::memcpy(&x, &bits, sizeof(x));
+            return Vec1(x);
+        }
+
+        inline void split_exponent(const Vec1 x, Vec1& mantissa, Vec1& exponent)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &x.v, sizeof(bits));
+            exponent = Vec1(double(int64_t(bits >> 52)) - 1023.0);
+            bits = (bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+            std::memcpy(&mantissa.v, &bits, sizeof(bits));
+        }
+
+#if defined(__AVX2__)
+        struct Vec4
+        {
+            static const size_t width = 4;
+            typedef __m256d Mask;
+
+            Vec4() {}
+            Vec4(const double x) : v(_mm256_set1_pd(x)) {}
+            Vec4(const __m256d x) : v(x) {}
+
+            static Vec4 load(const double* p) { return Vec4(_mm256_loadu_pd(p)); }
+            void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+            static Vec4 load_uniform(const uint64_t* bits)
+            {
+                const __m256i k = _mm256_srli_epi64(_mm256_loadu_si256((const __m256i*)bits), 12);
+                const __m256d biased = _mm256_castsi256_pd(_mm256_or_si256(k, _mm256_set1_epi64x(0x4330000000000000ll)));
+                const __m256d value = _mm256_sub_pd(biased, _mm256_set1_pd(4503599627370496.0 - 0.5));
+                return Vec4(_mm256_mul_pd(value, _mm256_set1_pd(1.0 / 4503599627370496.0)));
+            }
+
+            __m256d v;
+        };
+
+        inline Vec4 operator+(const Vec4 a, const Vec4 b) { return Vec4(_mm256_add_pd(a.v, b.v)); }
+        inline Vec4 operator-(const Vec4 a, const Vec4 b) { return Vec4(_mm256_sub_pd(a.v, b.v)); }
+        inline Vec4 operator*(const Vec4 a, const Vec4 b) { return Vec4(_mm256_mul_pd(a.v, b.v)); }
+        inline Vec4 operator/(const Vec4 a, const Vec4 b) { return Vec4(_mm256_div_pd(a.v, b.v)); }
+        inline __m256d operator<(const Vec4 a, const Vec4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+        inline __m256d operator>(const Vec4 a, const Vec4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+        inline Vec4 sqrt(const Vec4 a) { return Vec4(_mm256_sqrt_pd(a.v)); }
+        inline Vec4 min(const Vec4 a, const Vec4 b) { return Vec4(_mm256_min_pd(a.v, b.v)); }
+        inline Vec4 max(const Vec4 a, const Vec4 b) { return Vec4(_mm256_max_pd(a.v, b.v)); }
+        inline Vec4 round(const Vec4 a) { return Vec4(_mm256_round_pd(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+        inline Vec4 select(const __m256d mask, const Vec4 a, const Vec4 b) { return Vec4(_mm256_blendv_pd(b.v, a.v, mask)); }
+        inline bool all(const __m256d mask) { return _mm256_movemask_pd(mask) == 0xF; }
+
+        inline Vec4 pow2n(const Vec4 n)
+        {
+            const __m256d shifted = _mm256_add_pd(n.v, _mm256_set1_pd(6755399441055744.0 + 1023.0));
+            return Vec4(_mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(shifted), 52)));
+        }
+
+        inline void split_exponent(const Vec4 x, Vec4& mantissa, Vec4& exponent)
+        {
+            const __m256i bits = _mm256_castpd_si256(x.v);
+            const __m256i biased = _mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000ll));
+            exponent = Vec4(_mm256_sub_pd(_mm256_castsi256_pd(biased), _mm256_set1_pd(4503599627370496.0 + 1023.0)));
+            const __m256i m = _mm256_or_si256(
+                _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFll)), _mm256_set1_epi64x(0x3FF0000000000000ll));
+            mantissa = Vec4(_mm256_castsi256_pd(m));
+        }
+
+#endif
+
+#if defined(__AVX512F__)
+        struct Vec8
+        {
+            static const size_t width = 8;
+            typedef __mmask8 Mask;
+
+            Vec8() {}
+            Vec8(const double x) : v(_mm512_set1_pd(x)) {}
+            Vec8(const __m512d x) : v(x) {}
+
+            static Vec8 load(const double* p) { return Vec8(_mm512_loadu_pd(p)); }
+            void store(double* p) const { _mm512_storeu_pd(p, v); }
+
+            static Vec8 load_uniform(const uint64_t* bits)
+            {
+                const __m512i k = _mm512_srli_epi64(_mm512_loadu_si512((const void*)bits), 12);
+                const __m512d biased = _mm512_castsi512_pd(_mm512_or_si512(k, _mm512_set1_epi64(0x4330000000000000ll)));
+                const __m512d value = _mm512_sub_pd(biased, _mm512_set1_pd(4503599627370496.0 - 0.5));
+                return Vec8(_mm512_mul_pd(value, _mm512_set1_pd(1.0 / 4503599627370496.0)));
+            }
+
+            __m512d v;
+        };
+
+        inline Vec8 operator+(const Vec8 a, const Vec8 b) { return Vec8(_mm512_add_pd(a.v, b.v)); }
+        inline Vec8 operator-(const Vec8 a, const Vec8 b) { return Vec8(_mm512_sub_pd(a.v, b.v)); }
+        inline Vec8 operator*(const Vec8 a, const Vec8 b) { return Vec8(_mm512_mul_pd(a.v, b.v)); }
+        inline Vec8 operator/(const Vec8 a, const Vec8 b) { return Vec8(_mm512_div_pd(a.v, b.v)); }
+        inline __mmask8 operator<(const Vec8 a, const Vec8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); }
+        inline __mmask8 operator>(const Vec8 a, const Vec8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+        inline Vec8 sqrt(const Vec8 a) { return Vec8(_mm512_sqrt_pd(a.v)); }
+        inline Vec8 min(const Vec8 a, const Vec8 b) { return Vec8(_mm512_min_pd(a.v, b.v)); }
+        inline Vec8 max(const Vec8 a, const Vec8 b) { return Vec8(_mm512_max_pd(a.v, b.v)); }
+        inline Vec8 round(const Vec8 a) { return Vec8(_mm512_roundscale_pd(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+        inline Vec8 select(const __mmask8 mask, const Vec8 a, const Vec8 b) { return Vec8(_mm512_mask_blend_pd(mask, b.v, a.v)); }
+        inline bool all(const __mmask8 mask) { return mask == 0xFF; }
+
+        inline Vec8 pow2n(const Vec8 n)
+        {
+            const __m512d shifted = _mm512_add_pd(n.v, _mm512_set1_pd(6755399441055744.0 + 1023.0));
+            return Vec8(_mm512_castsi512_pd(_mm512_slli_epi64(_mm512_castpd_si512(shifted), 52)));
+        }
+
+        inline void split_exponent(const Vec8 x, Vec8& mantissa, Vec8& exponent)
+        {
+            const __m512i bits = _mm512_castpd_si512(x.v);
+            const __m512i biased = _mm512_or_si512(_mm512_srli_epi64(bits, 52), _mm512_set1_epi64(0x4330000000000000ll));
+            exponent = Vec8(_mm512_sub_pd(_mm512_castsi512_pd(biased), _mm512_set1_pd(4503599627370496.0 + 1023.0)));
+            const __m512i m = _mm512_or_si512(
+                _mm512_and_si512(bits, _mm512_set1_epi64(0x000FFFFFFFFFFFFFll)), _mm512_set1_epi64(0x3FF0000000000000ll));
+            mantissa = Vec8(_mm512_castsi512_pd(m));
+        }
+
+#endif
+
+#if defined(__AVX512F__)
+        typedef Vec8 NativeVec;
+#elif defined(__AVX2__)
+        typedef Vec4 NativeVec;
+#else
+        typedef Vec1 NativeVec;
+#endif
+
+        // Returns (e^r - 1, n) with x = n * log(2) + r and |r| <= log(2) / 2, evaluated with a degree 13
+        // Taylor polynomial which is accurate to about one ulp on that range.
+        template <class V>
+        inline V exp_reduced(const V x, V& n)
+        {
+            const V clamped = min(max(x, V(-708.0)), V(709.0));
+            n = round(clamped * V(1.4426950408889634));
+            const V r = (clamped - n * V(0.693145751953125)) - n * V(1.42860682030941723212e-6);
+            V p(1.0 / 6227020800.0);
+            p = p * r + V(1.0 / 479001600.0);
+            p = p * r + V(1.0 / 39916800.0);
+            p = p * r + V(1.0 / 3628800.0);
+            p = p * r + V(1.0 / 362880.0);
+            p = p * r + V(1.0 / 40320.0);
+            p = p * r + V(1.0 / 5040.0);
+            p = p * r + V(1.0 / 720.0);
+            p = p * r + V(1.0 / 120.0);
+            p = p * r + V(1.0 / 24.0);
+            p = p * r + V(1.0 / 6.0);
+            p = p * r + V(0.5);
+            p = p * r + V(1.0);
+            return p * r;
+        }
+
+        template <class V>
+        inline V exp(const V x)
+        {
+            V n;
+            const V q = exp_reduced(x, n);
+            return (q + V(1.0)) * pow2n(n);
+        }
+
+        template <class V>
+        inline V expm1(const V x)
+        {
+            V n;
+            const V q = exp_reduced(x, n);
+            const V scale = pow2n(n);
+            return q * scale + (scale - V(1.0));
+        }
+
+        // Natural logarithm of a positive normal number, from log(m) = 2 atanh((m - 1) / (m + 1)) with the
+        // mantissa m reduced to [sqrt(1/2), sqrt(2)).
+        template <class V>
+        inline V log(const V x)
+        {
+            V m, e;
+            split_exponent(x, m, e);
+            const auto large = m > V(1.4142135623730951);
+            m = select(large, m * V(0.5), m);
+            e = select(large, e + V(1.0), e);
+            const V f = (m - V(1.0)) / (m + V(1.0));
+            const V f2 = f * f;
+            const V f4 = f2 * f2;
+            const V f8 = f4 * f4;
+            const V p01 = V(2.0 / 5.0) * f2 + V(2.0 / 3.0);
+            const V p23 = V(2.0 / 9.0) * f2 + V(2.0 / 7.0);
+            const V p45 = V(2.0 / 13.0) * f2 + V(2.0 / 11.0);
+            const V p67 = V(2.0 / 17.0) * f2 + V(2.0 / 15.0);
+            const V p89 = V(2.0 / 21.0) * f2 + V(2.0 / 19.0);
+            const V p = ((p89 * f8 + (p67 * f4 + p45)) * f8 + (p23 * f4 + p01)) * f2 * f + (f + f);
+            return e * V(0.693145751953125) + (e * V(1.42860682030941723212e-6) + p);
+        }
+
+        // c[0] x^7 + ... + c[7] with Estrin's scheme, which keeps the dependency chain short.
+        template <class V>
+        inline V polynomial7(const V x, const V* c)
+        {
+            const V x2 = x * x;
+            const V x4 = x2 * x2;
+            const V p01 = c[0] * x + c[1];
+            const V p23 = c[2] * x + c[3];
+            const V p45 = c[4] * x + c[5];
+            const V p67 = c[6] * x + c[7];
+            return (p01 * x2 + p23) * x4 + (p45 * x2 + p67);
+        }
+
+        // Coefficients of Wichura's algorithm AS241 (PPND16), highest degree first: numerator and denominator for
+        // |p - 1/2| <= 0.425, for r = sqrt(-log(min(p, 1 - p))) <= 5 and for r > 5.
+        const double PPND16_A[8] = { 2509.0809287301226727, 33430.575583588128105, 67265.770927008700853,
+            45921.953931549871457, 13731.693765509461125, 1971.5909503065514427, 133.14166789178437745, 3.387132872796366608 };
+        const double PPND16_B[8] = { 5226.495278852545925, 28729.085735721942674, 39307.89580009271061,
+            21213.794301586595867, 5394.1960214247511077, 687.1870074920579083, 42.313330701600911252, 1.0 };
+        const double PPND16_C[8] = { 7.7454501427834140764e-4, 0.0227238449892691845833, 0.24178072517745061177,
+            1.27045825245236838258, 3.64784832476320460504, 5.7694972214606914055, 4.6303378461565452959, 1.42343711074968357734 };
+        const double PPND16_D[8] = { 1.05075007164441684324e-9, 5.475938084995344946e-4, 0.0151986665636164571966,
+            0.14810397642748007459, 0.68976733498510000455, 1.6763848301838038494, 2.05319162663775882187, 1.0 };
+        const double PPND16_E[8] = { 2.01033439929228813265e-7, 2.71155556874348757815e-5, 0.0012426609473880784386,
+            0.026532189526576123093, 0.29656057182850489123, 1.7848265399172913358, 5.4637849111641143699, 6.6579046435011037772 };
+        const double PPND16_F[8] = { 2.04426310338993978564e-15, 1.4215117583164458887e-7, 1.8463183175100546818e-5,
+            7.868691311456132591e-4, 0.0148753612908506148525, 0.13692988092273580531, 0.59983220655588793769, 1.0 };
+
+        // AS241 for |p - 1/2| <= 0.425, with q = p - 1/2.
+        template <class V>
+        inline V inverse_normal_cdf_central(const V q)
+        {
+            const V x = V(0.180625) - q * q;
+            V a[8];
+            V b[8];
+            for (size_t k = 0; k < 8; ++k)
+            {
+                a[k] = V(PPND16_A[k]);
+                b[k] = V(PPND16_B[k]);
+            }
+            return q * (polynomial7(x, a) / polynomial7(x, b));
+        }
+
+        // AS241 for |p - 1/2| > 0.425, switching coefficients lane by lane at r = sqrt(-log(min(p, 1 - p))) = 5.
+        template <class V>
+        inline V inverse_normal_cdf_tail(const V p)
+        {
+            const V r = sqrt(V(0.0) - log(min(p, V(1.0) - p)));
+            const auto far = r > V(5.0);
+            const V x = select(far, r - V(5.0), r - V(1.6));
+            V a[8];
+            V b[8];
+            for (size_t k = 0; k < 8; ++k)
+            {
+                a[k] = select(far, V(PPND16_E[k]), V(PPND16_C[k]));
+                b[k] = select(far, V(PPND16_F[k]), V(PPND16_D[k]));
+            }
+            const V tail = polynomial7(x, a) / polynomial7(x, b);
+            return select(p < V(0.5), V(0.0) - tail, tail);
+        }
+
+        // Inverse of the standard normal CDF with Wichura's algorithm AS241, accurate to about 1e-16 relative.
+        template <class V>
+        inline V inverse_normal_cdf(const V p)
+        {
+            const V q = p - V(0.5);
+            return select(max(q, V(0.0) - q) < V(0.425), inverse_normal_cdf_central(q), inverse_normal_cdf_tail(p));
+        }
+
+        inline Vec1 inverse_normal_cdf(const Vec1 p)
+        {
+            const Vec1 q = p - Vec1(0.5);
+            if (max(q, Vec1(0.0) - q).v < 0.425)
+                return inverse_normal_cdf_central(q);
+            return inverse_normal_cdf_tail(p);
+        }
+
+        // Bulk version of inverse_normal_cdf, p and out may be the same array. The central formula runs on every
+        // value and the tail formula only on the roughly 15% of values outside the central region, gathered into a
+        // contiguous buffer. Values are the same as inverse_normal_cdf element by element.
+        template <class V>
+        inline void inverse_normal_cdf(const double* p, double* out, const size_t size)
+        {
+            const size_t chunk = 256;
+            double tail_p[chunk + V::width];
+            size_t tail_index[chunk];
+            for (size_t first = 0; first < size; first += chunk)
+            {
+                const size_t n = size - first < chunk ? size - first : chunk;
+                const double* pc = p + first;
+                double* oc = out + first;
+                size_t num_tail = 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const double q = pc[i] - 0.5;
+                    tail_index[num_tail] = i;
+                    tail_p[num_tail] = pc[i];
+                    num_tail += (q > 0.0 - q ? q : 0.0 - q) < 0.425 ? 0 : 1;
+                }
+
+                size_t i = 0;
+                for (; i + V::width <= n; i += V::width)
+                    inverse_normal_cdf_central(V::load(pc + i) - V(0.5)).store(oc + i);
+                for (; i < n; ++i)
+                    inverse_normal_cdf_central(Vec1(pc[i]) - Vec1(0.5)).store(oc + i);
+
+                i = 0;
+                for (; i + V::width <= num_tail; i += V::width)
+                    inverse_normal_cdf_tail(V::load(tail_p + i)).store(tail_p + i);
+                for (; i < num_tail; ++i)
+                    inverse_normal_cdf_tail(Vec1(tail_p[i])).store(tail_p + i);
+                for (i = 0; i < num_tail; ++i)
+                    oc[tail_index[i]] = tail_p[i];
+            }
+        }
+
+        // Standard normal CDF with the rational approximations of Cody (1969), as in R's pnorm, for the lower tail at
+        // a = -|x|: Phi(-a) = 1/2 - a P(a^2) / Q(a^2) for a < 0.674, exp(-a^2 / 2) P(a) / Q(a) for a < sqrt(32) and
+        // exp(-a^2 / 2) (1 / sqrt(2 pi) - z P(z) / Q(z)) / a with z = 1 / a^2 beyond, where exp(-a^2 / 2) is split
+        // into two exponentials to avoid the rounding of a^2. The last branch is skipped when no lane needs it.
+        // Accurate to about 1e-16 absolute and 2e-15 relative in the lower tail.
+        template <class V>
+        inline V normal_cdf(const V x)
+        {
+            const V a = max(x, V(0.0) - x);
+            const V s = a * a;
+            V n = V(0.065682337918207449113) * s + V(2.2352520354606839287);
+            n = n * s + V(161.02823106855587881);
+            n = n * s + V(1067.6894854603709582);
+            n = n * s + V(18154.981253343561249);
+            V d = s + V(47.20258190468824187);
+            d = d * s + V(976.09855173777669322);
+            d = d * s + V(10260.932208618978205);
+            d = d * s + V(45507.789335026729956);
+
+            V m = V(1.0765576773720192317e-8) * a + V(0.39894151208813466764);
+            m = m * a + V(8.8831497943883759412);
+            m = m * a + V(93.506656132177855979);
+            m = m * a + V(597.27027639480026226);
+            m = m * a + V(2494.5375852903726711);
+            m = m * a + V(6848.1904505362823326);
+            m = m * a + V(11602.651437647350124);
+            m = m * a + V(9842.7148383839780218);
+            V q = a + V(22.266688044328115691);
+            q = q * a + V(235.38790178262499861);
+            q = q * a + V(1519.377599407554805);
+            q = q * a + V(6485.558298266760755);
+            q = q * a + V(18615.571640885098091);
+            q = q * a + V(34900.952721145977266);
+            q = q * a + V(38912.003286093271411);
+            q = q * a + V(19685.429676859990727);
+
+            const auto central = a < V(0.67448975);
+            const V e = exp(V(-0.5) * s);
+            V lower = select(central, V(0.5), V(0.0))
+                + select(central, V(0.0) - a, e) * select(central, n, m) / select(central, d, q);
+
+            const auto middle = a < V(5.6568542494923802);
+            if (!all(middle))
+            {
+                const V z = V(1.0) / s;
+                V tn = V(0.02307344176494017303) * z + V(0.21589853405795699);
+                tn = tn * z + V(0.1274011611602473639);
+                tn = tn * z + V(0.022235277870649807);
+                tn = tn * z + V(0.001421619193227893466);
+                tn = tn * z + V(2.9112874951168792e-5);
+                V td = z + V(1.28426009614491121);
+                td = td * z + V(0.468238212480865118);
+                td = td * z + V(0.0659881378689285515);
+                td = td * z + V(0.00378239633202758244);
+                td = td * z + V(7.29751555083966205e-5);
+                const V b = min(a, V(37.5));
+                const V rounded = round(b * V(16.0)) * V(0.0625);
+                const V split = exp(V(-0.5) * rounded * rounded) * exp(V(-0.5) * (b - rounded) * (b + rounded));
+                const V mills = (V(0.398942280401432677939946059934) - z * tn / td) / b;
+                lower = select(middle, lower, split * mills);
+                lower = select(a > V(37.5), V(0.0), lower);
+            }
+            return select(x > V(0.0), V(1.0) - lower, lower);
+        }
+    }
+    }
+}
\ No newline at end of file
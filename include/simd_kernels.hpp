@@ -0,0 +1,803 @@
+#pragma once
+// Included only by the simd_kernels_*.cpp translation units, each compiled with its own instruction set flags and
+// defining CLTVT_SIMD_NAMESPACE before any include. Everything below has internal linkage, and simd.hpp puts its inline
+// functions in the CLTVT_SIMD_NAMESPACE namespace, so no code compiled for one instruction set can be shared with another.
+// The kernels only take raw pointers, which keeps the inline functions of the standard library out of them.
+#include <preliminaries.hpp>
+#include <dispatch.hpp>
+#include <black_scholes.hpp>
+#include <heston.hpp>
+#include <special_functions.hpp>
+#include <simd.hpp>
+
+namespace cltvt
+{
+    namespace
+    {
+        template <class V>
+        void normals_from_bits(const uint64_t* bits, double* out, const size_t size)
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+                V::load_uniform(bits + i).store(out + i);
+            for (; i < size; ++i)
+                simd::Vec1::load_uniform(bits + i).store(out + i);
+            simd::inverse_normal_cdf<V>(out, out, size);
+        }
+
+        template <class V>
+        void inverse_normal_cdf_array(const double* p, double* out, const size_t size)
+        {
+            simd::inverse_normal_cdf<V>(p, out, size);
+        }
+
+        template <class V>
+        void exp_array(const double* x, double* out, const size_t size)
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+                simd::exp(V::load(x + i)).store(out + i);
+            for (; i < size; ++i)
+                simd::exp(simd::Vec1::load(x + i)).store(out + i);
+        }
+
+        template <class V, bool CALL>
+        inline V black_price(const V forward, const V strike, const V total_vol, const V discount_factor)
+        {
+            const V d1 = simd::log(forward / strike) / total_vol + V(0.5) * total_vol;
+            const V d2 = d1 - total_vol;
+            if (CALL)
+                return discount_factor * (forward * simd::normal_cdf(d1) - strike * simd::normal_cdf(d2));
+            return discount_factor * (strike * simd::normal_cdf(V(0.0) - d2) - forward * simd::normal_cdf(V(0.0) - d1));
+        }
+
+        template <class V, bool CALL>
+        void black_lanes(
+            const double* forwards,
+            const double* strikes,
+            const double* total_vols,
+            const double* discount_factors,
+            double* prices,
+            const size_t size
+        )
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+            {
+                const V price = black_price<V, CALL>(
+                    V::load(forwards + i),
+                    V::load(strikes + i),
+                    V::load(total_vols + i),
+                    V::load(discount_factors + i)
+                );
+                price.store(prices + i);
+            }
+            for (; i < size; ++i)
+            {
+                const simd::Vec1 price = black_price<simd::Vec1, CALL>(
+                    forwards[i], strikes[i], total_vols[i], discount_factors[i]
+                );
+                price.store(prices + i);
+            }
+        }
+
+        template <class V>
+        void black_prices(
+            const bool call,
+            const double* forwards,
+            const double* strikes,
+            const double* total_vols,
+            const double* discount_factors,
+            double* prices,
+            const size_t size
+        )
+        {
+            if (call)
+                black_lanes<V, true>(forwards, strikes, total_vols, discount_factors, prices, size);
+            else
+                black_lanes<V, false>(forwards, strikes, total_vols, discount_factors, prices, size);
+        }
+
+        template <class V, bool CALL>
+        void black_strike_lanes(
+            const double forward,
+            const double total_vol,
+            const double discount_factor,
+            const double* strikes,
+            double* prices,
+            const size_t size
+        )
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+                black_price<V, CALL>(V(forward), V::load(strikes + i), V(total_vol), V(discount_factor)).store(prices + i);
+            for (; i < size; ++i)
+                black_price<simd::Vec1, CALL>(forward, strikes[i], total_vol, discount_factor).store(prices + i);
+        }
+
+        template <class V>
+        void black_strike_prices(
+            const bool call,
+            const double forward,
+            const double total_vol,
+            const double discount_factor,
+            const double* strikes,
+            double* prices,
+            const size_t size
+        )
+        {
+            if (call)
+                black_strike_lanes<V, true>(forward, total_vol, discount_factor, strikes, prices, size);
+            else
+                black_strike_lanes<V, false>(forward, total_vol, discount_factor, strikes, prices, size);
+        }
+
+        template <class V>
+        struct GreeksLanes
+        {
+            V price;
+            V delta;
+            V gamma;
+            V vega;
+            V rho;
+            V repo_rho;
+            V theta;
+        };
+
+        template <class V, bool CALL>
+        GreeksLanes<V> black_scholes_greek_lanes(
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const double volatility,
+            const V strike,
+            const V tenor
+        )
+        {
+            const V sign(CALL ? 1.0 : -1.0);
+            const V sqrt_tenor = simd::sqrt(tenor);
+            const V total_vol = V(volatility) * sqrt_tenor;
+            const V discounted_forward = V(spot) * simd::exp(V(0.0) - V(repo_rate) * tenor);
+            const V discounted_strike = strike * simd::exp(V(0.0) - V(discount_rate) * tenor);
+            const V d1 = simd::log(discounted_forward / discounted_strike) / total_vol + V(0.5) * total_vol;
+            const V d2 = d1 - total_vol;
+            const V n1 = simd::normal_cdf(sign * d1);
+            const V n2 = simd::normal_cdf(sign * d2);
+            const V density = simd::exp(V(-0.5) * d1 * d1) * V(0.398942280401432677939946059934);
+
+            GreeksLanes<V> greeks;
+            greeks.price = sign * (discounted_forward * n1 - discounted_strike * n2);
+            greeks.delta = sign * discounted_forward / V(spot) * n1;
+            greeks.gamma = discounted_forward * density / (V(spot * spot) * total_vol);
+            greeks.vega = discounted_forward * density * sqrt_tenor;
+            greeks.rho = sign * tenor * discounted_strike * n2;
+            greeks.repo_rho = V(0.0) - sign * tenor * discounted_forward * n1;
+            greeks.theta = V(-0.5 * volatility) * discounted_forward * density / sqrt_tenor
+                + sign * (V(repo_rate) * discounted_forward * n1 - V(discount_rate) * discounted_strike * n2);
+            return greeks;
+        }
+
+        template <class V>
+        void store_greeks(const GreeksLanes<V>& lanes, BlackScholesGreeks* greeks)
+        {
+            double values[7][V::width];
+            lanes.price.store(values[0]);
+            lanes.delta.store(values[1]);
+            lanes.gamma.store(values[2]);
+            lanes.vega.store(values[3]);
+            lanes.rho.store(values[4]);
+            lanes.repo_rho.store(values[5]);
+            lanes.theta.store(values[6]);
+            for (size_t k = 0; k < V::width; ++k)
+            {
+                BlackScholesGreeks& g = greeks[k];
+                g.price = values[0][k];
+                g.delta = values[1][k];
+                g.gamma = values[2][k];
+                g.vega = values[3][k];
+                g.rho = values[4][k];
+                g.repo_rho = values[5][k];
+                g.theta = values[6][k];
+            }
+        }
+
+        template <class V, bool CALL>
+        void black_scholes_greek_batch(
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const double volatility,
+            const double* strikes,
+            const double* tenors,
+            BlackScholesGreeks* greeks,
+            const size_t size
+        )
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+            {
+                store_greeks(black_scholes_greek_lanes<V, CALL>(
+                    spot, discount_rate, repo_rate, volatility, V::load(strikes + i), V::load(tenors + i)
+                ), greeks + i);
+            }
+            for (; i < size; ++i)
+            {
+                store_greeks(black_scholes_greek_lanes<simd::Vec1, CALL>(
+                    spot, discount_rate, repo_rate, volatility, strikes[i], tenors[i]
+                ), greeks + i);
+            }
+        }
+
+        template <class V>
+        void black_scholes_greeks(
+            const bool call,
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const double volatility,
+            const double* strikes,
+            const double* tenors,
+            BlackScholesGreeks* greeks,
+            const size_t size
+        )
+        {
+            if (call)
+                black_scholes_greek_batch<V, true>(spot, discount_rate, repo_rate, volatility, strikes, tenors, greeks, size);
+            else
+                black_scholes_greek_batch<V, false>(spot, discount_rate, repo_rate, volatility, strikes, tenors, greeks, size);
+        }
+
+        // Total volatility s of an out-of-the-money call on the normalised Black function
+        // b(x, s) = exp(x / 2) N(x / s + s / 2) - exp(-x / 2) N(x / s - s / 2), x <= 0, given 0 < beta < exp(x / 2).
+        // Below the inflection point s_c = sqrt(-2 x) the objective is 1 / log b, which is close to quadratic in s,
+        // above it log(exp(x / 2) - b), whose complement is computed without cancellation, as in Jaeckel's "Let's Be
+        // Rational" (2015). The initial guesses interpolate 1 / log b between 0 and s_c and invert the large s
+        // asymptotics exp(x / 2) - b ~ 2 cosh(x / 2) N(-s / 2). Third order Householder steps, kept inside a bracket
+        // that each evaluation narrows, converge in at most 6 iterations. A lane keeps its value once it has converged,
+        // so that it takes the same steps whatever the width and the other lanes.
+        template <class V>
+        V implied_total_vol(const V beta, const V x)
+        {
+            const V b_max = simd::exp(V(0.5) * x);
+            const V inv_b_max = V(1.0) / b_max;
+            const V s_c = simd::sqrt(V(-2.0) * x);
+            const V b_c = b_max * simd::normal_cdf(x / s_c + V(0.5) * s_c)
+                - inv_b_max * simd::normal_cdf(x / s_c - V(0.5) * s_c);
+            const auto lower = beta < simd::select(s_c > V(0.0), b_c, V(0.0));
+            const V log_beta = simd::log(beta);
+            const V log_complement = simd::log(b_max - beta);
+
+            const V s_lower = simd::min(s_c * simd::sqrt(simd::log(b_c) / log_beta), s_c);
+            const V p = simd::min((b_max - beta) / (b_max + inv_b_max), V(0.5));
+            const V s_upper = simd::max(V(-2.0) * simd::inverse_normal_cdf(p), s_c);
+            V s = simd::select(lower, s_lower, s_upper);
+            V s_low = simd::select(lower, V(0.0), s_c);
+            V s_high = simd::select(lower, s_c, V(INF));
+            V converged(0.0);
+            for (size_t iteration = 0; iteration < 16; ++iteration)
+            {
+                const V d1 = x / s + V(0.5) * s;
+                const V d2 = x / s - V(0.5) * s;
+                const V n1 = simd::normal_cdf(simd::select(lower, d1, V(0.0) - d1));
+                const V n2 = simd::normal_cdf(d2);
+                const V value = simd::select(lower, b_max * n1 - inv_b_max * n2, b_max * n1 + inv_b_max * n2);
+                // Below s_c the difference can round to 0 or less at small s, which is then taken to be too small.
+                const auto valid = value > V(0.0);
+                const V log_value = simd::log(value);
+
+                // Derivatives of b: b' = exp(-(x^2 / s^2 + s^2 / 4) / 2) / sqrt(2 pi), b'' = b' a1, b''' = b' a2.
+                const V exponent = V(-0.5) * (x * x / (s * s) + V(0.25) * s * s);
+                const V vega = simd::exp(exponent) * V(0.398942280401432677939946059934);
+                const V a1 = x * x / (s * s * s) - V(0.25) * s;
+                const V a2 = a1 * a1 - V(3.0) * x * x / (s * s * s * s) - V(0.25);
+                const V q = vega / value;
+                const V inv_log = V(1.0) / log_value;
+                const V f = simd::select(
+                    valid,
+                    simd::select(lower, inv_log - V(1.0) / log_beta, log_value - log_complement),
+                    V(1.0)
+                );
+                const V f1 = simd::select(lower, V(0.0) - q * inv_log * inv_log, V(0.0) - q);
+                const V h2 = simd::select(lower, a1 - q - V(2.0) * q * inv_log, a1 + q);
+                const V h3 = simd::select(
+                    lower,
+                    a2 - V(3.0) * q * a1 + V(2.0) * q * q - V(6.0) * q * inv_log * (a1 - q - q * inv_log),
+                    a2 + V(3.0) * q * a1 + V(2.0) * q * q
+                );
+
+                // Both objectives decrease with s.
+                s_low = simd::select(f > V(0.0), s, s_low);
+                s_high = simd::select(f < V(0.0), s, s_high);
+                const V newton = V(0.0) - f / f1;
+                const V step = newton * (V(1.0) + V(0.5) * h2 * newton)
+                    / (V(1.0) + newton * (h2 + h3 * newton * V(1.0 / 6.0)));
+                const V fallback = simd::select(s_high < V(INF), V(0.5) * (s_low + s_high), V(2.0) * s);
+                V next = simd::select(valid, s + step, fallback);
+                next = simd::select(next < s_low, fallback, next);
+                next = simd::select(s_high < next, fallback, next);
+                const V change = simd::max(next - s, s - next);
+                s = simd::select(converged > V(0.0), s, next);
+                // The error after a step is about the cube of the step.
+                converged = simd::select(change < V(1e-6) * s, V(1.0), converged);
+                if (simd::all(converged > V(0.0)))
+                    break;
+            }
+            return s;
+        }
+
+        // Volatility of the option with the price, strike and tenor of each lane: 0 at or below the intrinsic value and
+        // INF at or above the forward (call) or strike (put) upper bound, both up to a few roundings of the price.
+        template <class V, bool CALL>
+        V black_scholes_implied_volatility(
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const V price,
+            const V strike,
+            const V tenor
+        )
+        {
+            const V forward = V(spot) * simd::exp(V(discount_rate - repo_rate) * tenor);
+            const V scale = simd::exp(V(0.0) - V(discount_rate) * tenor) * simd::sqrt(forward * strike);
+            const V x = simd::log(forward / strike);
+            const V half_moneyness = simd::exp(V(0.5) * x);
+            const V intrinsic = simd::max(V(CALL ? 1.0 : -1.0) * (half_moneyness - V(1.0) / half_moneyness), V(0.0));
+
+            // By put-call parity and b(x, s, put) = b(-x, s, call), the time value is the price of an out-of-the-money
+            // call with x <= 0.
+            const V normalised_price = price / scale;
+            const V beta = normalised_price - intrinsic;
+            const V x_otm = simd::min(x, V(0.0) - x);
+            const V b_max = simd::exp(V(0.5) * x_otm);
+            const V upper_bound = CALL ? half_moneyness : V(1.0) / half_moneyness;
+            // Four roundings of the price, and at least the smallest normal number.
+            const V resolution = V(8.881784197001252e-16) * normalised_price + V(1e-300);
+            const auto below = beta < resolution;
+            const auto above = upper_bound - normalised_price < resolution;
+            const V beta_safe = simd::select(below, V(0.5) * b_max, simd::select(above, V(0.5) * b_max, beta));
+            const V s = implied_total_vol(beta_safe, x_otm);
+            const V volatility = s / simd::sqrt(tenor);
+            return simd::select(below, V(0.0), simd::select(above, V(INF), volatility));
+        }
+
+        template <class V, bool CALL>
+        void black_scholes_implied_volatility_batch(
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const double* prices,
+            const double* strikes,
+            const double* tenors,
+            double* volatilities,
+            const size_t size
+        )
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+            {
+                const V volatility = black_scholes_implied_volatility<V, CALL>(
+                    spot, discount_rate, repo_rate, V::load(prices + i), V::load(strikes + i), V::load(tenors + i)
+                );
+                volatility.store(volatilities + i);
+            }
+            for (; i < size; ++i)
+            {
+                volatilities[i] = black_scholes_implied_volatility<simd::Vec1, CALL>(
+                    spot, discount_rate, repo_rate, prices[i], strikes[i], tenors[i]
+                ).v;
+            }
+        }
+
+        template <class V>
+        void black_scholes_implied_volatilities(
+            const bool call,
+            const double spot,
+            const double discount_rate,
+            const double repo_rate,
+            const double* prices,
+            const double* strikes,
+            const double* tenors,
+            double* volatilities,
+            const size_t size
+        )
+        {
+            if (call)
+            {
+                black_scholes_implied_volatility_batch<V, true>(
+                    spot, discount_rate, repo_rate, prices, strikes, tenors, volatilities, size
+                );
+            }
+            else
+            {
+                black_scholes_implied_volatility_batch<V, false>(
+                    spot, discount_rate, repo_rate, prices, strikes, tenors, volatilities, size
+                );
+            }
+        }
+
+        template <class V>
+        void advance_vt_lanes(
+            double* levels,
+            double* vars,
+            const double* normals,
+            const size_t num_steps,
+            const size_t num_lanes,
+            const double drift_dt,
+            const double vol_sqrt_dt,
+            const double rate_dt,
+            const double target_vol,
+            const double lamb,
+            const double var_weight
+        )
+        {
+            for (size_t lane = 0; lane < num_lanes; lane += V::width)
+            {
+                V level = V::load(levels + lane);
+                V var = V::load(vars + lane);
+                const double* z = normals + lane;
+                for (size_t i = 0; i < num_steps; ++i, z += num_lanes)
+                {
+                    const V ret = simd::expm1(V(drift_dt) + V(vol_sqrt_dt) * V::load(z));
+                    const V w = V(target_vol) / simd::sqrt(var);
+                    level = level * (V(1.0) + (V(1.0) - w) * V(rate_dt) + w * ret);
+                    var = V(lamb) * var + V(var_weight) * ret * ret;
+                }
+                level.store(levels + lane);
+                var.store(vars + lane);
+            }
+        }
+
+        template <class V>
+        void advance_vt_returns(
+            double* levels,
+            double* vars,
+            const double* rets,
+            const size_t num_steps,
+            const size_t num_lanes,
+            const double rate_dt,
+            const double target_vol,
+            const double lamb,
+            const double var_weight
+        )
+        {
+            for (size_t lane = 0; lane < num_lanes; lane += V::width)
+            {
+                V level = V::load(levels + lane);
+                V var = V::load(vars + lane);
+                const double* r = rets + lane;
+                for (size_t i = 0; i < num_steps; ++i, r += num_lanes)
+                {
+                    const V ret = V::load(r);
+                    const V w = V(target_vol) / simd::sqrt(var);
+                    level = level * (V(1.0) + (V(1.0) - w) * V(rate_dt) + w * ret);
+                    var = V(lamb) * var + V(var_weight) * ret * ret;
+                }
+                level.store(levels + lane);
+                var.store(vars + lane);
+            }
+        }
+
+        template <class V>
+        void advance_vt_sweep(
+            double* levels,
+            double* vars,
+            const double* rets,
+            const size_t num_steps,
+            const size_t num_lanes,
+            const double rate_dt,
+            const double* target_vols,
+            const double* lambs,
+            const double* var_weights
+        )
+        {
+            for (size_t lane = 0; lane < num_lanes; lane += V::width)
+            {
+                const V target_vol = V::load(target_vols + lane);
+                const V lamb = V::load(lambs + lane);
+                const V var_weight = V::load(var_weights + lane);
+                V level = V::load(levels + lane);
+                V var = V::load(vars + lane);
+                for (size_t i = 0; i < num_steps; ++i)
+                {
+                    const V ret(rets[i]);
+                    const V w = target_vol / simd::sqrt(var);
+                    level = level * (V(1.0) + (V(1.0) - w) * V(rate_dt) + w * ret);
+                    var = lamb * var + var_weight * ret * ret;
+                }
+                level.store(levels + lane);
+                var.store(vars + lane);
+            }
+        }
+
+        // state holds six rows of num_lanes values: levels, vars, d levels / d volatility, d vars / d volatility,
+        // d levels / d discount rate and d vars / d discount rate. d_rets holds the derivatives of rets with respect to
+        // the volatility followed by those with respect to the discount rate.
+        template <class V>
+        void advance_vt_derivatives(
+            double* state,
+            const size_t num_lanes,
+            const double* rets,
+            const double* d_rets,
+            const size_t num_steps,
+            const double dt,
+            const double rate_dt,
+            const double* target_vols,
+            const double* lambs,
+            const double* var_weights
+        )
+        {
+            for (size_t lane = 0; lane < num_lanes; lane += V::width)
+            {
+                const V target_vol = V::load(target_vols + lane);
+                const V lamb = V::load(lambs + lane);
+                const V var_weight = V::load(var_weights + lane);
+                V level = V::load(state + lane);
+                V var = V::load(state + num_lanes + lane);
+                V d_level_vol = V::load(state + 2 * num_lanes + lane);
+                V d_var_vol = V::load(state + 3 * num_lanes + lane);
+                V d_level_rate = V::load(state + 4 * num_lanes + lane);
+                V d_var_rate = V::load(state + 5 * num_lanes + lane);
+                for (size_t i = 0; i < num_steps; ++i)
+                {
+                    const V ret(rets[i]);
+                    const V d_ret_vol(d_rets[i]);
+                    const V d_ret_rate(d_rets[num_steps + i]);
+                    const V w = target_vol / simd::sqrt(var);
+                    const V d_w = V(-0.5) * w / var;
+                    const V growth = V(1.0) + (V(1.0) - w) * V(rate_dt) + w * ret;
+                    const V excess = ret - V(rate_dt);
+                    const V d_var_weight = V(2.0) * var_weight * ret;
+                    d_level_vol = d_level_vol * growth + level * (d_w * d_var_vol * excess + w * d_ret_vol);
+                    d_level_rate = d_level_rate * growth + level * (d_w * d_var_rate * excess + w * d_ret_rate + (V(1.0) - w) * V(dt));
+                    d_var_vol = lamb * d_var_vol + d_var_weight * d_ret_vol;
+                    d_var_rate = lamb * d_var_rate + d_var_weight * d_ret_rate;
+                    level = level * growth;
+                    var = lamb * var + var_weight * ret * ret;
+                }
+                level.store(state + lane);
+                var.store(state + num_lanes + lane);
+                d_level_vol.store(state + 2 * num_lanes + lane);
+                d_var_vol.store(state + 3 * num_lanes + lane);
+                d_level_rate.store(state + 4 * num_lanes + lane);
+                d_var_rate.store(state + 5 * num_lanes + lane);
+            }
+        }
+
+        template <class V>
+        void lognormal_returns(
+            const double* normals,
+            double* out,
+            const size_t size,
+            const double drift_dt,
+            const double vol_sqrt_dt
+        )
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+                simd::expm1(V(drift_dt) + V(vol_sqrt_dt) * V::load(normals + i)).store(out + i);
+            for (; i < size; ++i)
+                simd::expm1(simd::Vec1(drift_dt) + simd::Vec1(vol_sqrt_dt) * simd::Vec1::load(normals + i)).store(out + i);
+        }
+
+        // The QE step of HestonQEStep::advance on V::width lanes. Both branches are evaluated and selected lane by lane,
+        // each of them only if some lane takes it, which with small time steps leaves the exponential branch to the
+        // paths whose variance is close to zero.
+        template <class V>
+        void advance_heston_lanes(
+            const HestonQEStep* step,
+            double* vars,
+            double* rets,
+            const double* normals,
+            const size_t num_steps,
+            const size_t num_lanes
+        )
+        {
+            const HestonQEStep s = *step;
+            const double uncorrected_var_coeff = s.k1 + 0.5 * s.k3;
+            for (size_t lane = 0; lane < num_lanes; lane += V::width)
+            {
+                V var = V::load(vars + lane);
+                const double* z = normals + lane;
+                double* r = rets + lane;
+                for (size_t i = 0; i < num_steps; ++i, z += 2 * num_lanes, r += num_lanes)
+                {
+                    const V z_var = V::load(z);
+                    const V m = V(s.decay) * var + V(s.mean_shift);
+                    const V m2 = m * m;
+                    const V s2 = V(s.var_s2) * var + V(s.const_s2);
+                    const V psi_c_m2 = V(HestonQEStep::PSI_C) * m2;
+                    const auto exponential = s2 > psi_c_m2;
+                    const V uncorrected_log_mgf = V(-s.k0) - V(uncorrected_var_coeff) * var;
+                    V next_var(0.0);
+                    V log_mgf(0.0);
+                    if (!simd::all(exponential))
+                    {
+                        const V two_over_psi = V(2.0) * m2 / s2;
+                        const V b2 = two_over_psi - V(1.0) + simd::sqrt(two_over_psi * (two_over_psi - V(1.0)));
+                        const V scale = m / (V(1.0) + b2);
+                        const V x = simd::sqrt(b2) + z_var;
+                        const V shrink = V(1.0) - V(2.0 * s.mgf_coeff) * scale;
+                        next_var = scale * x * x;
+                        log_mgf = simd::select(
+                            shrink > V(0.0),
+                            V(s.mgf_coeff) * b2 * scale / shrink - V(0.5) * simd::log(shrink),
+                            uncorrected_log_mgf
+                        );
+                    }
+                    if (!simd::all(s2 < psi_c_m2))
+                    {
+                        const V p = (s2 - m2) / (s2 + m2);
+                        const V one_minus_p = V(1.0) - p;
+                        const V beta = one_minus_p / m;
+                        const V tail = simd::normal_cdf(V(0.0) - z_var);
+                        const V exponential_var = simd::select(
+                            tail < one_minus_p,
+                            simd::log(one_minus_p / tail) / beta,
+                            V(0.0)
+                        );
+                        const V exponential_log_mgf = simd::select(
+                            beta > V(s.mgf_coeff),
+                            simd::log(p + beta * one_minus_p / (beta - V(s.mgf_coeff))),
+                            uncorrected_log_mgf
+                        );
+                        next_var = simd::select(exponential, exponential_var, next_var);
+                        log_mgf = simd::select(exponential, exponential_log_mgf, log_mgf);
+                    }
+                    const V log_return = V(s.drift_dt) - log_mgf - V(0.5 * s.k3) * var + V(s.k2) * next_var
+                        + simd::sqrt(V(s.k3) * var + V(s.k4) * next_var) * V::load(z + num_lanes);
+                    simd::expm1(log_return).store(r);
+                    var = next_var;
+                }
+                var.store(vars + lane);
+            }
+        }
+
+        // sum_k log(1 - x q^k) = -sum_m coeffs[m - 1] x^m.
+        template <class V>
+        inline V q_log_series(const double* coeffs, const size_t num_coeffs, const V x)
+        {
+            V p(coeffs[num_coeffs - 1]);
+            for (size_t m = num_coeffs - 1; m > 0; --m)
+                p = p * x + V(coeffs[m - 1]);
+            return V(0.0) - p * x;
+        }
+
+        template <class V>
+        V q_pochhammer_log_lanes(
+            const V a,
+            const double q,
+            const double log_q,
+            const double* powers,
+            const size_t num_powers,
+            const double* coeffs,
+            const size_t num_coeffs
+        )
+        {
+            // Leading factors of a < -2: n0 = floor(log(|a| / 2) / log(1 / q)) + 1 gives |a| q^n0 <= 2 < |a| q^(n0 - 1).
+            const V abs_a = simd::max(a, V(0.0) - a);
+            const auto large = a < V(-2.0);
+            const V safe_abs_a = simd::select(large, abs_a, V(4.0));
+            const V log_abs_a = simd::log(safe_abs_a);
+            const V y = (log_abs_a - V(0.6931471805599453)) / V(-log_q);
+            const V n0 = simd::round(y - V(0.5)) + V(1.0);
+            const V qn0 = simd::exp(n0 * V(log_q));
+            const V head = n0 * log_abs_a + V(0.5) * n0 * (n0 - V(1.0)) * V(log_q)
+                + q_log_series(coeffs, num_coeffs, V(-1.0) / (safe_abs_a * qn0 / V(q)))
+                - q_log_series(coeffs, num_coeffs, V(-q) / safe_abs_a);
+            V s = simd::select(large, head, V(0.0));
+            const V x0 = simd::select(large, a * qn0, a);
+
+            for (size_t j = 0; j < num_powers; j += QPochhammer::BLOCK)
+            {
+                V product(1.0);
+                for (size_t i = j; i < j + QPochhammer::BLOCK; ++i)
+                    product = product * (V(1.0) - x0 * V(powers[i]));
+                s = s + simd::log(product);
+            }
+            return s + q_log_series(coeffs, num_coeffs, x0 * V(powers[num_powers - 1] * q));
+        }
+
+        template <class V>
+        void q_pochhammer_log(
+            const double* a,
+            double* out,
+            const size_t size,
+            const double q,
+            const double log_q,
+            const double* powers,
+            const size_t num_powers,
+            const double* coeffs,
+            const size_t num_coeffs
+        )
+        {
+            size_t i = 0;
+            for (; i + V::width <= size; i += V::width)
+                q_pochhammer_log_lanes(V::load(a + i), q, log_q, powers, num_powers, coeffs, num_coeffs).store(out + i);
+            for (; i < size; ++i)
+            {
+                q_pochhammer_log_lanes(simd::Vec1::load(a + i), q, log_q, powers, num_powers, coeffs, num_coeffs)
+                    .store(out + i);
+            }
+        }
+
+        // Clenshaw's recurrence for sum_j coeffs[j] T_j(x).
+        template <class V>
+        inline V chebyshev(const double* coeffs, const size_t num_coeffs, const V x)
+        {
+            const V two_x = x + x;
+            V b1(0.0);
+            V b2(0.0);
+            for (size_t j = num_coeffs - 1; j > 0; --j)
+            {
+                const V b = two_x * b1 - b2 + V(coeffs[j]);
+                b2 = b1;
+                b1 = b;
+            }
+            return x * b1 - b2 + V(coeffs[0]);
+        }
+
+        template <class V>
+        void limit_multiplier_lanes(
+            const double* lambdas,
+            double* us,
+            double* vs,
+            const size_t begin,
+            const size_t end,
+            const double u_scale,
+            const double* log_u_coeffs,
+            const double* log_v_coeffs,
+            const size_t num_coeffs
+        )
+        {
+            for (size_t i = begin; i < end; i += V::width)
+            {
+                const V x = V(-u_scale) * simd::log(V::load(lambdas + i)) - V(1.0);
+                if (us)
+                    simd::exp(chebyshev(log_u_coeffs, num_coeffs, x)).store(us + i);
+                if (vs)
+                    simd::exp(chebyshev(log_v_coeffs, num_coeffs, x)).store(vs + i);
+            }
+        }
+
+        template <class V>
+        void limit_multipliers(
+            const double* lambdas,
+            double* us,
+            double* vs,
+            const size_t size,
+            const double u_scale,
+            const double* log_u_coeffs,
+            const double* log_v_coeffs,
+            const size_t num_coeffs
+        )
+        {
+            const size_t head = size - size % V::width;
+            limit_multiplier_lanes<V>(lambdas, us, vs, 0, head, u_scale, log_u_coeffs, log_v_coeffs, num_coeffs);
+            limit_multiplier_lanes<simd::Vec1>(lambdas, us, vs, head, size, u_scale, log_u_coeffs, log_v_coeffs, num_coeffs);
+        }
+
+        template <class V>
+        SimdKernels make_simd_kernels(const SimdIsa isa)
+        {
+            SimdKernels kernels;
+            kernels.isa = isa;
+            kernels.width = V::width;
+            kernels.normals_from_bits = &normals_from_bits<V>;
+            kernels.inverse_normal_cdf = &inverse_normal_cdf_array<V>;
+            kernels.exp = &exp_array<V>;
+            kernels.black_prices = &black_prices<V>;
+            kernels.black_strike_prices = &black_strike_prices<V>;
+            kernels.black_scholes_greeks = &black_scholes_greeks<V>;
+            kernels.black_scholes_implied_volatilities = &black_scholes_implied_volatilities<V>;
+            kernels.advance_vt_lanes = &advance_vt_lanes<V>;
+            kernels.advance_vt_returns = &advance_vt_returns<V>;
+            kernels.advance_vt_sweep = &advance_vt_sweep<V>;
+            kernels.advance_vt_derivatives = &advance_vt_derivatives<V>;
+            kernels.lognormal_returns = &lognormal_returns<V>;
+            kernels.advance_heston_lanes = &advance_heston_lanes<V>;
+            kernels.q_pochhammer_log = &q_pochhammer_log<V>;
+            kernels.limit_multipliers = &limit_multipliers<V>;
+            return kernels;
+        }
+    }
+}
\ No newline at end of file
@@ -1,8 +1,47 @@
-#pragma once
-
-namespace cltvt
-{
-    double normal_cdf(const double x);
-
-    double q_pochhammer(const double a, const double q, const int n = -1);
+#pragma once
+#include <preliminaries.hpp>
+#include <vector>
+
+namespace cltvt
+{
+    double normal_cdf(const double x);
+
+    double inverse_normal_cdf(const double p);
+
+    double q_pochhammer(const double a, const double q, const int n = -1);
+
+    // (a; q)_infinity for a fixed 0 < q < 1 and any a < 1, without truncation. log (a; q)_infinity is split into:
+    // - for a < -2, the n0 factors with |a| q^k > 2, where log(1 - a q^k) = log|a| + k log q + log(1 + 1 / (|a| q^k))
+    //   sums in closed form up to two tail series;
+    // - D = log(4) / log(1 / q) direct factors (rounded up to a multiple of 8), multiplied 8 at a time before each log;
+    // - the tail sum_k log(1 - x q^k) = -sum_m x^m / (m (1 - q^m)) for the remaining |x| <= 1/2.
+    // The powers q^j, j < D, and the series coefficients are computed once, so the cost does not grow with |a| and the
+    // number of logarithms is D / 8.
+    class QPochhammer
+    {
+    public:
+        // Number of direct factors multiplied before each log.
+        static const size_t BLOCK = 8;
+
+        QPochhammer(const double q);
+
+        double q() const;
+
+        double operator()(const double a) const;
+
+        double log_value(const double a) const;
+
+        // Writes (a[i]; q)_infinity to out[i], several values at a time with the SIMD kernels selected at runtime.
+        // The values are the same as those of operator().
+        void evaluate(const double* a, double* out, const size_t size) const;
+
+        // Same for log (a[i]; q)_infinity.
+        void evaluate_log(const double* a, double* out, const size_t size) const;
+
+    private:
+        double m_q;
+        double m_log_q;
+        std::vector<double> m_powers;
+        std::vector<double> m_coeffs;
+    };
 }
\ No newline at end of file
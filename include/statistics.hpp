@@ -0,0 +1,211 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <parallel.hpp>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+namespace cltvt
+{
+    // Running mean and variance (Welford's update, merged with Chan et al.'s pairwise formula), which does not suffer
+    // from the cancellation of E[x^2] - E[x]^2.
+    class RunningStatistics
+    {
+    public:
+        RunningStatistics();
+
+        void add(const double x);
+
+        void merge(const RunningStatistics& other);
+
+        void reset();
+
+        size_t count() const;
+
+        double mean() const;
+
+        // Unbiased sample variance.
+        double variance() const;
+
+        double std_dev() const;
+
+        // Standard error of mean().
+        double standard_error() const;
+
+    private:
+        size_t m_count;
+        double m_mean;
+        double m_m2;
+    };
+
+    // Running means, variances and covariance of pairs (x, y), updated and merged like RunningStatistics.
+    class RunningCovariance
+    {
+    public:
+        RunningCovariance();
+
+        void add(const double x, const double y);
+
+        void merge(const RunningCovariance& other);
+
+        void reset();
+
+        size_t count() const;
+
+        double mean_x() const;
+
+        double mean_y() const;
+
+        double variance_x() const;
+
+        double variance_y() const;
+
+        // Unbiased sample covariance.
+        double covariance() const;
+
+    private:
+        size_t m_count;
+        double m_mean_x;
+        double m_mean_y;
+        double m_m2_x;
+        double m_m2_y;
+        double m_cross;
+    };
+
+    class Accumulator;
+    typedef std::shared_ptr<Accumulator> AccumulatorPtr;
+
+    // Online reduction of simulated levels. clone() returns an empty accumulator of the same type and settings, used to
+    // collect the samples of one part of a simulation, which is then combined with merge().
+    class Accumulator
+    {
+    public:
+        virtual ~Accumulator() {}
+
+        virtual void add(const double level) = 0;
+
+        virtual void merge(const Accumulator& other) = 0;
+
+        virtual void reset() = 0;
+
+        virtual AccumulatorPtr clone() const = 0;
+    };
+
+    // Base class of accumulators that keep the running statistics of a function of the level.
+    class StatisticsAccumulator : public Accumulator
+    {
+    public:
+        void add(const double level) override;
+
+        void merge(const Accumulator& other) override;
+
+        void reset() override;
+
+        const RunningStatistics& statistics() const;
+
+    protected:
+        virtual double value(const double level) const = 0;
+
+    private:
+        RunningStatistics m_stats;
+    };
+
+    class LevelStatistics : public StatisticsAccumulator
+    {
+    public:
+        AccumulatorPtr clone() const override;
+
+    protected:
+        double value(const double level) const override;
+    };
+
+    // Statistics of log(level / init_level).
+    class LogLevelStatistics : public StatisticsAccumulator
+    {
+    public:
+        LogLevelStatistics(const double init_level);
+
+        AccumulatorPtr clone() const override;
+
+    protected:
+        double value(const double level) const override;
+
+    private:
+        double m_init_level;
+    };
+
+    // Statistics of discount_factor * max(level - strike, 0).
+    class CallPayoffStatistics : public StatisticsAccumulator
+    {
+    public:
+        CallPayoffStatistics(const double strike, const double discount_factor);
+
+        AccumulatorPtr clone() const override;
+
+    protected:
+        double value(const double level) const override;
+
+    private:
+        double m_strike;
+        double m_discount_factor;
+    };
+
+    const size_t MAX_PARTIAL_ACCUMULATORS = 256;
+
+    // Number of contiguous ranges of whole blocks that simulate_partials splits [0, num_samples) into. It is at most
+    // MAX_PARTIAL_ACCUMULATORS and depends only on num_samples.
+    size_t num_partial_ranges(const size_t num_samples);
+
+    // Calls simulate(begin, end, partials[range]) for every range, partials holding num_partial_ranges(num_samples)
+    // values. Merging the partials in order gives a result that does not depend on num_threads, in bounded memory.
+    template <class Partial, class Simulate>
+    void simulate_partials(std::vector<Partial>& partials, const size_t num_samples, const size_t num_threads, Simulate& simulate)
+    {
+        const size_t total_blocks = num_blocks(num_samples);
+        const size_t num_ranges = num_partial_ranges(num_samples);
+        ASSERT(partials.size() == num_ranges, "partials must hold num_partial_ranges(num_samples) values");
+        auto simulate_range = [&](const size_t range, const size_t) {
+            const size_t begin = range * total_blocks / num_ranges * SIMULATION_BLOCK_SIZE;
+            const size_t end = std::min((range + 1) * total_blocks / num_ranges * SIMULATION_BLOCK_SIZE, num_samples);
+            simulate(begin, end, partials[range]);
+        };
+        ThreadPool::instance().run(num_ranges, num_threads, simulate_range);
+    }
+
+    // Calls simulate(begin, end, partials) through simulate_partials, partials holding a clone of each accumulator in
+    // accs, and merges the partial accumulators into accs in order. The clones are taken from the heap on every call,
+    // so unlike the serial simulations on a warm SimulationWorkspace, the parallel ones are not free of allocations.
+    template <class Simulate>
+    void accumulate_parallel(
+        const std::vector<AccumulatorPtr>& accs,
+        const size_t num_samples,
+        const size_t num_threads,
+        Simulate& simulate
+    )
+    {
+        std::vector<std::vector<AccumulatorPtr>> partials(num_partial_ranges(num_samples));
+        for (std::vector<AccumulatorPtr>& range_partials : partials)
+        {
+            for (const AccumulatorPtr& acc : accs)
+                range_partials.push_back(acc->clone());
+        }
+        simulate_partials(partials, num_samples, num_threads, simulate);
+        for (const std::vector<AccumulatorPtr>& range_partials : partials)
+        {
+            for (size_t i = 0; i < accs.size(); ++i)
+                accs[i]->merge(*range_partials[i]);
+        }
+    }
+
+    // Single accumulator version, simulate(begin, end, partial) receiving the clone of acc.
+    template <class Simulate>
+    void accumulate_parallel(Accumulator& acc, const size_t num_samples, const size_t num_threads, Simulate& simulate)
+    {
+        const std::vector<AccumulatorPtr> accs(1, acc.clone());
+        auto simulate_single = [&](const size_t begin, const size_t end, const std::vector<AccumulatorPtr>& partials) {
+            simulate(begin, end, *partials[0]);
+        };
+        accumulate_parallel(accs, num_samples, num_threads, simulate_single);
+        acc.merge(*accs[0]);
+    }
+}
\ No newline at end of file
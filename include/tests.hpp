@@ -1,21 +1,67 @@
-#pragma once
-
-namespace cltvt
-{
-    void test_multiplier_U_bounds();
-
-    void test_multiplier_V_bounds();
-
-    void test_vt_volatility(const size_t num_samples = 100000);
-
-    void test_vt_volatility_simultaneous_limit(const size_t num_samples = 100000);
-
-    void test_vt_volatility_limit_along_path_1(const size_t num_samples = 100000);
-
-    void test_vt_volatility_limit_along_path_2(const size_t num_samples = 100000);
-
-    void test_vt_pricing(const size_t num_samples = 100000);
-
-    void test_vt_vega(const size_t num_samples = 100000);
-
-}
+#pragma once
+
+namespace cltvt
+{
+    void test_multiplier_U_bounds();
+
+    void test_multiplier_V_bounds();
+
+    // Adaptive quadratures of known integrals against their error bounds, with the default and a too small budget.
+    void test_integrate_adaptive();
+
+    // Table of LimitMultipliers between its Chebyshev nodes and near lambda = 1 against multiplier_U and multiplier_V.
+    void test_limit_multipliers();
+
+    void test_vt_volatility(const size_t num_samples = 100000);
+
+    void test_vt_volatility_simultaneous_limit(const size_t num_samples = 100000);
+
+    void test_vt_volatility_limit_along_path_1(const size_t num_samples = 100000);
+
+    void test_vt_volatility_limit_along_path_2(const size_t num_samples = 100000);
+
+    void test_vt_pricing(const size_t num_samples = 100000);
+
+    void test_vt_vega(const size_t num_samples = 100000);
+
+    // Levels, statistics and stock levels of the parallel simulations with 1 to 16 threads, which must be the same bits.
+    void test_vt_parallel_reproducibility(const size_t num_samples = 20000);
+
+    // Control variate and plain Monte Carlo call prices on the same paths, with and without antithetic paths, and the
+    // control variate price run to a target standard error.
+    void test_vt_pricing_control_variate(const size_t num_samples = 50000);
+
+    // Randomised quasi-Monte Carlo against Monte Carlo on the same total number of paths, num_samples per replication.
+    void test_vt_pricing_sobol(const size_t num_samples = 4096, const size_t num_replications = 16);
+
+    // Multilevel Monte Carlo estimates of the price and the volatility on the finest grid, with their levels.
+    void test_vt_multilevel(const double target_standard_error = 5e-4);
+
+    // Estimates extrapolated to N -> infinity from a ladder ending at N = 5000, against the limits.
+    void test_vt_extrapolation(const size_t num_samples = 100000);
+
+    // Counts the heap allocations of a sweep run twice with the same SimulationWorkspace: the second run must make none.
+    void test_simulation_workspace(const size_t num_samples = 1000);
+
+    // Levels of ModelVolatilityTarget<BlackScholesStepper>, directly and through AnyVolatilityTarget, against VolatilityTarget.
+    void test_model_volatility_target(const size_t num_samples = 10000);
+
+    // Moments of the Heston QE paths with both signs of correlation, finite levels where the martingale correction
+    // does not exist, and VT volatilities on Heston and Black-Scholes against the Black-Scholes limit.
+    void test_vt_heston(const size_t num_samples = 100000);
+
+    // Batch VT levels of the scalar kernels (Vec1) and of the widest available ones, which must be the same bits.
+    void test_simd_lane_equivalence(const size_t num_samples = 10000);
+
+    // Outputs of every SIMD kernel with each available instruction set, forced with set_simd_isa, against the scalar
+    // kernels, which must be the same bits.
+    void test_simd_dispatch(const size_t num_samples = 2000);
+
+    // Adjoint call gradient against central finite differences of the call price on the same paths.
+    void test_vt_call_gradient(const size_t num_samples = 20000);
+
+    // Implied volatilities of Black-Scholes prices of calls and puts, in batches of odd sizes, against the volatilities,
+    // and 0 and INF at and beyond the bounds.
+    void test_implied_volatility();
+
+}
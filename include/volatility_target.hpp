@@ -1,48 +1,333 @@
-#pragma once
-#include <preliminaries.hpp>
-#include <black_scholes.hpp>
-
-namespace cltvt
-{
-    class VolatilityTarget
-    {
-    public:
-        VolatilityTarget(
-            const BlackScholesPtr& sde,
-            const double lamb,
-            const size_t num_time_steps,
-            const double target_volatility,
-            const double tenor,
-            const double init_var,
-            const double init_level
-        );
-
-        double lambda() const;
-
-        double target_volatility() const;
-
-        double tenor() const;
-
-        double init_var() const;
-
-        double init_level() const;
-
-        size_t num_time_steps() const;
-
-        double rebalance_time_step() const;
-
-        double compute_vt_level(const std::vector<double>& stock_path) const;
-
-        void simulate_vt_levels(std::vector<double>& vt_levels, const size_t num_samples, const size_t seed = DEFAULT_RNG_SEED) const;
-
-    private:
-        BlackScholesPtr m_sde;
-        double m_lamb;
-        double m_target_vol;
-        double m_tenor;
-        double m_init_var;
-        double m_init_level;
-        size_t m_num_time_steps;
-        double m_dt;
-    };
+#pragma once
+#include <preliminaries.hpp>
+#include <black_scholes.hpp>
+#include <random_number_generator.hpp>
+#include <quasi_random.hpp>
+#include <statistics.hpp>
+#include <workspace.hpp>
+
+namespace cltvt
+{
+    // VT level of a path and its pathwise derivatives with respect to the stock volatility, the discount rate and the
+    // initial VT level. The VT level only depends on the stock returns, so its derivative with respect to the initial
+    // stock level is zero.
+    struct PathwiseLevel
+    {
+        double level;
+        double d_volatility;
+        double d_discount_rate;
+        double d_init_level;
+    };
+
+    // Samples of the discounted call payoff and of its pathwise derivatives, the strike being held fixed.
+    struct CallSensitivities
+    {
+        RunningStatistics price;
+        RunningStatistics vega;
+        RunningStatistics rho;
+        RunningStatistics delta;
+    };
+
+    // Samples of the discounted call payoff and of its derivatives with respect to the model and strategy parameters,
+    // the strike being held fixed.
+    struct CallGradient
+    {
+        RunningStatistics price;
+        RunningStatistics discount_rate;
+        RunningStatistics repo_rate;
+        RunningStatistics volatility;
+        RunningStatistics lambda;
+        RunningStatistics target_volatility;
+        RunningStatistics init_var;
+        RunningStatistics init_level;
+
+        void merge(const CallGradient& other);
+    };
+
+    // Control variate estimate of a price, next to the plain Monte Carlo estimate on the same paths.
+    struct ControlVariatePrice
+    {
+        double price;
+        double standard_error;
+        double plain_price;
+        // Standard error of plain Monte Carlo with the same number of independent paths.
+        double plain_standard_error;
+        double beta;
+        double control_price;
+        size_t num_paths;
+
+        // Ratio of the plain to the control variate variance, i.e. how many times fewer paths the control variate
+        // estimator needs for the same standard error.
+        double variance_reduction() const;
+    };
+
+    class VolatilityTarget
+    {
+    public:
+        static const size_t BATCH_LANES = 16;
+
+        VolatilityTarget(
+            const BlackScholesPtr& sde,
+            const double lamb,
+            const size_t num_time_steps,
+            const double target_volatility,
+            const double tenor,
+            const double init_var,
+            const double init_level
+        );
+
+        const BlackScholesPtr& sde() const;
+
+        double lambda() const;
+
+        double target_volatility() const;
+
+        double tenor() const;
+
+        double init_var() const;
+
+        double init_level() const;
+
+        size_t num_time_steps() const;
+
+        double rebalance_time_step() const;
+
+        double compute_vt_level(const std::vector<double>& stock_path) const;
+
+        // Equivalent to BlackScholes::populate_path followed by compute_vt_level, but each normal is turned
+        // into a stock return and consumed on the fly, so no path is stored.
+        double simulate_vt_level(StandardNormalGenerator& rng) const;
+
+        // VT level of path number path of rng, e.g. to replay a single path of simulate_vt_levels_parallel.
+        double simulate_vt_level(const PathNormalGenerator& rng, const size_t path) const;
+
+        // VT level along the next path of rng, which must have num_time_steps steps of rebalance_time_step().
+        double simulate_vt_level(SobolPathGenerator& rng) const;
+
+        // Same level as simulate_vt_level, with derivatives from tangent recursions run in the same time loop.
+        PathwiseLevel simulate_vt_level_with_derivatives(StandardNormalGenerator& rng) const;
+
+        // Price, vega, rho (discount rate) and delta (initial VT level) of a call on the VT level, estimated pathwise
+        // on the samples of simulate_vt_levels.
+        CallSensitivities simulate_call_sensitivities(
+            const double strike,
+            const size_t num_samples,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Price and gradient of a call on the VT level on the samples of simulate_vt_levels. Each path is simulated
+        // forward, storing its normals, returns, variances and levels in a tape taken from workspace, and then swept
+        // backward once through the adjoint of the recursion, so the full gradient costs a small multiple of the price
+        // alone.
+        CallGradient simulate_call_gradient(
+            const double strike,
+            const size_t num_samples,
+            const size_t seed = DEFAULT_RNG_SEED,
+            SimulationWorkspace& workspace = thread_workspace()
+        ) const;
+
+        // Same on the samples of simulate_vt_levels_parallel, reduced with simulate_partials.
+        CallGradient simulate_call_gradient_parallel(
+            const double strike,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Price of a call on the VT level with a control variate: the call on the level
+        // init_level * exp((r - w q - w^2 sigma^2 / 2) T + w sigma W_T) of a portfolio holding the constant fraction
+        // w = target_volatility / volatility of stock, which the strategy tracks once its variance estimate has settled,
+        // along the same path. Its exact price is the Black-Scholes price with volatility w sigma and repo rate w q.
+        // Sample i is path i of PathNormalGenerator(seed), averaged with its mirror path (opposite normals) if antithetic,
+        // and the samples are reduced with simulate_partials.
+        ControlVariatePrice simulate_call_price_cv(
+            const double strike,
+            const size_t num_samples,
+            const bool antithetic = true,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Same estimator run in rounds, each round adding the number of samples that the previous ones predict to be
+        // missing, until the standard error is at most target_standard_error or max_samples samples have been used.
+        ControlVariatePrice simulate_call_price_cv_to_tolerance(
+            const double strike,
+            const double target_standard_error,
+            const size_t max_samples,
+            const bool antithetic = true,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Advances BATCH_LANES independent paths in lockstep. levels and vars hold one value per lane and normals
+        // holds num_steps rows of BATCH_LANES normals. Uses the SIMD kernels selected at runtime.
+        void advance_vt_batch(double* levels, double* vars, const double* normals, const size_t num_steps) const;
+
+        void simulate_vt_levels(std::vector<double>& vt_levels, const size_t num_samples, const size_t seed = DEFAULT_RNG_SEED) const;
+
+        // Same samples as the overload above, added to acc one by one instead of being stored.
+        void simulate_vt_levels(Accumulator& acc, const size_t num_samples, const size_t seed = DEFAULT_RNG_SEED) const;
+
+        // Sample i is path i of PathNormalGenerator(seed), so the result only depends on the seed and not on
+        // num_threads (0 means all hardware threads). Samples are scheduled in blocks of SIMULATION_BLOCK_SIZE paths.
+        void simulate_vt_levels_parallel(
+            std::vector<double>& vt_levels,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Same samples as the overload above, reduced with accumulate_parallel, so acc gets the same result for any
+        // num_threads.
+        void simulate_vt_levels_parallel(
+            Accumulator& acc,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Same paths as simulate_vt_levels_parallel (equal up to rounding), but simulated BATCH_LANES paths at a time
+        // with advance_vt_batch.
+        void simulate_vt_levels_batch(
+            std::vector<double>& vt_levels,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        void simulate_vt_levels_batch(
+            Accumulator& acc,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Randomised quasi-Monte Carlo: replications[r] receives the levels of num_samples paths of
+        // SobolPathGenerator(seed, r), which are independent across replications, so the spread of the replication
+        // estimates gives the error of their mean. Replications run in parallel on num_threads (0 means all hardware
+        // threads). Powers of two are the best values of num_samples for the Sobol sequence.
+        void simulate_vt_levels_sobol(
+            const std::vector<AccumulatorPtr>& replications,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+    private:
+        void advance_vt_path(double& level, double& var, const double* normals, const size_t num_steps) const;
+
+        // state holds level, var, d level / d volatility, d var / d volatility, d level / d discount rate and
+        // d var / d discount rate.
+        void advance_vt_path_derivatives(double* state, const double* normals, const size_t num_steps) const;
+
+        void simulate_vt_batch(const PathNormalGenerator& rng, const size_t first_path, double* levels) const;
+
+        // Adds the (control, payoff) samples of paths [begin, end) of rng to samples and the payoffs of every simulated
+        // path to paths.
+        void add_call_cv_samples(
+            RunningCovariance& samples,
+            RunningStatistics& paths,
+            const double strike,
+            const PathNormalGenerator& rng,
+            const size_t begin,
+            const size_t end,
+            const bool antithetic
+        ) const;
+
+        ControlVariatePrice simulate_call_price_cv(
+            RunningCovariance& samples,
+            RunningStatistics& paths,
+            const double strike,
+            const size_t first_sample,
+            const size_t num_samples,
+            const bool antithetic,
+            const size_t num_threads,
+            const size_t seed
+        ) const;
+
+        // tape holds 4 * num_time_steps values, the first num_time_steps being the normals of the path.
+        void add_call_gradient(CallGradient& gradient, const double strike, double* tape) const;
+
+        BlackScholesPtr m_sde;
+        double m_lamb;
+        double m_target_vol;
+        double m_tenor;
+        double m_init_var;
+        double m_init_level;
+        size_t m_num_time_steps;
+        double m_dt;
+    };
+
+    // Volatility target strategies on the same underlying (same sde, tenor and num_time_steps) that differ in lambda,
+    // target volatility, init_var or init_level. Every simulated stock path drives all of them, so the stock returns
+    // are computed once per path and the strategies are compared with common random numbers.
+    class VolatilityTargetSweep
+    {
+    public:
+        VolatilityTargetSweep(const std::vector<VolatilityTarget>& targets);
+
+        size_t size() const;
+
+        const VolatilityTarget& target(const size_t i) const;
+
+        // Writes the level of every target along the next path of rng to vt_levels, which holds size() values.
+        // The levels are the same as VolatilityTarget::simulate_vt_level(rng) would give for that path. The state of
+        // the lanes is taken from workspace.
+        void simulate_vt_levels(
+            double* vt_levels,
+            StandardNormalGenerator& rng,
+            SimulationWorkspace& workspace = thread_workspace()
+        ) const;
+
+        void simulate_vt_levels(
+            double* vt_levels,
+            const PathNormalGenerator& rng,
+            const size_t path,
+            SimulationWorkspace& workspace = thread_workspace()
+        ) const;
+
+        // accs[i] receives the samples of target(i), which are those of target(i).simulate_vt_levels(acc, num_samples, seed).
+        void simulate_vt_levels(
+            const std::vector<AccumulatorPtr>& accs,
+            const size_t num_samples,
+            const size_t seed = DEFAULT_RNG_SEED,
+            SimulationWorkspace& workspace = thread_workspace()
+        ) const;
+
+        // accs[i] receives the samples of target(i).simulate_vt_levels_parallel(acc, num_samples, num_threads, seed).
+        void simulate_vt_levels_parallel(
+            const std::vector<AccumulatorPtr>& accs,
+            const size_t num_samples,
+            const size_t num_threads = 0,
+            const size_t seed = DEFAULT_RNG_SEED
+        ) const;
+
+        // Element i is target(i).simulate_call_sensitivities(strike, num_samples, seed), computed with shared stock returns.
+        std::vector<CallSensitivities> simulate_call_sensitivities(
+            const double strike,
+            const size_t num_samples,
+            const size_t seed = DEFAULT_RNG_SEED,
+            SimulationWorkspace& workspace = thread_workspace()
+        ) const;
+
+    private:
+        // levels and vars hold one value per lane, the lanes being the targets padded to a multiple of MAX_SIMD_WIDTH.
+        void advance_vt_paths(double* levels, double* vars, const double* normals, const size_t num_steps) const;
+
+        void simulate_path(double* levels, double* vars, StandardNormalGenerator& rng) const;
+
+        void simulate_path(double* levels, double* vars, const PathNormalGenerator& rng, const size_t path) const;
+
+        // state holds the levels, vars, d levels / d volatility, d vars / d volatility, d levels / d discount rate and
+        // d vars / d discount rate, one row of lanes each.
+        void advance_vt_path_derivatives(double* state, const double* normals, const size_t num_steps) const;
+
+        std::vector<VolatilityTarget> m_targets;
+        size_t m_num_lanes;
+        std::vector<double> m_target_vols;
+        std::vector<double> m_lambs;
+        std::vector<double> m_var_weights;
+        std::vector<double> m_init_levels;
+        std::vector<double> m_init_vars;
+    };
 }
\ No newline at end of file
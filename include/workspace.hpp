@@ -0,0 +1,86 @@
+#pragma once
+#include <preliminaries.hpp>
+#include <memory>
+#include <vector>
+
+namespace cltvt
+{
+    class SimulationWorkspace;
+
+    typedef std::shared_ptr<SimulationWorkspace> SimulationWorkspacePtr;
+
+    // Arena of scratch arrays for the simulations, for one thread. Arrays are carved out of chunks aligned to cache
+    // lines and are released together when the Frame they were allocated in ends. When the outermost frame ends, the
+    // chunks are merged into one that holds them all, so once a workspace has served the largest frame of a sweep,
+    // later frames take no memory from the heap. This makes the serial simulations taking a workspace allocation-free
+    // when warm; the parallel ones still allocate their partial results on every call (see accumulate_parallel).
+    class SimulationWorkspace
+    {
+    public:
+        static const size_t ALIGNMENT = 64;
+
+        // Allocations from workspace made during the lifetime of a frame are released when it is destroyed. Frames
+        // nest and must be destroyed in reverse order of construction.
+        class Frame
+        {
+        public:
+            Frame(SimulationWorkspace& workspace);
+
+            ~Frame();
+
+        private:
+            Frame(const Frame&) = delete;
+
+            Frame& operator=(const Frame&) = delete;
+
+            SimulationWorkspace& m_workspace;
+            size_t m_chunk;
+            size_t m_offset;
+        };
+
+        SimulationWorkspace(const size_t initial_bytes = 0);
+
+        static SimulationWorkspacePtr create(const size_t initial_bytes = 0);
+
+        // Uninitialised array of size values, aligned to ALIGNMENT bytes and valid until the current frame ends.
+        template <class T>
+        T* allocate(const size_t size)
+        {
+            return static_cast<T*>(allocate_bytes(size * sizeof(T)));
+        }
+
+        // Bytes held in chunks.
+        size_t capacity() const;
+
+        // Number of chunks taken from the heap since construction.
+        size_t num_heap_allocations() const;
+
+    private:
+        struct Chunk
+        {
+            std::unique_ptr<char[]> storage;
+            char* data;
+            size_t size;
+        };
+
+        SimulationWorkspace(const SimulationWorkspace&) = delete;
+
+        SimulationWorkspace& operator=(const SimulationWorkspace&) = delete;
+
+        void* allocate_bytes(const size_t bytes);
+
+        void add_chunk(const size_t bytes);
+
+        void release(const size_t chunk, const size_t offset);
+
+        std::vector<Chunk> m_chunks;
+        size_t m_chunk;
+        size_t m_offset;
+        size_t m_num_frames;
+        size_t m_num_heap_allocations;
+    };
+
+    // Workspace of the calling thread, the default of the simulation functions that take one. The parallel simulations
+    // use the workspace of each thread of the pool.
+    SimulationWorkspace& thread_workspace();
+}
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include <benchmarks.hpp>
+#include <black_scholes.hpp>
+#include <volatility_target.hpp>
+#include <model_volatility_target.hpp>
+#include <heston.hpp>
+#include <random_number_generator.hpp>
+#include <integration.hpp>
+#include <special_functions.hpp>
+#include <limit_multipliers.hpp>
+#include <parallel.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+namespace cltvt
+{
+    namespace
+    {
+        // Results are accumulated here so that the timed work cannot be optimised away.
+        volatile double g_sink = 0.0;
+
+        const double DISCOUNT_RATE = 0.05;
+        const double REPO_RATE = 0.02;
+        const double VOLATILITY = 0.5;
+        const double TARGET_VOLATILITY = 0.2;
+        const double TENOR = 1.0;
+        const double INIT_VAR = 0.02;
+        const double LAMBDA = 0.9;
+        const double KAPPA = 2.0;
+        const double VOL_OF_VOL = 0.5;
+        const double CORRELATION = -0.7;
+
+        template <class F>
+        double best_time(const size_t repetitions, F f)
+        {
+            double best = INF;
+            for (size_t r = 0; r < std::max(repetitions, size_t(1)); ++r)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                f();
+                const auto stop = std::chrono::steady_clock::now();
+                best = std::min(best, std::chrono::duration<double>(stop - start).count());
+            }
+            return best;
+        }
+
+        BenchmarkResult make_result(
+            const std::string& name,
+            const std::string& variant,
+            const size_t num_steps,
+            const size_t num_threads,
+            const size_t num_paths,
+            const size_t num_items,
+            const std::string& unit,
+            const double seconds
+        )
+        {
+            BenchmarkResult result;
+            result.name = name;
+            result.variant = variant;
+            result.num_steps = num_steps;
+            result.num_threads = num_threads;
+            result.num_paths = num_paths;
+            result.num_items = num_items;
+            result.unit = unit;
+            result.seconds = seconds;
+            return result;
+        }
+
+        std::vector<size_t> thread_counts(const BenchmarkSettings& settings)
+        {
+            if (!settings.num_threads.empty())
+                return settings.num_threads;
+            std::vector<size_t> counts;
+            const size_t hardware_threads = resolve_num_threads(0);
+            for (size_t n = 1; n < hardware_threads; n *= 2)
+                counts.push_back(n);
+            counts.push_back(hardware_threads);
+            return counts;
+        }
+
+        size_t num_paths(const BenchmarkSettings& settings, const size_t num_steps)
+        {
+            return std::max(settings.step_budget / num_steps, size_t(1));
+        }
+
+        double sum(const std::vector<double>& values)
+        {
+            double s = 0.0;
+            for (const double value : values)
+                s += value;
+            return s;
+        }
+    }
+
+    double BenchmarkResult::ns_per_item() const
+    {
+        return 1e9 * seconds / double(num_items);
+    }
+
+    double BenchmarkResult::items_per_second() const
+    {
+        return double(num_items) / seconds;
+    }
+
+    double BenchmarkResult::paths_per_second() const
+    {
+        return double(num_paths) / seconds;
+    }
+
+    BenchmarkSettings::BenchmarkSettings()
+        :
+        num_time_steps{ 1000, 2000, 5000, 10000, 50000 },
+        num_threads(),
+        step_budget(20000000),
+        repetitions(3)
+    {
+    }
+
+    std::vector<BenchmarkResult> benchmark_normals(const BenchmarkSettings& settings)
+    {
+        const size_t size = std::max(settings.step_budget / 4, size_t(1));
+        std::vector<double> normals;
+        std::vector<BenchmarkResult> results;
+
+        const std::vector<NormalMethod> methods{ NormalMethod::REFERENCE, NormalMethod::INVERSE_CDF };
+        const std::vector<std::string> names{ "reference", "inverse_cdf" };
+        for (size_t i = 0; i < methods.size(); ++i)
+        {
+            StandardNormalGenerator rng(DEFAULT_RNG_SEED, 0, methods[i]);
+            const double seconds = best_time(settings.repetitions, [&]() {
+                rng.populate_standard_normals(normals, size);
+                g_sink = g_sink + normals.back();
+            });
+            results.push_back(make_result("populate_standard_normals", names[i], 0, 1, 0, size, "normal", seconds));
+        }
+
+        const PathNormalGenerator path_rng;
+        const double seconds = best_time(settings.repetitions, [&]() {
+            path_rng.populate_standard_normals(normals, 0, size);
+            g_sink = g_sink + normals.back();
+        });
+        results.push_back(make_result("populate_standard_normals", "philox", 0, 1, 0, size, "normal", seconds));
+        return results;
+    }
+
+    std::vector<BenchmarkResult> benchmark_paths(const BenchmarkSettings& settings)
+    {
+        const BlackScholesPtr sde = BlackScholes::create(DISCOUNT_RATE, REPO_RATE, VOLATILITY);
+        std::vector<BenchmarkResult> results;
+        for (const size_t num_steps : settings.num_time_steps)
+        {
+            const size_t paths = num_paths(settings, num_steps);
+            const VolatilityTarget vt(sde, LAMBDA, num_steps, TARGET_VOLATILITY, TENOR, INIT_VAR, 1.0);
+            const std::vector<double> dtimes(num_steps, vt.rebalance_time_step());
+            std::vector<double> normals;
+            PathNormalGenerator(DEFAULT_RNG_SEED).populate_standard_normals(normals, 0, num_steps);
+            std::vector<double> stock_path;
+
+            // The same normals drive every path, so only the path construction is timed.
+            double seconds = best_time(settings.repetitions, [&]() {
+                for (size_t i = 0; i < paths; ++i)
+                {
+                    sde->populate_path(stock_path, dtimes, normals);
+                    g_sink = g_sink + stock_path.back();
+                }
+            });
+            results.push_back(make_result("populate_path", "", num_steps, 1, paths, paths * num_steps, "step", seconds));
+
+            seconds = best_time(settings.repetitions, [&]() {
+                for (size_t i = 0; i < paths; ++i)
+                    g_sink = g_sink + vt.compute_vt_level(stock_path);
+            });
+            results.push_back(make_result("compute_vt_level", "", num_steps, 1, paths, paths * num_steps, "step", seconds));
+        }
+        return results;
+    }
+
+    std::vector<BenchmarkResult> benchmark_vt_simulation(const BenchmarkSettings& settings)
+    {
+        const BlackScholesPtr sde = BlackScholes::create(DISCOUNT_RATE, REPO_RATE, VOLATILITY);
+        const double theta = VOLATILITY * VOLATILITY;
+        const Heston heston(DISCOUNT_RATE, REPO_RATE, KAPPA, theta, VOL_OF_VOL, CORRELATION, theta);
+        const std::vector<size_t> threads = thread_counts(settings);
+        std::vector<BenchmarkResult> results;
+        std::vector<double> vt_levels;
+        for (const size_t num_steps : settings.num_time_steps)
+        {
+            const size_t paths = num_paths(settings, num_steps);
+            const size_t steps = paths * num_steps;
+            const VolatilityTarget vt(sde, LAMBDA, num_steps, TARGET_VOLATILITY, TENOR, INIT_VAR, 1.0);
+            const BlackScholesVolatilityTarget model_vt(*sde, LAMBDA, num_steps, TARGET_VOLATILITY, TENOR, INIT_VAR, 1.0);
+            const AnyVolatilityTargetPtr any_vt = create_any_volatility_target(vt);
+            const HestonVolatilityTarget heston_vt(heston, LAMBDA, num_steps, TARGET_VOLATILITY, TENOR, INIT_VAR, 1.0);
+
+            double seconds = best_time(settings.repetitions, [&]() {
+                vt.simulate_vt_levels(vt_levels, paths);
+                g_sink = g_sink + sum(vt_levels);
+            });
+            results.push_back(make_result("simulate_vt_levels", "sequential", num_steps, 1, paths, steps, "step", seconds));
+
+            for (const size_t num_threads : threads)
+            {
+                seconds = best_time(settings.repetitions, [&]() {
+                    vt.simulate_vt_levels_parallel(vt_levels, paths, num_threads);
+                    g_sink = g_sink + sum(vt_levels);
+                });
+                results.push_back(make_result("simulate_vt_levels", "parallel", num_steps, num_threads, paths, steps, "step", seconds));
+
+                seconds = best_time(settings.repetitions, [&]() {
+                    vt.simulate_vt_levels_batch(vt_levels, paths, num_threads);
+                    g_sink = g_sink + sum(vt_levels);
+                });
+                results.push_back(make_result("simulate_vt_levels", "batch", num_steps, num_threads, paths, steps, "step", seconds));
+
+                seconds = best_time(settings.repetitions, [&]() {
+                    model_vt.simulate_vt_levels_parallel(vt_levels, paths, num_threads);
+                    g_sink = g_sink + sum(vt_levels);
+                });
+                results.push_back(make_result("simulate_vt_levels", "model", num_steps, num_threads, paths, steps, "step", seconds));
+
+                seconds = best_time(settings.repetitions, [&]() {
+                    any_vt->simulate_vt_levels_parallel(vt_levels, paths, num_threads);
+                    g_sink = g_sink + sum(vt_levels);
+                });
+                results.push_back(make_result("simulate_vt_levels", "any_model", num_steps, num_threads, paths, steps, "step", seconds));
+
+                seconds = best_time(settings.repetitions, [&]() {
+                    model_vt.simulate_vt_levels_batch(vt_levels, paths, num_threads);
+                    g_sink = g_sink + sum(vt_levels);
+                });
+                results.push_back(make_result("simulate_vt_levels", "model_batch", num_steps, num_threads, paths, steps, "step", seconds));
+
+                seconds = best_time(settings.repetitions, [&]() {
+                    heston_vt.simulate_vt_levels_parallel(vt_levels, paths, num_threads);
+                    g_sink = g_sink + sum(vt_levels);
+                });
+                results.push_back(make_result("simulate_vt_levels", "heston", num_steps, num_threads, paths, steps, "step", seconds));
+
+                seconds = best_time(settings.repetitions, [&]() {
+                    heston_vt.simulate_vt_levels_batch(vt_levels, paths, num_threads);
+                    g_sink = g_sink + sum(vt_levels);
+                });
+                results.push_back(make_result("simulate_vt_levels", "heston_batch", num_steps, num_threads, paths, steps, "step", seconds));
+            }
+        }
+        return results;
+    }
+
+    std::vector<BenchmarkResult> benchmark_special_functions(const BenchmarkSettings& settings)
+    {
+        std::vector<BenchmarkResult> results;
+
+        const size_t num_integrals = 200;
+        const size_t num_points = 5000;
+        const Function f = [](const double x) { return std::exp(-x * x) * std::cos(x); };
+        double seconds = best_time(settings.repetitions, [&]() {
+            for (size_t i = 0; i < num_integrals; ++i)
+                g_sink = g_sink + integrate(f, 0.0, 1.0 + 1e-3 * double(i), num_points);
+        });
+        results.push_back(make_result("integrate", "midpoint", 0, 1, 0, num_integrals, "integral", seconds));
+
+        seconds = best_time(settings.repetitions, [&]() {
+            for (size_t i = 0; i < num_integrals; ++i)
+                g_sink = g_sink + integrate_adaptive(f, 0.0, 1.0 + 1e-3 * double(i)).value;
+        });
+        results.push_back(make_result("integrate", "adaptive", 0, 1, 0, num_integrals, "integral", seconds));
+
+        const size_t num_values = 10000;
+        for (const double q : { 0.97, 0.999 })
+        {
+            const std::string variant = "q=" + std::to_string(q).substr(0, 5);
+            seconds = best_time(settings.repetitions, [&]() {
+                for (size_t i = 0; i < num_values; ++i)
+                    g_sink = g_sink + q_pochhammer(-1.0 + 1.9 * double(i) / double(num_values), q);
+            });
+            results.push_back(make_result("q_pochhammer", variant, 0, 1, 0, num_values, "value", seconds));
+
+            const QPochhammer pochhammer(q);
+            seconds = best_time(settings.repetitions, [&]() {
+                for (size_t i = 0; i < num_values; ++i)
+                    g_sink = g_sink + pochhammer(-1.0 + 1.9 * double(i) / double(num_values));
+            });
+            results.push_back(make_result("QPochhammer", variant, 0, 1, 0, num_values, "value", seconds));
+        }
+
+        const size_t num_lambdas = 100;
+        seconds = best_time(settings.repetitions, [&]() {
+            for (size_t i = 0; i < num_lambdas; ++i)
+                g_sink = g_sink + multiplier_V(0.5 + 0.49 * double(i) / double(num_lambdas));
+        });
+        results.push_back(make_result("multiplier_V", "quadrature", 0, 1, 0, num_lambdas, "value", seconds));
+
+        const LimitMultipliers multipliers;
+        seconds = best_time(settings.repetitions, [&]() {
+            for (size_t i = 0; i < num_lambdas; ++i)
+                g_sink = g_sink + multipliers.V(0.5 + 0.49 * double(i) / double(num_lambdas));
+        });
+        results.push_back(make_result("multiplier_V", "chebyshev", 0, 1, 0, num_lambdas, "value", seconds));
+        return results;
+    }
+
+    std::vector<BenchmarkResult> benchmark_black_scholes(const BenchmarkSettings& settings)
+    {
+        const BlackScholes bs(DISCOUNT_RATE, REPO_RATE, 0.3);
+        std::vector<double> strikes;
+        std::vector<double> tenors;
+        for (size_t i = 0; i < 200; ++i)
+            strikes.push_back(0.5 + 0.01 * double(i));
+        for (size_t i = 1; i <= 50; ++i)
+            tenors.push_back(0.04 * double(i));
+        const size_t size = strikes.size() * tenors.size();
+        std::vector<double> grid_strikes;
+        std::vector<double> grid_tenors;
+        for (const double tenor : tenors)
+        {
+            for (const double strike : strikes)
+            {
+                grid_strikes.push_back(strike);
+                grid_tenors.push_back(tenor);
+            }
+        }
+        std::vector<BenchmarkResult> results;
+
+        std::vector<double> prices(size);
+        double seconds = best_time(settings.repetitions, [&]() {
+            for (size_t i = 0; i < size; ++i)
+                prices[i] = bs.get_call_price(grid_strikes[i], grid_tenors[i]);
+            g_sink = g_sink + sum(prices);
+        });
+        results.push_back(make_result("get_call_price", "scalar", 0, 1, 0, size, "price", seconds));
+
+        seconds = best_time(settings.repetitions, [&]() {
+            bs.get_call_price_surface(strikes, tenors, prices);
+            g_sink = g_sink + sum(prices);
+        });
+        results.push_back(make_result("get_call_price", "surface", 0, 1, 0, size, "price", seconds));
+
+        std::vector<BlackScholesGreeks> greeks(size);
+        seconds = best_time(settings.repetitions, [&]() {
+            bs.get_call_greeks(grid_strikes.data(), grid_tenors.data(), greeks.data(), size);
+            g_sink = g_sink + greeks.back().vega;
+        });
+        results.push_back(make_result("get_call_greeks", "batch", 0, 1, 0, size, "option", seconds));
+
+        std::vector<double> volatilities(size);
+        seconds = best_time(settings.repetitions, [&]() {
+            bs.get_call_implied_volatilities(prices.data(), grid_strikes.data(), grid_tenors.data(), volatilities.data(), size);
+            g_sink = g_sink + sum(volatilities);
+        });
+        results.push_back(make_result("get_call_implied_volatility", "batch", 0, 1, 0, size, "price", seconds));
+
+        const LimitMultipliers multipliers;
+        std::vector<double> lambdas(size);
+        for (size_t i = 0; i < size; ++i)
+            lambdas[i] = 0.5 + 0.49 * double(i) / double(size);
+        seconds = best_time(settings.repetitions, [&]() {
+            multipliers.limit_call_prices(bs, TARGET_VOLATILITY, 1.0, 1.0, TENOR, lambdas.data(), prices.data(), size);
+            g_sink = g_sink + sum(prices);
+        });
+        results.push_back(make_result("limit_call_prices", "batch", 0, 1, 0, size, "price", seconds));
+        return results;
+    }
+
+    void write_benchmark_results(const std::vector<BenchmarkResult>& results, const std::string& label, const std::string& path)
+    {
+        for (const BenchmarkResult& result : results)
+        {
+            std::cout << std::left << std::setw(28) << result.name << std::setw(12) << result.variant
+                << " N=" << std::setw(6) << result.num_steps << " threads=" << std::setw(3) << result.num_threads
+                << std::right << std::setw(12) << std::setprecision(4) << result.ns_per_item() << " ns/" << result.unit;
+            if (result.num_paths > 0)
+                std::cout << std::setw(12) << std::setprecision(4) << result.paths_per_second() << " paths/s";
+            std::cout << std::endl;
+        }
+
+        std::ofstream outfile;
+        outfile.open(path);
+        ASSERT(outfile.is_open(), "cannot open " + path);
+        outfile << "label,name,variant,num_steps,num_threads,num_paths,num_items,unit,seconds,ns_per_item,items_per_second,"
+            << "paths_per_second\n";
+        outfile << std::setprecision(10);
+        for (const BenchmarkResult& result : results)
+        {
+            outfile << label << "," << result.name << "," << result.variant << "," << result.num_steps << ","
+                << result.num_threads << "," << result.num_paths << "," << result.num_items << "," << result.unit << ","
+                << result.seconds << "," << result.ns_per_item() << "," << result.items_per_second() << ","
+                << result.paths_per_second() << "\n";
+        }
+        outfile.close();
+    }
+}
\ No newline at end of file
@@ -1,143 +1,392 @@
-#include <black_scholes.hpp>
-#include <random_number_generator.hpp>
-#include <special_functions.hpp>
-#include <iterator>
-
-namespace cltvt
-{
-    BlackScholes::BlackScholes(
-        const double discount_rate,
-        const double repo_rate,
-        const double volatility,
-        const double init_level
-    )
-        :
-        m_discount_rate(discount_rate),
-        m_repo_rate(repo_rate),
-        m_volatility(volatility),
-        m_init_level(init_level)
-    {
-        ASSERT(m_volatility > 1e-12, "volatility must be positive");
-        ASSERT(m_init_level > 1e-12, "init_level must be positive");
-    }
-
-    BlackScholesPtr BlackScholes::create(
-        const double discount_rate,
-        const double repo_rate,
-        const double volatility,
-        const double init_level
-    )
-    {
-        return BlackScholesPtr(new BlackScholes(discount_rate, repo_rate, volatility, init_level));
-    }
-
-    double BlackScholes::discount_rate() const
-    {
-        return m_discount_rate;
-    }
-
-    double BlackScholes::repo_rate() const
-    {
-        return m_repo_rate;
-    }
-
-    double BlackScholes::volatility() const
-    {
-        return m_volatility;
-    }
-
-    double BlackScholes::init_level() const
-    {
-        return m_init_level;
-    }
-
-    double BlackScholes::get_call_price(const double strike, const double tenor) const
-    {
-        const double forward = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenor);
-        const double discount_factor = std::exp(-m_discount_rate * tenor);
-        const double total_vol = m_volatility * std::sqrt(tenor);
-        const double d1 = std::log(forward / strike) / total_vol + 0.5 * total_vol;
-        const double d2 = d1 - total_vol;
-        return discount_factor * (forward * normal_cdf(d1) - strike * normal_cdf(d2));
-    }
-
-    double BlackScholes::get_put_price(const double strike, const double tenor) const
-    {
-        const double forward = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenor);
-        const double discount_factor = std::exp(-m_discount_rate * tenor);
-        const double total_vol = m_volatility * std::sqrt(tenor);
-        const double d1 = std::log(strike / forward) / total_vol + 0.5 * total_vol;
-        const double d2 = d1 - total_vol;
-        return discount_factor * (strike * normal_cdf(-d2) - forward * normal_cdf(-d1));
-    }
-
-    double BlackScholes::get_vega(const double strike, const double tenor) const
-    {
-        const double vol_bump = 0.001;
-        const BlackScholes bs_up(m_discount_rate, m_repo_rate, m_volatility + vol_bump, m_init_level);
-        const double price = get_call_price(strike, tenor);
-        const double price_up = bs_up.get_call_price(strike, tenor);
-        return (price_up - price) / vol_bump;
-    }
-
-    double BlackScholes::get_call_rho(const double strike, const double tenor) const
-    {
-        const double repo_bump = 0.01 * m_repo_rate;
-        const BlackScholes bs_bumped(m_discount_rate, m_repo_rate + repo_bump, m_volatility, m_init_level);
-        const double price = get_call_price(strike, tenor);
-        const double price_bumped = bs_bumped.get_call_price(strike, tenor);
-        return (price - price_bumped) / repo_bump;
-    }
-
-    double BlackScholes::get_put_rho(const double strike, const double tenor) const
-    {
-        const double repo_bump = 0.01 * m_repo_rate;
-        const BlackScholes bs_bumped(m_discount_rate, m_repo_rate + repo_bump, m_volatility, m_init_level);
-        const double price = get_put_price(strike, tenor);
-        const double price_bumped = bs_bumped.get_call_price(strike, tenor);
-        return (price - price_bumped) / repo_bump;
-    }
-
-    void BlackScholes::populate_path(
-        std::vector<double>& stock_path, 
-        const std::vector<double>& dtimes,
-        const std::vector<double>& random_normals
-    ) const
-    {
-        ASSERT(dtimes.size() == random_normals.size(), "dtimes and  random_normals must have same size");
-        stock_path.resize(0);
-        stock_path.reserve(random_normals.size() + 1);
-        std::vector<double>::const_iterator it_dt = dtimes.cbegin();
-        std::vector<double>::const_iterator it_rn = random_normals.cbegin();
-        const double rho = m_discount_rate - m_repo_rate;
-        double lev = m_init_level;
-        stock_path.push_back(lev);
-        for (; it_rn != random_normals.cend(); ++it_dt, ++it_rn)
-        {
-            const double dt = *it_dt;
-            const double z = *it_rn;
-            lev *= std::exp((rho - 0.5 * m_volatility * m_volatility) * dt + m_volatility * std::sqrt(dt) * z);
-            stock_path.push_back(lev);
-        }
-    }
-
-    void BlackScholes::simulate_stock_levels(
-        std::vector<double>& stock_levels,
-        const std::vector<double>& dtimes,
-        const size_t num_samples,
-        const size_t seed
-    ) const
-    {
-        stock_levels.resize(0);
-        stock_levels.reserve(num_samples);
-        StandardNormalGenerator rng(seed);
-        std::vector<double> random_normals;
-        std::vector<double> stock_path;
-        for (size_t i = 0; i < num_samples; ++i)
-        {
-            rng.populate_standard_normals(random_normals, dtimes.size());
-            populate_path(stock_path, dtimes, random_normals);
-            stock_levels.push_back(stock_path.back());
-        }
-    }
+#include <black_scholes.hpp>
+#include <random_number_generator.hpp>
+#include <special_functions.hpp>
+#include <instrumentation.hpp>
+#include <parallel.hpp>
+#include <dispatch.hpp>
+#include <iterator>
+#include <algorithm>
+
+namespace cltvt
+{
+    void black_call_prices(
+        const double* forwards,
+        const double* strikes,
+        const double* total_vols,
+        const double* discount_factors,
+        double* prices,
+        const size_t size
+    )
+    {
+        simd_kernels().black_prices(true, forwards, strikes, total_vols, discount_factors, prices, size);
+    }
+
+    void black_put_prices(
+        const double* forwards,
+        const double* strikes,
+        const double* total_vols,
+        const double* discount_factors,
+        double* prices,
+        const size_t size
+    )
+    {
+        simd_kernels().black_prices(false, forwards, strikes, total_vols, discount_factors, prices, size);
+    }
+
+    BlackScholes::BlackScholes(
+        const double discount_rate,
+        const double repo_rate,
+        const double volatility,
+        const double init_level
+    )
+        :
+        m_discount_rate(discount_rate),
+        m_repo_rate(repo_rate),
+        m_volatility(volatility),
+        m_init_level(init_level)
+    {
+        ASSERT(m_volatility > 1e-12, "volatility must be positive");
+        ASSERT(m_init_level > 1e-12, "init_level must be positive");
+    }
+
+    BlackScholesPtr BlackScholes::create(
+        const double discount_rate,
+        const double repo_rate,
+        const double volatility,
+        const double init_level
+    )
+    {
+        return BlackScholesPtr(new BlackScholes(discount_rate, repo_rate, volatility, init_level));
+    }
+
+    double BlackScholes::discount_rate() const
+    {
+        return m_discount_rate;
+    }
+
+    double BlackScholes::repo_rate() const
+    {
+        return m_repo_rate;
+    }
+
+    double BlackScholes::volatility() const
+    {
+        return m_volatility;
+    }
+
+    double BlackScholes::init_level() const
+    {
+        return m_init_level;
+    }
+
+    double BlackScholes::get_call_price(const double strike, const double tenor) const
+    {
+        const double forward = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenor);
+        const double discount_factor = std::exp(-m_discount_rate * tenor);
+        const double total_vol = m_volatility * std::sqrt(tenor);
+        const double d1 = std::log(forward / strike) / total_vol + 0.5 * total_vol;
+        const double d2 = d1 - total_vol;
+        return discount_factor * (forward * normal_cdf(d1) - strike * normal_cdf(d2));
+    }
+
+    double BlackScholes::get_put_price(const double strike, const double tenor) const
+    {
+        const double forward = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenor);
+        const double discount_factor = std::exp(-m_discount_rate * tenor);
+        const double total_vol = m_volatility * std::sqrt(tenor);
+        const double d1 = std::log(forward / strike) / total_vol + 0.5 * total_vol;
+        const double d2 = d1 - total_vol;
+        return discount_factor * (strike * normal_cdf(-d2) - forward * normal_cdf(-d1));
+    }
+
+    void BlackScholes::get_call_prices(const double* strikes, const double* tenors, double* prices, const size_t size) const
+    {
+        std::vector<double> forwards(size);
+        std::vector<double> total_vols(size);
+        std::vector<double> discount_factors(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            forwards[i] = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenors[i]);
+            total_vols[i] = m_volatility * std::sqrt(tenors[i]);
+            discount_factors[i] = std::exp(-m_discount_rate * tenors[i]);
+        }
+        black_call_prices(forwards.data(), strikes, total_vols.data(), discount_factors.data(), prices, size);
+    }
+
+    void BlackScholes::get_put_prices(const double* strikes, const double* tenors, double* prices, const size_t size) const
+    {
+        std::vector<double> forwards(size);
+        std::vector<double> total_vols(size);
+        std::vector<double> discount_factors(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            forwards[i] = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenors[i]);
+            total_vols[i] = m_volatility * std::sqrt(tenors[i]);
+            discount_factors[i] = std::exp(-m_discount_rate * tenors[i]);
+        }
+        black_put_prices(forwards.data(), strikes, total_vols.data(), discount_factors.data(), prices, size);
+    }
+
+    void BlackScholes::get_call_price_surface(
+        const std::vector<double>& strikes,
+        const std::vector<double>& tenors,
+        std::vector<double>& prices
+    ) const
+    {
+        prices.resize(strikes.size() * tenors.size());
+        for (size_t i = 0; i < tenors.size(); ++i)
+        {
+            const double forward = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenors[i]);
+            const double total_vol = m_volatility * std::sqrt(tenors[i]);
+            const double discount_factor = std::exp(-m_discount_rate * tenors[i]);
+            double* row = prices.data() + i * strikes.size();
+            simd_kernels().black_strike_prices(
+                true, forward, total_vol, discount_factor, strikes.data(), row, strikes.size()
+            );
+        }
+    }
+
+    void BlackScholes::get_put_price_surface(
+        const std::vector<double>& strikes,
+        const std::vector<double>& tenors,
+        std::vector<double>& prices
+    ) const
+    {
+        prices.resize(strikes.size() * tenors.size());
+        for (size_t i = 0; i < tenors.size(); ++i)
+        {
+            const double forward = m_init_level * std::exp((m_discount_rate - m_repo_rate) * tenors[i]);
+            const double total_vol = m_volatility * std::sqrt(tenors[i]);
+            const double discount_factor = std::exp(-m_discount_rate * tenors[i]);
+            double* row = prices.data() + i * strikes.size();
+            simd_kernels().black_strike_prices(
+                false, forward, total_vol, discount_factor, strikes.data(), row, strikes.size()
+            );
+        }
+    }
+
+    BlackScholesGreeks BlackScholes::get_call_greeks(const double strike, const double tenor) const
+    {
+        BlackScholesGreeks greeks;
+        get_call_greeks(&strike, &tenor, &greeks, 1);
+        return greeks;
+    }
+
+    BlackScholesGreeks BlackScholes::get_put_greeks(const double strike, const double tenor) const
+    {
+        BlackScholesGreeks greeks;
+        get_put_greeks(&strike, &tenor, &greeks, 1);
+        return greeks;
+    }
+
+    void BlackScholes::get_call_greeks(
+        const double* strikes,
+        const double* tenors,
+        BlackScholesGreeks* greeks,
+        const size_t size
+    ) const
+    {
+        simd_kernels().black_scholes_greeks(
+            true, m_init_level, m_discount_rate, m_repo_rate, m_volatility, strikes, tenors, greeks, size
+        );
+    }
+
+    void BlackScholes::get_put_greeks(
+        const double* strikes,
+        const double* tenors,
+        BlackScholesGreeks* greeks,
+        const size_t size
+    ) const
+    {
+        simd_kernels().black_scholes_greeks(
+            false, m_init_level, m_discount_rate, m_repo_rate, m_volatility, strikes, tenors, greeks, size
+        );
+    }
+
+    double BlackScholes::get_vega(const double strike, const double tenor) const
+    {
+        return get_call_greeks(strike, tenor).vega;
+    }
+
+    double BlackScholes::get_call_rho(const double strike, const double tenor) const
+    {
+        return -get_call_greeks(strike, tenor).repo_rho;
+    }
+
+    double BlackScholes::get_put_rho(const double strike, const double tenor) const
+    {
+        return -get_put_greeks(strike, tenor).repo_rho;
+    }
+
+    double BlackScholes::get_call_implied_volatility(const double price, const double strike, const double tenor) const
+    {
+        double volatility;
+        get_call_implied_volatilities(&price, &strike, &tenor, &volatility, 1);
+        return volatility;
+    }
+
+    double BlackScholes::get_put_implied_volatility(const double price, const double strike, const double tenor) const
+    {
+        double volatility;
+        get_put_implied_volatilities(&price, &strike, &tenor, &volatility, 1);
+        return volatility;
+    }
+
+    void BlackScholes::get_call_implied_volatilities(
+        const double* prices,
+        const double* strikes,
+        const double* tenors,
+        double* volatilities,
+        const size_t size
+    ) const
+    {
+        simd_kernels().black_scholes_implied_volatilities(
+            true, m_init_level, m_discount_rate, m_repo_rate, prices, strikes, tenors, volatilities, size
+        );
+    }
+
+    void BlackScholes::get_put_implied_volatilities(
+        const double* prices,
+        const double* strikes,
+        const double* tenors,
+        double* volatilities,
+        const size_t size
+    ) const
+    {
+        simd_kernels().black_scholes_implied_volatilities(
+            false, m_init_level, m_discount_rate, m_repo_rate, prices, strikes, tenors, volatilities, size
+        );
+    }
+
+    void BlackScholes::populate_path(
+        std::vector<double>& stock_path, 
+        const std::vector<double>& dtimes,
+        const std::vector<double>& random_normals
+    ) const
+    {
+        ASSERT(dtimes.size() == random_normals.size(), "dtimes and  random_normals must have same size");
+        stock_path.resize(random_normals.size() + 1);
+        populate_path(stock_path.data(), dtimes.data(), random_normals.data(), random_normals.size());
+    }
+
+    void BlackScholes::populate_path(double* stock_path, const double* dtimes, const double* normals, const size_t size) const
+    {
+        const double rho = m_discount_rate - m_repo_rate;
+        double lev = m_init_level;
+        stock_path[0] = lev;
+        for (size_t i = 0; i < size; ++i)
+        {
+            const double dt = dtimes[i];
+            lev *= std::exp((rho - 0.5 * m_volatility * m_volatility) * dt + m_volatility * std::sqrt(dt) * normals[i]);
+            stock_path[i + 1] = lev;
+        }
+    }
+
+    double BlackScholes::evolve_level(double level, const double* dtimes, const double* normals, const size_t size) const
+    {
+        const double rho = m_discount_rate - m_repo_rate;
+        for (size_t i = 0; i < size; ++i)
+        {
+            const double dt = dtimes[i];
+            level *= std::exp((rho - 0.5 * m_volatility * m_volatility) * dt + m_volatility * std::sqrt(dt) * normals[i]);
+        }
+        return level;
+    }
+
+    double BlackScholes::simulate_stock_level(StandardNormalGenerator& rng, const std::vector<double>& dtimes) const
+    {
+        const size_t chunk_size = 64;
+        double normals[chunk_size];
+        double lev = m_init_level;
+        for (size_t first = 0; first < dtimes.size(); first += chunk_size)
+        {
+            const size_t n = std::min(chunk_size, dtimes.size() - first);
+            CLTVT_TIME_PHASE(SimulationPhase::RNG, rng.generate(normals, n));
+            CLTVT_TIME_PHASE(SimulationPhase::PATH, lev = evolve_level(lev, dtimes.data() + first, normals, n));
+        }
+        return lev;
+    }
+
+    double BlackScholes::simulate_stock_level(
+        const PathNormalGenerator& rng,
+        const size_t path,
+        const std::vector<double>& dtimes
+    ) const
+    {
+        const size_t chunk_size = 64;
+        double normals[chunk_size];
+        double lev = m_init_level;
+        for (size_t first = 0; first < dtimes.size(); first += chunk_size)
+        {
+            const size_t n = std::min(chunk_size, dtimes.size() - first);
+            CLTVT_TIME_PHASE(SimulationPhase::RNG, rng.generate(path, first, normals, n));
+            CLTVT_TIME_PHASE(SimulationPhase::PATH, lev = evolve_level(lev, dtimes.data() + first, normals, n));
+        }
+        return lev;
+    }
+
+    double BlackScholes::simulate_stock_level(SobolPathGenerator& rng, const std::vector<double>& dtimes) const
+    {
+        ASSERT(rng.size() == dtimes.size(), "rng must generate one normal per time step");
+        return evolve_level(m_init_level, dtimes.data(), rng.next_path(), dtimes.size());
+    }
+
+    void BlackScholes::simulate_stock_levels(
+        std::vector<double>& stock_levels,
+        const std::vector<double>& dtimes,
+        const size_t num_samples,
+        const size_t seed
+    ) const
+    {
+        CLTVT_COUNT_ALLOCATION(stock_levels, num_samples);
+        stock_levels.resize(0);
+        stock_levels.reserve(num_samples);
+        StandardNormalGenerator rng(seed);
+        for (size_t i = 0; i < num_samples; ++i)
+        {
+            const double level = simulate_stock_level(rng, dtimes);
+            CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, stock_levels.push_back(level));
+        }
+        CLTVT_COUNT_PATHS(num_samples);
+    }
+
+    void BlackScholes::simulate_stock_levels_parallel(
+        std::vector<double>& stock_levels,
+        const std::vector<double>& dtimes,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        CLTVT_COUNT_ALLOCATION(stock_levels, num_samples);
+        stock_levels.resize(num_samples);
+        const PathNormalGenerator rng(seed);
+        auto simulate_block = [&](const size_t block, const size_t) {
+            const size_t begin = block * SIMULATION_BLOCK_SIZE;
+            const size_t end = std::min(begin + SIMULATION_BLOCK_SIZE, num_samples);
+            for (size_t i = begin; i < end; ++i)
+            {
+                const double level = simulate_stock_level(rng, i, dtimes);
+                CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, stock_levels[i] = level);
+            }
+            CLTVT_COUNT_PATHS(end - begin);
+        };
+        ThreadPool::instance().run(num_blocks(num_samples), num_threads, simulate_block);
+    }
+
+    void BlackScholes::simulate_stock_levels_sobol(
+        const std::vector<AccumulatorPtr>& replications,
+        const std::vector<double>& dtimes,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        auto simulate_replication = [&](const size_t replication, const size_t) {
+            SobolPathGenerator rng(dtimes, seed, replication);
+            for (size_t i = 0; i < num_samples; ++i)
+                replications[replication]->add(simulate_stock_level(rng, dtimes));
+        };
+        ThreadPool::instance().run(replications.size(), num_threads, simulate_replication);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include <dispatch.hpp>
+#include <atomic>
+#include <cstdlib>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CLTVT_HAS_CPUID
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace cltvt
+{
+    namespace
+    {
+#ifdef CLTVT_HAS_CPUID
+        void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t (&regs)[4])
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuidex(info, int(leaf), int(subleaf));
+            for (size_t i = 0; i < 4; ++i)
+                regs[i] = uint32_t(info[i]);
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        // State components enabled by the OS in XCR0, only readable if CPUID reports OSXSAVE.
+        uint64_t enabled_state_components()
+        {
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#else
+            uint32_t eax;
+            uint32_t edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return eax | (uint64_t(edx) << 32);
+#endif
+        }
+
+        bool cpu_supports(const SimdIsa isa)
+        {
+            if (isa == SimdIsa::SCALAR)
+                return true;
+            uint32_t regs[4];
+            cpuid(0, 0, regs);
+            const uint32_t max_leaf = regs[0];
+            if (max_leaf < 7)
+                return false;
+            cpuid(1, 0, regs);
+            const bool osxsave = (regs[2] >> 27) & 1;
+            if (!osxsave)
+                return false;
+            const uint64_t xcr0 = enabled_state_components();
+            cpuid(7, 0, regs);
+            const uint32_t features = regs[1];
+            // AVX2 needs the SSE and AVX states, AVX-512 also the opmask and upper ZMM states. /arch:AVX512 lets the
+            // compiler use the DQ, BW and VL extensions besides the foundation (F), so all four are required.
+            if (isa == SimdIsa::AVX2)
+                return ((features >> 5) & 1) && (xcr0 & 0x06) == 0x06;
+            const uint32_t avx512_features = (1u << 16) | (1u << 17) | (1u << 30) | (1u << 31);
+            return (features & avx512_features) == avx512_features && (xcr0 & 0xE6) == 0xE6;
+        }
+#else
+        // Only the scalar kernels run off x86.
+        bool cpu_supports(const SimdIsa isa)
+        {
+            return isa == SimdIsa::SCALAR;
+        }
+#endif
+
+        const SimdKernels* compiled_kernels(const SimdIsa isa)
+        {
+            switch (isa)
+            {
+            case SimdIsa::AVX2:
+                return avx2_kernels();
+            case SimdIsa::AVX512:
+                return avx512_kernels();
+            default:
+                return &scalar_kernels();
+            }
+        }
+
+        std::string environment_variable(const char* name)
+        {
+#ifdef _MSC_VER
+            char* value = nullptr;
+            size_t length = 0;
+            if (_dupenv_s(&value, &length, name) != 0 || value == nullptr)
+                return "";
+            const std::string result(value);
+            free(value);
+            return result;
+#else
+            const char* value = std::getenv(name);
+            return value ? value : "";
+#endif
+        }
+
+        const SimdKernels* initial_kernels()
+        {
+            const std::string name = environment_variable("CLTVT_SIMD_ISA");
+            for (const SimdIsa isa : { SimdIsa::SCALAR, SimdIsa::AVX2, SimdIsa::AVX512 })
+            {
+                if (name == simd_isa_name(isa) && simd_isa_available(isa))
+                    return compiled_kernels(isa);
+            }
+            if (!name.empty())
+                PRINT_ERROR("CLTVT_SIMD_ISA=" + name + " is not an available instruction set, ignored");
+            return compiled_kernels(detect_simd_isa());
+        }
+
+        std::atomic<const SimdKernels*> g_kernels(nullptr);
+    }
+
+    std::string simd_isa_name(const SimdIsa isa)
+    {
+        switch (isa)
+        {
+        case SimdIsa::AVX2:
+            return "avx2";
+        case SimdIsa::AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+        }
+    }
+
+    bool simd_isa_available(const SimdIsa isa)
+    {
+        return compiled_kernels(isa) != nullptr && cpu_supports(isa);
+    }
+
+    SimdIsa detect_simd_isa()
+    {
+        static const SimdIsa detected = simd_isa_available(SimdIsa::AVX512) ? SimdIsa::AVX512
+            : simd_isa_available(SimdIsa::AVX2) ? SimdIsa::AVX2
+            : SimdIsa::SCALAR;
+        return detected;
+    }
+
+    SimdIsa simd_isa()
+    {
+        return simd_kernels().isa;
+    }
+
+    void set_simd_isa(const SimdIsa isa)
+    {
+        ASSERT(simd_isa_available(isa), simd_isa_name(isa) + " kernels are not available");
+        g_kernels.store(compiled_kernels(isa));
+    }
+
+    const SimdKernels& simd_kernels()
+    {
+        const SimdKernels* kernels = g_kernels.load(std::memory_order_acquire);
+        if (kernels == nullptr)
+        {
+            // Concurrent first calls all keep the first pointer stored.
+            kernels = initial_kernels();
+            const SimdKernels* expected = nullptr;
+            if (!g_kernels.compare_exchange_strong(expected, kernels))
+                kernels = expected;
+        }
+        return *kernels;
+    }
+}
\ No newline at end of file
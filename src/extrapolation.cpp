@@ -0,0 +1,371 @@
+#include <extrapolation.hpp>
+#include <special_functions.hpp>
+#include <statistics.hpp>
+#include <workspace.hpp>
+#include <cmath>
+#include <algorithm>
+
+namespace cltvt
+{
+    namespace
+    {
+        const size_t BATCH_LANES = VolatilityTarget::BATCH_LANES;
+        const size_t BATCH_STEPS = 64;
+
+        // Running means and covariance matrix of vectors, updated and merged like RunningCovariance.
+        class RunningMoments
+        {
+        public:
+            RunningMoments(const size_t dimension = 0)
+                :
+                m_count(0),
+                m_mean(dimension, 0.0),
+                m_comoments(dimension * dimension, 0.0)
+            {
+            }
+
+            void add(const double* x)
+            {
+                const size_t d = m_mean.size();
+                ++m_count;
+                double delta[64];
+                for (size_t i = 0; i < d; ++i)
+                {
+                    delta[i] = x[i] - m_mean[i];
+                    m_mean[i] += delta[i] / m_count;
+                }
+                for (size_t i = 0; i < d; ++i)
+                {
+                    for (size_t j = 0; j < d; ++j)
+                        m_comoments[i * d + j] += delta[i] * (x[j] - m_mean[j]);
+                }
+            }
+
+            void merge(const RunningMoments& other)
+            {
+                if (other.m_count == 0)
+                    return;
+                if (m_count == 0)
+                {
+                    *this = other;
+                    return;
+                }
+                const size_t d = m_mean.size();
+                const double count = double(m_count + other.m_count);
+                const double weight = double(m_count) * double(other.m_count) / count;
+                std::vector<double> delta(d);
+                for (size_t i = 0; i < d; ++i)
+                    delta[i] = other.m_mean[i] - m_mean[i];
+                for (size_t i = 0; i < d; ++i)
+                {
+                    m_mean[i] += delta[i] * other.m_count / count;
+                    for (size_t j = 0; j < d; ++j)
+                        m_comoments[i * d + j] += other.m_comoments[i * d + j] + delta[i] * delta[j] * weight;
+                }
+                m_count += other.m_count;
+            }
+
+            size_t count() const
+            {
+                return m_count;
+            }
+
+            double mean(const size_t i) const
+            {
+                return m_mean[i];
+            }
+
+            // Variance of sum_i weights[i] x[i].
+            double variance(const std::vector<double>& weights) const
+            {
+                const size_t d = m_mean.size();
+                double sum = 0.0;
+                for (size_t i = 0; i < d; ++i)
+                {
+                    for (size_t j = 0; j < d; ++j)
+                        sum += weights[i] * weights[j] * m_comoments[i * d + j];
+                }
+                return sum / (m_count - 1);
+            }
+
+        private:
+            size_t m_count;
+            std::vector<double> m_mean;
+            std::vector<double> m_comoments;
+        };
+
+        // Rows of the least squares pseudo-inverse of the design matrix with rows (1, (n_max / n)^orders[j]...), i.e.
+        // the weights of the estimates in each fitted parameter.
+        std::vector<std::vector<double>> fit_weights(const std::vector<size_t>& ns, const std::vector<double>& orders)
+        {
+            const size_t num_params = orders.size() + 1;
+            const double n_max = double(ns.back());
+            std::vector<std::vector<double>> design(ns.size(), std::vector<double>(num_params, 1.0));
+            for (size_t k = 0; k < ns.size(); ++k)
+            {
+                for (size_t j = 0; j < orders.size(); ++j)
+                    design[k][j + 1] = std::pow(n_max / ns[k], orders[j]);
+            }
+
+            // Gauss-Jordan elimination of [A^T A | A^T].
+            std::vector<std::vector<double>> system(num_params, std::vector<double>(num_params + ns.size(), 0.0));
+            for (size_t i = 0; i < num_params; ++i)
+            {
+                for (size_t k = 0; k < ns.size(); ++k)
+                {
+                    for (size_t j = 0; j < num_params; ++j)
+                        system[i][j] += design[k][i] * design[k][j];
+                    system[i][num_params + k] = design[k][i];
+                }
+            }
+            for (size_t col = 0; col < num_params; ++col)
+            {
+                size_t pivot = col;
+                for (size_t i = col + 1; i < num_params; ++i)
+                {
+                    if (std::abs(system[i][col]) > std::abs(system[pivot][col]))
+                        pivot = i;
+                }
+                ASSERT(std::abs(system[pivot][col]) > 1e-12, "orders must be distinct and positive");
+                std::swap(system[col], system[pivot]);
+                const double scale = 1.0 / system[col][col];
+                for (double& value : system[col])
+                    value *= scale;
+                for (size_t i = 0; i < num_params; ++i)
+                {
+                    if (i == col)
+                        continue;
+                    const double factor = system[i][col];
+                    for (size_t j = 0; j < system[i].size(); ++j)
+                        system[i][j] -= factor * system[col][j];
+                }
+            }
+
+            std::vector<std::vector<double>> weights(num_params);
+            for (size_t i = 0; i < num_params; ++i)
+                weights[i].assign(system[i].begin() + num_params, system[i].end());
+            return weights;
+        }
+    }
+
+    VolatilityTargetLadder::VolatilityTargetLadder(const VolatilityTarget& target, const size_t num_grids, const size_t ratio)
+        :
+        m_ratio(ratio)
+    {
+        ASSERT(num_grids > 1, "num_grids > 1 must be true");
+        ASSERT(ratio > 1, "ratio > 1 must be true");
+        size_t span = 1;
+        for (size_t k = 1; k < num_grids; ++k)
+            span *= ratio;
+        ASSERT(target.num_time_steps() % span == 0, "num_time_steps must be divisible by ratio^(num_grids - 1)");
+        for (size_t k = 0; k < num_grids; ++k)
+        {
+            m_grids.emplace_back(
+                target.sde(),
+                target.lambda(),
+                target.num_time_steps() / span,
+                target.target_volatility(),
+                target.tenor(),
+                target.init_var(),
+                target.init_level()
+            );
+            span /= ratio;
+        }
+    }
+
+    size_t VolatilityTargetLadder::num_grids() const
+    {
+        return m_grids.size();
+    }
+
+    const VolatilityTarget& VolatilityTargetLadder::grid(const size_t k) const
+    {
+        return m_grids[k];
+    }
+
+    ExtrapolatedEstimate VolatilityTargetLadder::extrapolate_call_price(
+        const double strike,
+        const size_t num_samples,
+        const std::vector<double>& orders,
+        const double confidence,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        return extrapolate(Quantity::CALL_PRICE, strike, num_samples, orders, confidence, num_threads, seed);
+    }
+
+    ExtrapolatedEstimate VolatilityTargetLadder::extrapolate_volatility(
+        const size_t num_samples,
+        const std::vector<double>& orders,
+        const double confidence,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        return extrapolate(Quantity::VOLATILITY, 0.0, num_samples, orders, confidence, num_threads, seed);
+    }
+
+    size_t VolatilityTargetLadder::chunk_steps() const
+    {
+        const size_t span = m_grids.back().num_time_steps() / m_grids.front().num_time_steps();
+        return (BATCH_STEPS + span - 1) / span * span;
+    }
+
+    void VolatilityTargetLadder::simulate_batch(
+        const PathNormalGenerator& rng,
+        const size_t first_path,
+        double* levels,
+        double* vars,
+        double* normals
+    ) const
+    {
+        const size_t num_grids = m_grids.size();
+        const double scale = 1.0 / std::sqrt(double(m_ratio));
+        for (size_t k = 0; k < num_grids; ++k)
+        {
+            std::fill(levels + k * BATCH_LANES, levels + (k + 1) * BATCH_LANES, m_grids[k].init_level());
+            std::fill(vars + k * BATCH_LANES, vars + (k + 1) * BATCH_LANES, m_grids[k].init_var());
+        }
+        const size_t chunk = chunk_steps();
+        const size_t finest_steps = m_grids.back().num_time_steps();
+        for (size_t step = 0; step < finest_steps; step += chunk)
+        {
+            size_t num_steps = std::min(chunk, finest_steps - step);
+            rng.generate_paths(first_path, BATCH_LANES, step, num_steps, normals);
+            for (size_t k = num_grids; k-- > 0;)
+            {
+                if (k + 1 < num_grids)
+                {
+                    // Normals of grid k from those of grid k + 1, in place: row i only reads rows i and above.
+                    num_steps /= m_ratio;
+                    for (size_t i = 0; i < num_steps; ++i)
+                    {
+                        for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+                        {
+                            double sum = 0.0;
+                            for (size_t j = 0; j < m_ratio; ++j)
+                                sum += normals[(i * m_ratio + j) * BATCH_LANES + lane];
+                            normals[i * BATCH_LANES + lane] = sum * scale;
+                        }
+                    }
+                }
+                m_grids[k].advance_vt_batch(levels + k * BATCH_LANES, vars + k * BATCH_LANES, normals, num_steps);
+            }
+        }
+    }
+
+    ExtrapolatedEstimate VolatilityTargetLadder::extrapolate(
+        const Quantity quantity,
+        const double strike,
+        const size_t num_samples,
+        const std::vector<double>& orders,
+        const double confidence,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        const size_t num_grids = m_grids.size();
+        ASSERT(num_samples > 2, "num_samples > 2 must be true");
+        ASSERT(!orders.empty() && orders.size() < num_grids, "0 < orders.size() < num_grids must be true");
+        ASSERT(confidence > 0.0 && confidence < 1.0, "0 < confidence < 1 must be true");
+        ASSERT(2 * num_grids <= 64, "num_grids <= 32 must be true");
+        const double tenor = m_grids.back().tenor();
+        const double init_level = m_grids.back().init_level();
+        const double discount_factor = std::exp(-m_grids.back().sde()->discount_rate() * tenor);
+
+        // Sample i holds (x, y) for every grid: the discounted payoff twice for the price, the log level and its square
+        // for the volatility.
+        const PathNormalGenerator rng(seed);
+        auto simulate_range = [&](const size_t begin, const size_t end, RunningMoments& partial) {
+            SimulationWorkspace& workspace = thread_workspace();
+            const SimulationWorkspace::Frame frame(workspace);
+            double* levels = workspace.allocate<double>(num_grids * BATCH_LANES);
+            double* vars = workspace.allocate<double>(num_grids * BATCH_LANES);
+            double* normals = workspace.allocate<double>(chunk_steps() * BATCH_LANES);
+            double* sample = workspace.allocate<double>(2 * num_grids);
+            for (size_t first = begin; first < end; first += BATCH_LANES)
+            {
+                simulate_batch(rng, first, levels, vars, normals);
+                const size_t num_lanes = std::min(BATCH_LANES, end - first);
+                for (size_t lane = 0; lane < num_lanes; ++lane)
+                {
+                    for (size_t k = 0; k < num_grids; ++k)
+                    {
+                        const double level = levels[k * BATCH_LANES + lane];
+                        if (quantity == Quantity::CALL_PRICE)
+                        {
+                            sample[2 * k] = discount_factor * std::max(level - strike, 0.0);
+                            sample[2 * k + 1] = sample[2 * k];
+                        }
+                        else
+                        {
+                            sample[2 * k] = std::log(level / init_level);
+                            sample[2 * k + 1] = sample[2 * k] * sample[2 * k];
+                        }
+                    }
+                    partial.add(sample);
+                }
+            }
+        };
+        std::vector<RunningMoments> partials(num_partial_ranges(num_samples), RunningMoments(2 * num_grids));
+        simulate_partials(partials, num_samples, num_threads, simulate_range);
+        RunningMoments moments(2 * num_grids);
+        for (const RunningMoments& partial : partials)
+            moments.merge(partial);
+
+        // Estimates g(E[x], E[y]) of the grids and their gradients (a, b), which linearise them around the means.
+        ExtrapolatedEstimate result;
+        std::vector<double> gradients(2 * num_grids, 0.0);
+        for (size_t k = 0; k < num_grids; ++k)
+        {
+            const double mean_x = moments.mean(2 * k);
+            const double mean_y = moments.mean(2 * k + 1);
+            double estimate = mean_x;
+            gradients[2 * k] = 1.0;
+            if (quantity == Quantity::VOLATILITY)
+            {
+                estimate = std::sqrt((mean_y - mean_x * mean_x) / tenor);
+                gradients[2 * k] = -mean_x / (estimate * tenor);
+                gradients[2 * k + 1] = 0.5 / (estimate * tenor);
+            }
+            std::vector<double> weights(2 * num_grids, 0.0);
+            weights[2 * k] = gradients[2 * k];
+            weights[2 * k + 1] = gradients[2 * k + 1];
+            result.num_time_steps.push_back(m_grids[k].num_time_steps());
+            result.estimates.push_back(estimate);
+            result.standard_errors.push_back(std::sqrt(moments.variance(weights) / num_samples));
+        }
+
+        const std::vector<std::vector<double>> fit = fit_weights(result.num_time_steps, orders);
+        std::vector<double> params(fit.size(), 0.0);
+        for (size_t i = 0; i < fit.size(); ++i)
+        {
+            for (size_t k = 0; k < num_grids; ++k)
+                params[i] += fit[i][k] * result.estimates[k];
+        }
+        const double n_max = double(result.num_time_steps.back());
+        for (size_t j = 0; j < orders.size(); ++j)
+            result.coefficients.push_back(params[j + 1] * std::pow(n_max, orders[j]));
+        for (size_t k = 0; k < num_grids; ++k)
+        {
+            double fitted = params[0];
+            for (size_t j = 0; j < orders.size(); ++j)
+                fitted += params[j + 1] * std::pow(n_max / result.num_time_steps[k], orders[j]);
+            result.residuals.push_back(result.estimates[k] - fitted);
+        }
+
+        std::vector<double> weights(2 * num_grids);
+        for (size_t k = 0; k < num_grids; ++k)
+        {
+            weights[2 * k] = fit[0][k] * gradients[2 * k];
+            weights[2 * k + 1] = fit[0][k] * gradients[2 * k + 1];
+        }
+        const double z = inverse_normal_cdf(0.5 + 0.5 * confidence);
+        result.value = params[0];
+        result.standard_error = std::sqrt(moments.variance(weights) / num_samples);
+        result.lower = result.value - z * result.standard_error;
+        result.upper = result.value + z * result.standard_error;
+        return result;
+    }
+}
\ No newline at end of file
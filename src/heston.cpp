@@ -0,0 +1,164 @@
+#include <heston.hpp>
+#include <dispatch.hpp>
+
+namespace cltvt
+{
+    const double HestonQEStep::PSI_C = 1.5;
+
+    void HestonQEStep::advance_lanes(
+        double* vars,
+        double* rets,
+        const double* normals,
+        const size_t num_steps,
+        const size_t num_lanes
+    ) const
+    {
+        ASSERT(num_lanes % MAX_SIMD_WIDTH == 0, "num_lanes must be a multiple of MAX_SIMD_WIDTH");
+        simd_kernels().advance_heston_lanes(this, vars, rets, normals, num_steps, num_lanes);
+    }
+
+    Heston::Heston(
+        const double discount_rate,
+        const double repo_rate,
+        const double kappa,
+        const double theta,
+        const double vol_of_vol,
+        const double correlation,
+        const double init_var,
+        const double init_level
+    )
+        :
+        m_discount_rate(discount_rate),
+        m_repo_rate(repo_rate),
+        m_kappa(kappa),
+        m_theta(theta),
+        m_vol_of_vol(vol_of_vol),
+        m_correlation(correlation),
+        m_init_var(init_var),
+        m_init_level(init_level)
+    {
+        ASSERT(m_kappa > 0.0, "kappa must be positive");
+        ASSERT(m_theta > 0.0, "theta must be positive");
+        ASSERT(m_vol_of_vol > 0.0, "vol_of_vol must be positive");
+        ASSERT(m_correlation >= -1.0 && m_correlation <= 1.0, "-1.0 <= correlation <= 1.0 must be true");
+        ASSERT(m_init_var >= 0.0, "init_var must not be negative");
+        ASSERT(m_init_level > 0.0, "init_level must be positive");
+    }
+
+    HestonPtr Heston::create(
+        const double discount_rate,
+        const double repo_rate,
+        const double kappa,
+        const double theta,
+        const double vol_of_vol,
+        const double correlation,
+        const double init_var,
+        const double init_level
+    )
+    {
+        return std::make_shared<Heston>(discount_rate, repo_rate, kappa, theta, vol_of_vol, correlation, init_var, init_level);
+    }
+
+    double Heston::discount_rate() const
+    {
+        return m_discount_rate;
+    }
+
+    double Heston::repo_rate() const
+    {
+        return m_repo_rate;
+    }
+
+    double Heston::kappa() const
+    {
+        return m_kappa;
+    }
+
+    double Heston::theta() const
+    {
+        return m_theta;
+    }
+
+    double Heston::vol_of_vol() const
+    {
+        return m_vol_of_vol;
+    }
+
+    double Heston::correlation() const
+    {
+        return m_correlation;
+    }
+
+    double Heston::init_var() const
+    {
+        return m_init_var;
+    }
+
+    double Heston::init_level() const
+    {
+        return m_init_level;
+    }
+
+    HestonQEStep Heston::qe_step(const double dt) const
+    {
+        const double decay = std::exp(-m_kappa * dt);
+        const double xi2 = m_vol_of_vol * m_vol_of_vol;
+        const double rho_over_xi = m_correlation / m_vol_of_vol;
+        HestonQEStep step;
+        step.drift_dt = (m_discount_rate - m_repo_rate) * dt;
+        step.rate_dt = m_discount_rate * dt;
+        step.decay = decay;
+        step.mean_shift = m_theta * (1.0 - decay);
+        step.var_s2 = xi2 * decay * (1.0 - decay) / m_kappa;
+        step.const_s2 = m_theta * xi2 * (1.0 - decay) * (1.0 - decay) / (2.0 * m_kappa);
+        step.k0 = -rho_over_xi * m_kappa * m_theta * dt;
+        step.k1 = 0.5 * dt * (m_kappa * rho_over_xi - 0.5) - rho_over_xi;
+        step.k2 = 0.5 * dt * (m_kappa * rho_over_xi - 0.5) + rho_over_xi;
+        step.k3 = 0.5 * dt * (1.0 - m_correlation * m_correlation);
+        step.k4 = step.k3;
+        step.mgf_coeff = step.k2 + 0.5 * step.k4;
+        return step;
+    }
+
+    double Heston::expected_var(const double t) const
+    {
+        return m_theta + (m_init_var - m_theta) * std::exp(-m_kappa * t);
+    }
+
+    void Heston::populate_path(
+        std::vector<double>& stock_path,
+        const std::vector<double>& dtimes,
+        const std::vector<double>& random_normals
+    ) const
+    {
+        ASSERT(random_normals.size() == 2 * dtimes.size(), "random_normals must hold two normals per time step");
+        stock_path.resize(dtimes.size() + 1);
+        populate_path(stock_path.data(), nullptr, dtimes.data(), random_normals.data(), dtimes.size());
+    }
+
+    void Heston::populate_path(
+        double* stock_path,
+        double* var_path,
+        const double* dtimes,
+        const double* normals,
+        const size_t size
+    ) const
+    {
+        double level = m_init_level;
+        double var = m_init_var;
+        stock_path[0] = level;
+        if (var_path)
+            var_path[0] = var;
+        HestonQEStep step;
+        for (size_t i = 0; i < size; ++i)
+        {
+            // The constants only change with the time step.
+            if (i == 0 || dtimes[i] != dtimes[i - 1])
+                step = qe_step(dtimes[i]);
+            level *= 1.0 + step.advance(var, normals + 2 * i);
+            stock_path[i + 1] = level;
+            if (var_path)
+                var_path[i + 1] = var;
+        }
+    }
+}
\ No newline at end of file
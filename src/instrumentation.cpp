@@ -0,0 +1,115 @@
+#include <instrumentation.hpp>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace cltvt
+{
+    namespace
+    {
+        const char* const PHASE_NAMES[NUM_SIMULATION_PHASES] = { "rng", "path", "vt_recursion", "output" };
+
+        // Padded so that the counters of two threads never share a cache line.
+        struct PaddedCounters
+        {
+            char before[64];
+            ThreadCounters counters;
+            char after[64];
+        };
+
+        // Counters are never freed, so the pointer cached by each thread stays valid across resets.
+        std::mutex g_registry_mutex;
+        std::vector<std::unique_ptr<PaddedCounters>> g_registry;
+
+        void clear(ThreadCounters& counters)
+        {
+            for (size_t p = 0; p < NUM_SIMULATION_PHASES; ++p)
+                counters.cycles[p] = 0;
+            counters.paths = 0;
+            counters.bytes_allocated = 0;
+        }
+
+        bool is_empty(const ThreadCounters& counters)
+        {
+            uint64_t cycles = 0;
+            for (size_t p = 0; p < NUM_SIMULATION_PHASES; ++p)
+                cycles += counters.cycles[p];
+            return cycles == 0 && counters.paths == 0 && counters.bytes_allocated == 0;
+        }
+
+        void write_counters(std::ostream& os, const ThreadCounters& counters)
+        {
+            os << "{\"cycles\": {";
+            for (size_t p = 0; p < NUM_SIMULATION_PHASES; ++p)
+                os << (p > 0 ? ", " : "") << "\"" << PHASE_NAMES[p] << "\": " << counters.cycles[p];
+            os << "}, \"paths\": " << counters.paths << ", \"bytes_allocated\": " << counters.bytes_allocated << "}";
+        }
+    }
+
+    std::string InstrumentationReport::to_json() const
+    {
+        std::ostringstream os;
+        os << "{\n  \"total\": ";
+        write_counters(os, total);
+        os << ",\n  \"threads\": [";
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            os << (i > 0 ? ",\n    " : "\n    ");
+            write_counters(os, threads[i]);
+        }
+        os << (threads.empty() ? "]\n}\n" : "\n  ]\n}\n");
+        return os.str();
+    }
+
+    void InstrumentationReport::write_json(const std::string& path) const
+    {
+        std::ofstream outfile;
+        outfile.open(path);
+        ASSERT(outfile.is_open(), "cannot open " + path);
+        outfile << to_json();
+        outfile.close();
+    }
+
+    namespace instrumentation
+    {
+        ThreadCounters& thread_counters()
+        {
+            thread_local ThreadCounters* t_counters = nullptr;
+            if (!t_counters)
+            {
+                std::lock_guard<std::mutex> lock(g_registry_mutex);
+                g_registry.emplace_back(new PaddedCounters());
+                t_counters = &g_registry.back()->counters;
+                clear(*t_counters);
+            }
+            return *t_counters;
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            for (const auto& padded : g_registry)
+                clear(padded->counters);
+        }
+
+        InstrumentationReport report()
+        {
+            InstrumentationReport result;
+            clear(result.total);
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            for (const auto& padded : g_registry)
+            {
+                const ThreadCounters& counters = padded->counters;
+                if (is_empty(counters))
+                    continue;
+                result.threads.push_back(counters);
+                for (size_t p = 0; p < NUM_SIMULATION_PHASES; ++p)
+                    result.total.cycles[p] += counters.cycles[p];
+                result.total.paths += counters.paths;
+                result.total.bytes_allocated += counters.bytes_allocated;
+            }
+            return result;
+        }
+    }
+}
\ No newline at end of file
@@ -1,24 +1,56 @@
-#include <integration.hpp>
-
-namespace cltvt
-{
-    double integrate(const Function& f, const double a, const double b, const size_t N)
-    {
-        ASSERT(a < b, "a < b must be true");
-        ASSERT(N > 0, "N > 0 must be true");
-        
-        const double dx = (b - a) / N;
-        double x0 = a;
-        double x1 = x0 + dx;
-        double s = 0.0;
-        while (x1 < b)
-        {
-            const double x = 0.5 * (x0 + x1);
-            s += f(x);
-            x0 += dx;
-            x1 += dx;
-        }
-        s *= dx;
-        return s;
-    }
+#include <integration.hpp>
+
+namespace cltvt
+{
+    namespace quadrature
+    {
+        const double KRONROD_NODES[8] = {
+            0.991455371120812639206854697526329,
+            0.949107912342758524526189684047851,
+            0.864864423359769072789712788640926,
+            0.741531185599394439863864773280788,
+            0.586087235467691130294144845693013,
+            0.405845151377397166906606412076961,
+            0.207784955007898467600689403773245,
+            0.0
+        };
+
+        const double KRONROD_WEIGHTS[8] = {
+            0.022935322010529224963732008058970,
+            0.063092092629978553290700663189204,
+            0.104790010322250183839876322541518,
+            0.140653259715525918745189590510238,
+            0.169004726639267902826583426598550,
+            0.190350578064785409913256402421014,
+            0.204432940075298892414161999234649,
+            0.209482141084727828012999174891714
+        };
+
+        const double GAUSS_WEIGHTS[4] = {
+            0.129484966168869693270611432679082,
+            0.279705391489276667901467771423780,
+            0.381830050505118944950369775488975,
+            0.417959183673469387755102040816327
+        };
+    }
+
+    double integrate(const Function& f, const double a, const double b, const size_t N)
+    {
+        ASSERT(a < b, "a < b must be true");
+        ASSERT(N > 0, "N > 0 must be true");
+        
+        const double dx = (b - a) / N;
+        double x0 = a;
+        double x1 = x0 + dx;
+        double s = 0.0;
+        while (x1 < b)
+        {
+            const double x = 0.5 * (x0 + x1);
+            s += f(x);
+            x0 += dx;
+            x1 += dx;
+        }
+        s *= dx;
+        return s;
+    }
 }
\ No newline at end of file
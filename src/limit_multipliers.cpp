@@ -0,0 +1,157 @@
+#include <limit_multipliers.hpp>
+#include <integration.hpp>
+#include <special_functions.hpp>
+#include <dispatch.hpp>
+#include <cmath>
+
+namespace cltvt
+{
+    namespace
+    {
+        // Absolute and relative tolerance of the quadratures, well below the accuracy of the LimitMultipliers tables
+        // built from them.
+        const double QUADRATURE_TOLERANCE = 1e-12;
+
+        // Coefficients of the polynomial of degree n - 1 that interpolates values at the Chebyshev extreme points
+        // x_k = cos(pi k / (n - 1)).
+        void chebyshev_coefficients(const std::vector<double>& values, std::vector<double>& coeffs)
+        {
+            const size_t m = values.size() - 1;
+            coeffs.assign(m + 1, 0.0);
+            for (size_t j = 0; j <= m; ++j)
+            {
+                for (size_t k = 0; k <= m; ++k)
+                    coeffs[j] += (k == 0 || k == m ? 0.5 : 1.0) * values[k] * std::cos(PI * j * k / m);
+                coeffs[j] *= (j == 0 || j == m ? 1.0 : 2.0) / m;
+            }
+        }
+    }
+
+    double multiplier_U(const double lambda)
+    {
+        ASSERT(lambda > 0.0 && lambda < 1.0, "0.0 < lambda < 1.0 must be true");
+        const double scale = 1.0 - lambda;
+        const QPochhammer pochhammer(lambda);
+        auto f = [&pochhammer, scale](const double s) {
+            return std::exp(-0.5 * pochhammer.log_value(-scale * s * s));
+        };
+
+        const QuadratureResult result = integrate_adaptive(f, 0.0, INF, QUADRATURE_TOLERANCE, QUADRATURE_TOLERANCE);
+        ASSERT(result.converged, "the quadrature of multiplier_U must converge");
+        return std::sqrt(2.0 / PI) * result.value;
+    }
+
+    double multiplier_V(const double lambda)
+    {
+        ASSERT(lambda > 0.0 && lambda < 1.0, "0.0 < lambda < 1.0 must be true");
+        const double scale = 1.0 - lambda;
+        const QPochhammer pochhammer(lambda);
+        auto f = [&pochhammer, scale](const double s) {
+            return std::exp(-0.5 * pochhammer.log_value(-scale * s));
+        };
+
+        const QuadratureResult result = integrate_adaptive(f, 0.0, INF, QUADRATURE_TOLERANCE, QUADRATURE_TOLERANCE);
+        ASSERT(result.converged, "the quadrature of multiplier_V must converge");
+        return 0.5 * result.value;
+    }
+
+    LimitMultipliers::LimitMultipliers(const double lambda_min, const size_t num_nodes)
+        :
+        m_lambda_min(lambda_min),
+        m_u_scale(-2.0 / std::log(lambda_min))
+    {
+        ASSERT(lambda_min > 0.0 && lambda_min < 1.0, "0.0 < lambda_min < 1.0 must be true");
+        ASSERT(num_nodes > 1, "num_nodes > 1 must be true");
+
+        // The node lambda = 1 takes the limit U = V = 1, the others the quadratures.
+        std::vector<double> log_us(num_nodes, 0.0);
+        std::vector<double> log_vs(num_nodes, 0.0);
+        for (size_t k = 0; k + 1 < num_nodes; ++k)
+        {
+            const double x = std::cos(PI * k / (num_nodes - 1));
+            const double lambda = std::exp(-(x + 1.0) / m_u_scale);
+            log_us[k] = std::log(multiplier_U(lambda));
+            log_vs[k] = std::log(multiplier_V(lambda));
+        }
+        chebyshev_coefficients(log_us, m_log_u_coeffs);
+        chebyshev_coefficients(log_vs, m_log_v_coeffs);
+    }
+
+    LimitMultipliersPtr LimitMultipliers::create(const double lambda_min, const size_t num_nodes)
+    {
+        return std::make_shared<LimitMultipliers>(lambda_min, num_nodes);
+    }
+
+    double LimitMultipliers::lambda_min() const
+    {
+        return m_lambda_min;
+    }
+
+    size_t LimitMultipliers::num_nodes() const
+    {
+        return m_log_u_coeffs.size();
+    }
+
+    double LimitMultipliers::U(const double lambda) const
+    {
+        double u;
+        evaluate(&lambda, &u, nullptr, 1);
+        return u;
+    }
+
+    double LimitMultipliers::V(const double lambda) const
+    {
+        double v;
+        evaluate(&lambda, nullptr, &v, 1);
+        return v;
+    }
+
+    void LimitMultipliers::evaluate(const double* lambdas, double* us, double* vs, const size_t size) const
+    {
+        for (size_t i = 0; i < size; ++i)
+            ASSERT(lambdas[i] >= m_lambda_min && lambdas[i] <= 1.0, "lambda must be in [lambda_min, 1]");
+        simd_kernels().limit_multipliers(
+            lambdas, us, vs, size, m_u_scale, m_log_u_coeffs.data(), m_log_v_coeffs.data(), m_log_u_coeffs.size()
+        );
+    }
+
+    BlackScholesPtr LimitMultipliers::limit_sde(
+        const BlackScholes& sde,
+        const double lambda,
+        const double target_volatility,
+        const double init_level
+    ) const
+    {
+        double u;
+        double v;
+        evaluate(&lambda, &u, &v, 1);
+        const double limit_vol = target_volatility * std::sqrt(v);
+        const double limit_repo = u * target_volatility / sde.volatility() * sde.repo_rate();
+        return BlackScholes::create(sde.discount_rate(), limit_repo, limit_vol, init_level);
+    }
+
+    void LimitMultipliers::limit_call_prices(
+        const BlackScholes& sde,
+        const double target_volatility,
+        const double init_level,
+        const double strike,
+        const double tenor,
+        const double* lambdas,
+        double* prices,
+        const size_t size
+    ) const
+    {
+        std::vector<double> forwards(size);
+        std::vector<double> total_vols(size);
+        evaluate(lambdas, forwards.data(), total_vols.data(), size);
+        const double repo_scale = target_volatility / sde.volatility() * sde.repo_rate() * tenor;
+        for (size_t i = 0; i < size; ++i)
+        {
+            forwards[i] = init_level * std::exp(sde.discount_rate() * tenor - forwards[i] * repo_scale);
+            total_vols[i] = target_volatility * std::sqrt(total_vols[i] * tenor);
+        }
+        const std::vector<double> strikes(size, strike);
+        const std::vector<double> discount_factors(size, std::exp(-sde.discount_rate() * tenor));
+        black_call_prices(forwards.data(), strikes.data(), total_vols.data(), discount_factors.data(), prices, size);
+    }
+}
\ No newline at end of file
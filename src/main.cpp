@@ -1,26 +1,73 @@
-#include <tests.hpp>
-#include <special_functions.hpp>
-#include <iostream>
-
-int main()
-{
-    using namespace cltvt;
-
-    test_multiplier_U_bounds();
-
-    test_multiplier_V_bounds();
-
-    test_vt_volatility();
-
-    test_vt_volatility_simultaneous_limit();
-
-    test_vt_volatility_limit_along_path_1();
-
-    test_vt_volatility_limit_along_path_2();
-
-    test_vt_pricing();
-
-    test_vt_vega();
-
-    return 0;
+#include <tests.hpp>
+#include <special_functions.hpp>
+#ifdef CLTVT_INSTRUMENTATION
+#include <volatility_target.hpp>
+#include <instrumentation.hpp>
+#endif
+#include <iostream>
+
+int main()
+{
+    using namespace cltvt;
+
+    test_multiplier_U_bounds();
+
+    test_multiplier_V_bounds();
+
+    test_integrate_adaptive();
+
+    test_limit_multipliers();
+
+    test_vt_volatility();
+
+    test_vt_volatility_simultaneous_limit();
+
+    test_vt_volatility_limit_along_path_1();
+
+    test_vt_volatility_limit_along_path_2();
+
+    test_vt_pricing();
+
+    test_vt_vega();
+
+    test_vt_parallel_reproducibility();
+
+    test_vt_pricing_control_variate();
+
+    test_vt_pricing_sobol();
+
+    test_vt_multilevel();
+
+    test_vt_extrapolation();
+
+    test_simulation_workspace();
+
+    test_model_volatility_target();
+
+    test_vt_heston();
+
+    test_simd_lane_equivalence();
+
+    test_simd_dispatch();
+
+    test_vt_call_gradient();
+
+    test_implied_volatility();
+
+#ifdef CLTVT_INSTRUMENTATION
+    {
+        // Counters of one parallel simulation, printed and written next to the test results.
+        const BlackScholesPtr sde = BlackScholes::create(0.05, 0.02, 0.5, 1.0);
+        const VolatilityTarget vt(sde, 0.9, 1000, 0.2, 1.0, 0.02, 1.0);
+        std::vector<double> vt_levels;
+        instrumentation::reset();
+        vt.simulate_vt_levels_parallel(vt_levels, 100000);
+        const InstrumentationReport report = instrumentation::report();
+        ASSERT(report.total.paths == vt_levels.size(), "every simulated path must be counted");
+        std::cout << "Instrumentation counters:\n" << report.to_json() << std::endl;
+        report.write_json(root_dir() + "/tests/instrumentation.json");
+    }
+#endif
+
+    return 0;
 }
\ No newline at end of file
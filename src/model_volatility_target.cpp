@@ -0,0 +1,60 @@
+#include <model_volatility_target.hpp>
+#include <volatility_target.hpp>
+
+namespace cltvt
+{
+    BlackScholesStepper::BlackScholesStepper(const BlackScholes& sde, const double dt)
+        :
+        m_drift_dt((sde.discount_rate() - sde.repo_rate() - 0.5 * sde.volatility() * sde.volatility()) * dt),
+        m_vol_sqrt_dt(sde.volatility() * std::sqrt(dt)),
+        m_rate_dt(sde.discount_rate() * dt)
+    {
+    }
+
+    void BlackScholesStepper::step_lanes(
+        double*,
+        double* rets,
+        const double* normals,
+        const size_t num_steps,
+        const size_t num_lanes
+    ) const
+    {
+        simd_kernels().lognormal_returns(normals, rets, num_steps * num_lanes, m_drift_dt, m_vol_sqrt_dt);
+    }
+
+    HestonQEStepper::HestonQEStepper(const Heston& model, const double dt)
+        :
+        m_step(model.qe_step(dt)),
+        m_init_var(model.init_var())
+    {
+    }
+
+    void HestonQEStepper::init_lanes(double* states, const size_t num_lanes) const
+    {
+        std::fill(states, states + num_lanes, m_init_var);
+    }
+
+    void HestonQEStepper::step_lanes(
+        double* states,
+        double* rets,
+        const double* normals,
+        const size_t num_steps,
+        const size_t num_lanes
+    ) const
+    {
+        m_step.advance_lanes(states, rets, normals, num_steps, num_lanes);
+    }
+
+    AnyVolatilityTargetPtr create_any_volatility_target(const VolatilityTarget& target)
+    {
+        return BlackScholesVolatilityTarget::create(
+            *target.sde(),
+            target.lambda(),
+            target.num_time_steps(),
+            target.target_volatility(),
+            target.tenor(),
+            target.init_var(),
+            target.init_level()
+        );
+    }
+}
\ No newline at end of file
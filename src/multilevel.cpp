@@ -0,0 +1,302 @@
+#include <multilevel.hpp>
+#include <parallel.hpp>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+namespace cltvt
+{
+    namespace
+    {
+        const size_t BATCH_LANES = VolatilityTarget::BATCH_LANES;
+        const size_t BATCH_STEPS = 64;
+        const size_t LEVEL_PATH_SHIFT = 40;
+    }
+
+    double MultilevelEstimate::cost_reduction() const
+    {
+        return single_level_cost / cost;
+    }
+
+    void MultilevelVolatilityTarget::LevelSamples::merge(const LevelSamples& other)
+    {
+        fine.merge(other.fine);
+        corrections.merge(other.corrections);
+    }
+
+    MultilevelVolatilityTarget::MultilevelVolatilityTarget(const VolatilityTarget& target, const size_t num_levels)
+    {
+        ASSERT(num_levels > 0 && num_levels < 32, "0 < num_levels < 32 must be true");
+        const size_t coarsest_steps = target.num_time_steps() >> (num_levels - 1);
+        ASSERT(
+            coarsest_steps << (num_levels - 1) == target.num_time_steps(),
+            "num_time_steps must be divisible by 2^(num_levels - 1)"
+        );
+        for (size_t l = 0; l < num_levels; ++l)
+        {
+            m_levels.emplace_back(
+                target.sde(),
+                target.lambda(),
+                coarsest_steps << l,
+                target.target_volatility(),
+                target.tenor(),
+                target.init_var(),
+                target.init_level()
+            );
+        }
+    }
+
+    size_t MultilevelVolatilityTarget::num_levels() const
+    {
+        return m_levels.size();
+    }
+
+    const VolatilityTarget& MultilevelVolatilityTarget::level(const size_t l) const
+    {
+        return m_levels[l];
+    }
+
+    MultilevelEstimate MultilevelVolatilityTarget::estimate_call_price(
+        const double strike,
+        const double target_standard_error,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        return estimate(Quantity::CALL_PRICE, strike, target_standard_error, num_threads, seed);
+    }
+
+    MultilevelEstimate MultilevelVolatilityTarget::estimate_volatility(
+        const double target_standard_error,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        return estimate(Quantity::VOLATILITY, 0.0, target_standard_error, num_threads, seed);
+    }
+
+    void MultilevelVolatilityTarget::simulate_batch(
+        const size_t l,
+        const PathNormalGenerator& rng,
+        const size_t first_path,
+        double* fine,
+        double* coarse
+    ) const
+    {
+        const VolatilityTarget& vt = m_levels[l];
+        const double sqrt_half = std::sqrt(0.5);
+        double vars[BATCH_LANES];
+        double coarse_vars[BATCH_LANES];
+        double normals[BATCH_STEPS * BATCH_LANES];
+        double coarse_normals[BATCH_STEPS / 2 * BATCH_LANES];
+        std::fill(fine, fine + BATCH_LANES, vt.init_level());
+        std::fill(vars, vars + BATCH_LANES, vt.init_var());
+        if (coarse != nullptr)
+        {
+            std::fill(coarse, coarse + BATCH_LANES, vt.init_level());
+            std::fill(coarse_vars, coarse_vars + BATCH_LANES, vt.init_var());
+        }
+        for (size_t step = 0; step < vt.num_time_steps(); step += BATCH_STEPS)
+        {
+            const size_t num_steps = std::min(BATCH_STEPS, vt.num_time_steps() - step);
+            rng.generate_paths(first_path, BATCH_LANES, step, num_steps, normals);
+            vt.advance_vt_batch(fine, vars, normals, num_steps);
+            if (coarse == nullptr)
+                continue;
+            // num_steps is even, the fine grid having twice the steps of the coarse one.
+            for (size_t i = 0; i < num_steps / 2; ++i)
+            {
+                for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+                {
+                    const double z_1 = normals[2 * i * BATCH_LANES + lane];
+                    const double z_2 = normals[(2 * i + 1) * BATCH_LANES + lane];
+                    coarse_normals[i * BATCH_LANES + lane] = (z_1 + z_2) * sqrt_half;
+                }
+            }
+            m_levels[l - 1].advance_vt_batch(coarse, coarse_vars, coarse_normals, num_steps / 2);
+        }
+    }
+
+    void MultilevelVolatilityTarget::add_samples(
+        LevelSamples& samples,
+        const Quantity quantity,
+        const double strike,
+        const size_t l,
+        const bool coupled,
+        const size_t first_sample,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        const PathNormalGenerator rng(seed);
+        const size_t first_path = (l << LEVEL_PATH_SHIFT) + first_sample;
+        const VolatilityTarget& vt = m_levels[l];
+        const double discount_factor = std::exp(-vt.sde()->discount_rate() * vt.tenor());
+        auto functionals = [&](const double level, double& x, double& y) {
+            if (quantity == Quantity::CALL_PRICE)
+            {
+                x = discount_factor * std::max(level - strike, 0.0);
+                y = x;
+            }
+            else
+            {
+                x = std::log(level / vt.init_level());
+                y = x * x;
+            }
+        };
+        auto simulate_range = [&](const size_t begin, const size_t end, LevelSamples& partial) {
+            double fine[BATCH_LANES];
+            double coarse[BATCH_LANES];
+            for (size_t first = begin; first < end; first += BATCH_LANES)
+            {
+                simulate_batch(l, rng, first_path + first, fine, coupled ? coarse : nullptr);
+                const size_t num_lanes = std::min(BATCH_LANES, end - first);
+                for (size_t lane = 0; lane < num_lanes; ++lane)
+                {
+                    double x;
+                    double y;
+                    functionals(fine[lane], x, y);
+                    partial.fine.add(x, y);
+                    if (coupled)
+                    {
+                        double coarse_x;
+                        double coarse_y;
+                        functionals(coarse[lane], coarse_x, coarse_y);
+                        partial.corrections.add(x - coarse_x, y - coarse_y);
+                    }
+                }
+            }
+        };
+        std::vector<LevelSamples> partials(num_partial_ranges(num_samples));
+        simulate_partials(partials, num_samples, num_threads, simulate_range);
+        for (const LevelSamples& partial : partials)
+            samples.merge(partial);
+    }
+
+    MultilevelEstimate MultilevelVolatilityTarget::estimate(
+        const Quantity quantity,
+        const double strike,
+        const double target_standard_error,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        ASSERT(target_standard_error > 0.0, "target_standard_error must be positive");
+        const size_t num_levels = m_levels.size();
+        const double tenor = m_levels.back().tenor();
+        std::vector<LevelSamples> samples(num_levels);
+        std::vector<double> seconds(num_levels, 0.0);
+        MultilevelEstimate result;
+        result.cost = 0.0;
+
+        auto level_cost = [&](const size_t l, const bool coupled) {
+            return m_levels[l].num_time_steps() + (coupled ? m_levels[l - 1].num_time_steps() : 0);
+        };
+        auto simulate = [&](const size_t l, const bool coupled, const size_t num_samples) {
+            const auto start = std::chrono::steady_clock::now();
+            const size_t first_sample = samples[l].fine.count();
+            add_samples(samples[l], quantity, strike, l, coupled, first_sample, num_samples, num_threads, seed);
+            seconds[l] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.cost += double(num_samples) * level_cost(l, coupled);
+        };
+
+        // The quantity is g(E[x], E[y]), linearised as a E[x] + b E[y] to get the variances of the levels.
+        auto quantity_value = [&](const double mean_x, const double mean_y) {
+            if (quantity == Quantity::CALL_PRICE)
+                return mean_x;
+            return std::sqrt((mean_y - mean_x * mean_x) / tenor);
+        };
+        double a = 1.0;
+        double b = 0.0;
+        auto linearise = [&](const double mean_x, const double mean_y) {
+            if (quantity == Quantity::VOLATILITY)
+            {
+                const double vol = quantity_value(mean_x, mean_y);
+                a = -mean_x / (vol * tenor);
+                b = 0.5 / (vol * tenor);
+            }
+        };
+        auto mean = [&](const RunningCovariance& s) {
+            return a * s.mean_x() + b * s.mean_y();
+        };
+        auto variance = [&](const RunningCovariance& s) {
+            return a * a * s.variance_x() + 2.0 * a * b * s.covariance() + b * b * s.variance_y();
+        };
+
+        for (size_t l = 0; l < num_levels; ++l)
+            simulate(l, l > 0, SIMULATION_BLOCK_SIZE);
+
+        // Coarsest level to use, minimising the predicted cost (sum_l sqrt(V_l C_l))^2.
+        linearise(samples.back().fine.mean_x(), samples.back().fine.mean_y());
+        size_t base = 0;
+        double best_cost = INF;
+        for (size_t first = 0; first < num_levels; ++first)
+        {
+            double sum = std::sqrt(variance(samples[first].fine) * level_cost(first, false));
+            for (size_t l = first + 1; l < num_levels; ++l)
+                sum += std::sqrt(variance(samples[l].corrections) * level_cost(l, true));
+            if (sum * sum < best_cost)
+            {
+                best_cost = sum * sum;
+                base = first;
+            }
+        }
+
+        auto level_samples = [&](const size_t l) -> const RunningCovariance& {
+            return l == base ? samples[l].fine : samples[l].corrections;
+        };
+        double mean_x;
+        double mean_y;
+        while (true)
+        {
+            mean_x = 0.0;
+            mean_y = 0.0;
+            for (size_t l = base; l < num_levels; ++l)
+            {
+                mean_x += level_samples(l).mean_x();
+                mean_y += level_samples(l).mean_y();
+            }
+            linearise(mean_x, mean_y);
+
+            double sum = 0.0;
+            for (size_t l = base; l < num_levels; ++l)
+                sum += std::sqrt(variance(level_samples(l)) * level_cost(l, l > base));
+            bool done = true;
+            for (size_t l = base; l < num_levels; ++l)
+            {
+                const double ratio = std::sqrt(variance(level_samples(l)) / level_cost(l, l > base));
+                const size_t needed = size_t(std::ceil(ratio * sum / (target_standard_error * target_standard_error)));
+                if (needed > samples[l].fine.count())
+                {
+                    simulate(l, l > base, needed - samples[l].fine.count());
+                    done = false;
+                }
+            }
+            if (done)
+                break;
+        }
+
+        result.value = quantity_value(mean_x, mean_y);
+        double error_variance = 0.0;
+        for (size_t l = base; l < num_levels; ++l)
+        {
+            const RunningCovariance& s = level_samples(l);
+            MultilevelLevel level;
+            level.num_time_steps = m_levels[l].num_time_steps();
+            level.num_samples = s.count();
+            level.mean = mean(s);
+            level.variance = variance(s);
+            level.cost = level_cost(l, l > base);
+            level.seconds = seconds[l];
+            result.levels.push_back(level);
+            error_variance += level.variance / level.num_samples;
+        }
+        result.standard_error = std::sqrt(error_variance);
+        result.single_level_cost = variance(samples.back().fine) / error_variance * m_levels.back().num_time_steps();
+        result.seconds = 0.0;
+        for (const double s : seconds)
+            result.seconds += s;
+        return result;
+    }
+}
\ No newline at end of file
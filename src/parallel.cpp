@@ -0,0 +1,142 @@
+#include <parallel.hpp>
+#include <algorithm>
+
+namespace cltvt
+{
+    namespace
+    {
+        thread_local bool t_inside_pool = false;
+    }
+
+    size_t resolve_num_threads(const size_t num_threads)
+    {
+        if (num_threads > 0)
+            return num_threads;
+        const size_t hardware_threads = std::thread::hardware_concurrency();
+        return hardware_threads > 0 ? hardware_threads : 1;
+    }
+
+    size_t num_blocks(const size_t num_items, const size_t block_size)
+    {
+        ASSERT(block_size > 0, "block_size must be positive");
+        return (num_items + block_size - 1) / block_size;
+    }
+
+    ThreadPool& ThreadPool::instance()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    ThreadPool::ThreadPool()
+        :
+        m_generation(0),
+        m_job_threads(0),
+        m_pending(0),
+        m_stop(false),
+        m_invoker(nullptr),
+        m_task(nullptr),
+        m_num_tasks(0),
+        m_next_task(0)
+    {
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start_cv.notify_all();
+        for (std::thread& worker : m_workers)
+            worker.join();
+    }
+
+    void ThreadPool::run_tasks(const size_t num_tasks, const size_t num_threads, Invoker invoker, void* task)
+    {
+        const size_t threads_to_use = std::min(resolve_num_threads(num_threads), num_tasks);
+        if (threads_to_use <= 1 || t_inside_pool)
+        {
+            for (size_t i = 0; i < num_tasks; ++i)
+                invoker(task, i, 0);
+            return;
+        }
+
+        std::lock_guard<std::mutex> run_lock(m_run_mutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (m_workers.size() + 1 < threads_to_use)
+                m_workers.emplace_back(&ThreadPool::worker_loop, this, m_workers.size() + 1);
+            m_invoker = invoker;
+            m_task = task;
+            m_num_tasks = num_tasks;
+            m_next_task = 0;
+            m_error = nullptr;
+            m_job_threads = threads_to_use;
+            m_pending = threads_to_use - 1;
+            ++m_generation;
+        }
+        m_start_cv.notify_all();
+
+        t_inside_pool = true;
+        execute(0);
+        t_inside_pool = false;
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done_cv.wait(lock, [this] { return m_pending == 0; });
+            error = m_error;
+            m_error = nullptr;
+            m_invoker = nullptr;
+            m_task = nullptr;
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void ThreadPool::execute(const size_t thread_index)
+    {
+        for (;;)
+        {
+            const size_t task_index = m_next_task.fetch_add(1);
+            if (task_index >= m_num_tasks)
+                break;
+            try
+            {
+                m_invoker(m_task, task_index, thread_index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_error)
+                    m_error = std::current_exception();
+                m_next_task = m_num_tasks;
+            }
+        }
+    }
+
+    void ThreadPool::worker_loop(const size_t thread_index)
+    {
+        t_inside_pool = true;
+        size_t seen_generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start_cv.wait(lock, [&] {
+                    return m_stop || (m_generation != seen_generation && thread_index < m_job_threads);
+                });
+                if (m_stop)
+                    return;
+                seen_generation = m_generation;
+            }
+            execute(thread_index);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_pending == 0)
+                    m_done_cv.notify_one();
+            }
+        }
+    }
+}
\ No newline at end of file
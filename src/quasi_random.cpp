@@ -0,0 +1,206 @@
+#include <quasi_random.hpp>
+#include <dispatch.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace cltvt
+{
+    namespace
+    {
+        const size_t SOBOL_BITS = 32;
+
+        // Degree, coefficients and initial direction numbers of dimensions 2 to SobolGenerator::MAX_DIMENSION,
+        // from the new-joe-kuo-6.21201 table.
+        struct SobolPolynomial
+        {
+            size_t degree;
+            uint32_t coefficients;
+            uint32_t m[6];
+        };
+
+        const SobolPolynomial SOBOL_POLYNOMIALS[SobolGenerator::MAX_DIMENSION - 1] = {
+            { 1, 0, { 1 } },
+            { 2, 1, { 1, 3 } },
+            { 3, 1, { 1, 3, 1 } },
+            { 3, 2, { 1, 1, 1 } },
+            { 4, 1, { 1, 1, 3, 3 } },
+            { 4, 4, { 1, 3, 5, 13 } },
+            { 5, 2, { 1, 1, 5, 5, 17 } },
+            { 5, 4, { 1, 1, 5, 5, 5 } },
+            { 5, 7, { 1, 1, 7, 11, 19 } },
+            { 5, 11, { 1, 1, 5, 1, 1 } },
+            { 5, 13, { 1, 1, 1, 3, 11 } },
+            { 5, 14, { 1, 3, 5, 5, 31 } },
+            { 6, 1, { 1, 3, 3, 9, 7, 49 } },
+            { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+            { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+            { 6, 19, { 1, 1, 1, 15, 7, 5 } },
+            { 6, 22, { 1, 3, 1, 15, 13, 25 } },
+            { 6, 25, { 1, 1, 5, 5, 19, 61 } }
+        };
+    }
+
+    SobolGenerator::SobolGenerator(const size_t dimension, const bool shifted, const size_t seed, const size_t stream)
+        :
+        m_dimension(dimension),
+        m_index(0),
+        m_directions(dimension * SOBOL_BITS),
+        m_state(dimension, 0),
+        m_shift(dimension, 0)
+    {
+        ASSERT(dimension > 0 && dimension <= MAX_DIMENSION, "dimension must be in [1, MAX_DIMENSION]");
+
+        for (size_t k = 0; k < SOBOL_BITS; ++k)
+            m_directions[k] = uint32_t(1) << (SOBOL_BITS - 1 - k);
+        for (size_t d = 1; d < dimension; ++d)
+        {
+            const SobolPolynomial& p = SOBOL_POLYNOMIALS[d - 1];
+            uint32_t* v = &m_directions[d * SOBOL_BITS];
+            for (size_t k = 0; k < p.degree; ++k)
+                v[k] = p.m[k] << (SOBOL_BITS - 1 - k);
+            for (size_t k = p.degree; k < SOBOL_BITS; ++k)
+            {
+                v[k] = v[k - p.degree] ^ (v[k - p.degree] >> p.degree);
+                for (size_t i = 1; i < p.degree; ++i)
+                    if ((p.coefficients >> (p.degree - 1 - i)) & 1)
+                        v[k] ^= v[k - i];
+            }
+        }
+
+        if (shifted)
+        {
+            std::seed_seq seq{ uint32_t(seed), uint32_t(seed >> 32), uint32_t(stream), uint32_t(stream >> 32) };
+            std::mt19937_64 rng(seq);
+            for (size_t d = 0; d < dimension; ++d)
+                m_shift[d] = uint32_t(rng() >> 32);
+        }
+    }
+
+    size_t SobolGenerator::dimension() const
+    {
+        return m_dimension;
+    }
+
+    void SobolGenerator::next(double* out)
+    {
+        const double scale = 1.0 / 4294967296.0;
+        for (size_t d = 0; d < m_dimension; ++d)
+            out[d] = ((m_state[d] ^ m_shift[d]) + 0.5) * scale;
+
+        // Gray code order: the next point differs from this one by the direction of the lowest zero bit of the index.
+        size_t c = 0;
+        for (uint32_t i = m_index; i & 1; i >>= 1)
+            ++c;
+        ASSERT(c < SOBOL_BITS, "Sobol sequence exhausted");
+        for (size_t d = 0; d < m_dimension; ++d)
+            m_state[d] ^= m_directions[d * SOBOL_BITS + c];
+        ++m_index;
+    }
+
+    void SobolGenerator::next_normals(double* out)
+    {
+        next(out);
+        simd_kernels().inverse_normal_cdf(out, out, m_dimension);
+    }
+
+    BrownianBridge::BrownianBridge(const std::vector<double>& dtimes)
+        :
+        m_bridge_index(dtimes.size()),
+        m_left_index(dtimes.size()),
+        m_right_index(dtimes.size()),
+        m_left_weight(dtimes.size()),
+        m_right_weight(dtimes.size()),
+        m_std_dev(dtimes.size()),
+        m_sqrt_dtimes(dtimes.size())
+    {
+        const size_t n = dtimes.size();
+        ASSERT(n > 0, "dtimes must not be empty");
+
+        std::vector<double> times(n);
+        double t = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            ASSERT(dtimes[i] > 0.0, "dtimes must be positive");
+            t += dtimes[i];
+            times[i] = t;
+            m_sqrt_dtimes[i] = std::sqrt(dtimes[i]);
+        }
+
+        // Construction of Jaeckel (2002): filled[i] marks the points already set, each new point is the middle of the
+        // next gap and is conditioned on the points on both sides of the gap (left index 0 meaning W(0) = 0).
+        std::vector<bool> filled(n, false);
+        filled[n - 1] = true;
+        m_bridge_index[0] = n - 1;
+        m_std_dev[0] = std::sqrt(times[n - 1]);
+        size_t j = 0;
+        for (size_t i = 1; i < n; ++i)
+        {
+            while (filled[j])
+                ++j;
+            size_t k = j;
+            while (!filled[k])
+                ++k;
+            const size_t l = j + ((k - 1 - j) >> 1);
+            filled[l] = true;
+            m_bridge_index[i] = l;
+            m_left_index[i] = j;
+            m_right_index[i] = k;
+            const double t_left = j > 0 ? times[j - 1] : 0.0;
+            m_left_weight[i] = (times[k] - times[l]) / (times[k] - t_left);
+            m_right_weight[i] = (times[l] - t_left) / (times[k] - t_left);
+            m_std_dev[i] = std::sqrt((times[l] - t_left) * (times[k] - times[l]) / (times[k] - t_left));
+            j = k + 1;
+            if (j >= n)
+                j = 0;
+        }
+    }
+
+    size_t BrownianBridge::size() const
+    {
+        return m_bridge_index.size();
+    }
+
+    void BrownianBridge::transform(const double* normals, double* out) const
+    {
+        const size_t n = size();
+        out[n - 1] = m_std_dev[0] * normals[0];
+        for (size_t i = 1; i < n; ++i)
+        {
+            const size_t j = m_left_index[i];
+            const size_t k = m_right_index[i];
+            const size_t l = m_bridge_index[i];
+            const double left = j > 0 ? m_left_weight[i] * out[j - 1] : 0.0;
+            out[l] = left + m_right_weight[i] * out[k] + m_std_dev[i] * normals[i];
+        }
+        for (size_t i = n - 1; i > 0; --i)
+            out[i] = (out[i] - out[i - 1]) / m_sqrt_dtimes[i];
+        out[0] /= m_sqrt_dtimes[0];
+    }
+
+    SobolPathGenerator::SobolPathGenerator(const std::vector<double>& dtimes, const size_t seed, const size_t replication)
+        :
+        m_bridge(dtimes),
+        m_sobol(std::min(dtimes.size(), SobolGenerator::MAX_DIMENSION), true, seed, replication),
+        m_padding(seed),
+        m_padding_path((replication + 1) << PADDING_PATH_BITS),
+        m_normals(dtimes.size()),
+        m_path(dtimes.size())
+    {
+    }
+
+    size_t SobolPathGenerator::size() const
+    {
+        return m_bridge.size();
+    }
+
+    const double* SobolPathGenerator::next_path()
+    {
+        const size_t dimension = m_sobol.dimension();
+        m_sobol.next_normals(m_normals.data());
+        if (size() > dimension)
+            m_padding.generate(m_padding_path, dimension, m_normals.data() + dimension, size() - dimension);
+        ++m_padding_path;
+        m_bridge.transform(m_normals.data(), m_path.data());
+        return m_path.data();
+    }
+}
\ No newline at end of file
@@ -1,18 +1,252 @@
-#include <random_number_generator.hpp>
-
-namespace cltvt
-{
-    StandardNormalGenerator::StandardNormalGenerator(const size_t seed) : m_seed(seed)
-    {
-        m_rng = std::mt19937_64(m_seed);
-        m_dist = std::normal_distribution<double>(0.0, 1.0);
-    }
-
-    void StandardNormalGenerator::populate_standard_normals(std::vector<double>& rn_out, const size_t size)
-    {
-        rn_out.resize(0);
-        rn_out.reserve(size);
-        for (size_t i = 0; i < size; ++i)
-            rn_out.push_back(m_dist(m_rng));
-    }
+#include <random_number_generator.hpp>
+#include <simd.hpp>
+#include <dispatch.hpp>
+#include <algorithm>
+
+namespace cltvt
+{
+    namespace
+    {
+        const size_t UNIFORM_CHUNK = 32 * StandardNormalGenerator::LANES;
+
+        uint64_t splitmix64(uint64_t& state)
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        inline uint64_t rotl(const uint64_t x, const int k)
+        {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        const size_t PHILOX_LANES = 8;
+        const uint32_t PHILOX_M0 = 0xD2511F53;
+        const uint32_t PHILOX_M1 = 0xCD9E8D57;
+        const uint32_t PHILOX_W0 = 0x9E3779B9;
+        const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+        // x[0..3][j] holds the j-th counter on input and its Philox4x32-10 output on return.
+        template <size_t N>
+        void philox(uint32_t (&x)[4][N], const uint64_t key)
+        {
+            uint32_t k0 = uint32_t(key);
+            uint32_t k1 = uint32_t(key >> 32);
+            for (size_t round = 0; round < 10; ++round)
+            {
+                for (size_t j = 0; j < N; ++j)
+                {
+                    const uint64_t p0 = uint64_t(PHILOX_M0) * x[0][j];
+                    const uint64_t p1 = uint64_t(PHILOX_M1) * x[2][j];
+                    x[0][j] = uint32_t(p1 >> 32) ^ x[1][j] ^ k0;
+                    x[2][j] = uint32_t(p0 >> 32) ^ x[3][j] ^ k1;
+                    x[1][j] = uint32_t(p1);
+                    x[3][j] = uint32_t(p0);
+                }
+                k0 += PHILOX_W0;
+                k1 += PHILOX_W1;
+            }
+        }
+
+        template <size_t N>
+        inline void set_counter(uint32_t (&x)[4][N], const size_t j, const uint64_t pair, const uint64_t path)
+        {
+            x[0][j] = uint32_t(pair);
+            x[1][j] = uint32_t(pair >> 32);
+            x[2][j] = uint32_t(path);
+            x[3][j] = uint32_t(path >> 32);
+        }
+
+        // Random bits of step 2 * pair + half, where pair is the j-th counter.
+        template <size_t N>
+        inline uint64_t philox_bits(const uint32_t (&x)[4][N], const size_t j, const size_t half)
+        {
+            return uint64_t(x[2 * half][j]) | (uint64_t(x[2 * half + 1][j]) << 32);
+        }
+    }
+
+    StandardNormalGenerator::StandardNormalGenerator(const size_t seed, const size_t stream, const NormalMethod method)
+        :
+        m_method(method)
+    {
+        m_dist = std::normal_distribution<double>(0.0, 1.0);
+        this->seed(seed, stream);
+    }
+
+    void StandardNormalGenerator::seed(const size_t seed, const size_t stream)
+    {
+        const uint64_t s = seed;
+        const uint64_t k = stream;
+        if (stream == 0)
+        {
+            m_rng.seed(seed);
+        }
+        else
+        {
+            std::seed_seq seq{ uint32_t(s), uint32_t(s >> 32), uint32_t(k), uint32_t(k >> 32) };
+            m_rng.seed(seq);
+        }
+        m_dist.reset();
+
+        uint64_t key = k;
+        uint64_t state = s ^ splitmix64(key);
+        for (size_t j = 0; j < 4; ++j)
+            for (size_t lane = 0; lane < LANES; ++lane)
+                m_lanes[j][lane] = splitmix64(state);
+        m_round_pos = LANES;
+
+        m_seed = seed;
+        m_stream = stream;
+    }
+
+    void StandardNormalGenerator::next_round(uint64_t* out)
+    {
+        uint64_t* s0 = m_lanes[0];
+        uint64_t* s1 = m_lanes[1];
+        uint64_t* s2 = m_lanes[2];
+        uint64_t* s3 = m_lanes[3];
+        for (size_t lane = 0; lane < LANES; ++lane)
+        {
+            const uint64_t x = s1[lane] * 5;
+            out[lane] = rotl(x, 7) * 9;
+            const uint64_t t = s1[lane] << 17;
+            s2[lane] ^= s0[lane];
+            s3[lane] ^= s1[lane];
+            s1[lane] ^= s2[lane];
+            s0[lane] ^= s3[lane];
+            s2[lane] ^= t;
+            s3[lane] = rotl(s3[lane], 45);
+        }
+    }
+
+    uint64_t StandardNormalGenerator::next_bits()
+    {
+        if (m_round_pos == LANES)
+        {
+            next_round(m_round);
+            m_round_pos = 0;
+        }
+        return m_round[m_round_pos++];
+    }
+
+    double StandardNormalGenerator::next()
+    {
+        if (m_method == NormalMethod::REFERENCE)
+            return m_dist(m_rng);
+        const uint64_t bits = next_bits();
+        return simd::inverse_normal_cdf(simd::Vec1::load_uniform(&bits)).v;
+    }
+
+    void StandardNormalGenerator::generate(double* out, const size_t size)
+    {
+        if (m_method == NormalMethod::REFERENCE)
+        {
+            for (size_t i = 0; i < size; ++i)
+                out[i] = m_dist(m_rng);
+            return;
+        }
+
+        uint64_t bits[UNIFORM_CHUNK];
+        for (size_t first = 0; first < size; first += UNIFORM_CHUNK)
+        {
+            const size_t n = std::min(UNIFORM_CHUNK, size - first);
+            size_t k = 0;
+            while (k < n && m_round_pos < LANES)
+                bits[k++] = m_round[m_round_pos++];
+            for (; k + LANES <= n; k += LANES)
+                next_round(bits + k);
+            while (k < n)
+                bits[k++] = next_bits();
+            simd_kernels().normals_from_bits(bits, out + first, n);
+        }
+    }
+
+    void StandardNormalGenerator::populate_standard_normals(std::vector<double>& rn_out, const size_t size)
+    {
+        rn_out.resize(size);
+        generate(rn_out.data(), size);
+    }
+
+    PathNormalGenerator::PathNormalGenerator(const size_t seed)
+        :
+        m_seed(seed)
+    {
+    }
+
+    double PathNormalGenerator::normal(const size_t path, const size_t step) const
+    {
+        uint32_t x[4][1];
+        set_counter(x, 0, step / 2, path);
+        philox(x, m_seed);
+        const uint64_t bits = philox_bits(x, 0, step % 2);
+        return simd::inverse_normal_cdf(simd::Vec1::load_uniform(&bits)).v;
+    }
+
+    void PathNormalGenerator::generate(const size_t path, const size_t first_step, double* out, const size_t num_steps) const
+    {
+        uint64_t bits[UNIFORM_CHUNK + 2 * PHILOX_LANES];
+        uint32_t x[4][PHILOX_LANES];
+        for (size_t first = 0; first < num_steps; first += UNIFORM_CHUNK)
+        {
+            const size_t n = std::min(UNIFORM_CHUNK, num_steps - first);
+            const size_t begin = first_step + first;
+            for (size_t k = 0; 2 * k < begin % 2 + n; k += PHILOX_LANES)
+            {
+                for (size_t j = 0; j < PHILOX_LANES; ++j)
+                    set_counter(x, j, begin / 2 + k + j, path);
+                philox(x, m_seed);
+                for (size_t j = 0; j < PHILOX_LANES; ++j)
+                {
+                    bits[2 * (k + j)] = philox_bits(x, j, 0);
+                    bits[2 * (k + j) + 1] = philox_bits(x, j, 1);
+                }
+            }
+            simd_kernels().normals_from_bits(bits + begin % 2, out + first, n);
+        }
+    }
+
+    void PathNormalGenerator::generate_paths(
+        const size_t first_path,
+        const size_t num_paths,
+        const size_t first_step,
+        const size_t num_steps,
+        double* out
+    ) const
+    {
+        const size_t tile_steps = UNIFORM_CHUNK / PHILOX_LANES;
+        uint64_t bits[UNIFORM_CHUNK + 2 * PHILOX_LANES];
+        double tile[UNIFORM_CHUNK];
+        uint32_t x[4][PHILOX_LANES];
+        for (size_t lane = 0; lane < num_paths; lane += PHILOX_LANES)
+        {
+            const size_t num_lanes = std::min(PHILOX_LANES, num_paths - lane);
+            for (size_t first = 0; first < num_steps; first += tile_steps)
+            {
+                const size_t n = std::min(tile_steps, num_steps - first);
+                const size_t begin = first_step + first;
+                for (size_t k = 0; 2 * k < begin % 2 + n; ++k)
+                {
+                    for (size_t j = 0; j < PHILOX_LANES; ++j)
+                        set_counter(x, j, begin / 2 + k, first_path + lane + j);
+                    philox(x, m_seed);
+                    for (size_t j = 0; j < PHILOX_LANES; ++j)
+                    {
+                        bits[2 * k * PHILOX_LANES + j] = philox_bits(x, j, 0);
+                        bits[(2 * k + 1) * PHILOX_LANES + j] = philox_bits(x, j, 1);
+                    }
+                }
+                simd_kernels().normals_from_bits(bits + begin % 2 * PHILOX_LANES, tile, n * PHILOX_LANES);
+                for (size_t i = 0; i < n; ++i)
+                    std::copy(tile + i * PHILOX_LANES, tile + i * PHILOX_LANES + num_lanes, out + (first + i) * num_paths + lane);
+            }
+        }
+    }
+
+    void PathNormalGenerator::populate_standard_normals(std::vector<double>& rn_out, const size_t path, const size_t size) const
+    {
+        rn_out.resize(size);
+        generate(path, 0, rn_out.data(), size);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+// Compiled with AVX2 enabled (/arch:AVX2, -mavx2) and FMA contraction disabled, see simd_kernels.hpp and simd.hpp.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+#define CLTVT_SIMD_NAMESPACE avx2
+#include <simd_kernels.hpp>
+
+namespace cltvt
+{
+#if defined(__AVX2__)
+    const SimdKernels* avx2_kernels()
+    {
+        static const SimdKernels kernels = make_simd_kernels<simd::Vec4>(SimdIsa::AVX2);
+        return &kernels;
+    }
+#else
+    const SimdKernels* avx2_kernels()
+    {
+        return nullptr;
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+// Compiled with AVX-512 enabled (/arch:AVX512, -mavx512f) and FMA contraction disabled, see simd_kernels.hpp and
+// simd.hpp.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+#define CLTVT_SIMD_NAMESPACE avx512
+#include <simd_kernels.hpp>
+
+namespace cltvt
+{
+#if defined(__AVX512F__)
+    const SimdKernels* avx512_kernels()
+    {
+        static const SimdKernels kernels = make_simd_kernels<simd::Vec8>(SimdIsa::AVX512);
+        return &kernels;
+    }
+#else
+    const SimdKernels* avx512_kernels()
+    {
+        return nullptr;
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+// FMA contraction is disabled as in the other variants, see simd.hpp.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+#define CLTVT_SIMD_NAMESPACE scalar
+#include <simd_kernels.hpp>
+
+namespace cltvt
+{
+    const SimdKernels& scalar_kernels()
+    {
+        static const SimdKernels kernels = make_simd_kernels<simd::Vec1>(SimdIsa::SCALAR);
+        return kernels;
+    }
+}
\ No newline at end of file
@@ -1,37 +1,110 @@
-#include <preliminaries.hpp>
-#include <special_functions.hpp>
-#include <cmath>
-
-namespace cltvt
-{
-    double normal_cdf(const double x)
-    {
-        return 0.5 * (1.0 + std::erf(x / std::sqrt(2)));
-    }
-
-    double q_pochhammer(const double a, const double q, const int n)
-    {
-        ASSERT(std::abs(q) < 1, "abs(q) < 1 must be true");
-
-        if (std::abs(a) < 1e-12)
-            return 1.0;
-
-        int n_to_use = n;
-        if (n < 0)
-        {
-            const double eps = 1e-8;
-            const double abs_q = std::abs(q);
-            const double nd = std::log(0.5 * eps * (1.0 - abs_q) / std::abs(a)) / std::log(abs_q);
-            n_to_use = (int)std::ceil(nd);
-        }
-
-        double s = 0.0;
-        double qk = 1.0;
-        for (int k = 0; k < n_to_use; ++k)
-        {
-            s += std::log(1.0 - a * qk);
-            qk *= q;
-        }
-        return std::exp(s);
-    }
+#include <preliminaries.hpp>
+#include <special_functions.hpp>
+#include <simd.hpp>
+#include <dispatch.hpp>
+#include <cmath>
+
+namespace cltvt
+{
+    double normal_cdf(const double x)
+    {
+        return 0.5 * std::erfc(-x / std::sqrt(2));
+    }
+
+    double inverse_normal_cdf(const double p)
+    {
+        ASSERT(p > 0.0 && p < 1.0, "0 < p < 1 must be true");
+        return simd::inverse_normal_cdf(simd::Vec1(p)).v;
+    }
+
+    double q_pochhammer(const double a, const double q, const int n)
+    {
+        ASSERT(std::abs(q) < 1, "abs(q) < 1 must be true");
+
+        if (std::abs(a) < 1e-12)
+            return 1.0;
+
+        int n_to_use = n;
+        if (n < 0)
+        {
+            const double eps = 1e-8;
+            const double abs_q = std::abs(q);
+            const double nd = std::log(0.5 * eps * (1.0 - abs_q) / std::abs(a)) / std::log(abs_q);
+            n_to_use = (int)std::ceil(nd);
+        }
+
+        double s = 0.0;
+        double qk = 1.0;
+        for (int k = 0; k < n_to_use; ++k)
+        {
+            s += std::log(1.0 - a * qk);
+            qk *= q;
+        }
+        return std::exp(s);
+    }
+
+    QPochhammer::QPochhammer(const double q)
+        :
+        m_q(q),
+        m_log_q(std::log(q))
+    {
+        ASSERT(q > 0.0 && q < 1.0, "0 < q < 1 must be true");
+
+        const size_t min_direct = (size_t)std::ceil(std::log(4.0) / -m_log_q);
+        const size_t num_direct = (min_direct + BLOCK - 1) / BLOCK * BLOCK;
+        m_powers.resize(num_direct);
+        double qj = 1.0;
+        for (size_t j = 0; j < num_direct; ++j)
+        {
+            m_powers[j] = qj;
+            qj *= q;
+        }
+
+        // The series are only evaluated at |x| <= 1/2.
+        double qm = q;
+        double half_m = 0.5;
+        for (size_t m = 1; ; ++m)
+        {
+            const double coeff = 1.0 / (m * (1.0 - qm));
+            m_coeffs.push_back(coeff);
+            if (coeff * half_m < 1e-17)
+                break;
+            qm *= q;
+            half_m *= 0.5;
+        }
+    }
+
+    double QPochhammer::q() const
+    {
+        return m_q;
+    }
+
+    double QPochhammer::operator()(const double a) const
+    {
+        double out;
+        evaluate(&a, &out, 1);
+        return out;
+    }
+
+    double QPochhammer::log_value(const double a) const
+    {
+        double out;
+        evaluate_log(&a, &out, 1);
+        return out;
+    }
+
+    void QPochhammer::evaluate_log(const double* a, double* out, const size_t size) const
+    {
+        for (size_t i = 0; i < size; ++i)
+            ASSERT(a[i] < 1.0, "a < 1 must be true");
+        simd_kernels().q_pochhammer_log(
+            a, out, size, m_q, m_log_q, m_powers.data(), m_powers.size(), m_coeffs.data(), m_coeffs.size()
+        );
+    }
+
+    void QPochhammer::evaluate(const double* a, double* out, const size_t size) const
+    {
+        evaluate_log(a, out, size);
+        simd_kernels().exp(out, out, size);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include <statistics.hpp>
+#include <cmath>
+#include <typeinfo>
+
+namespace cltvt
+{
+    RunningStatistics::RunningStatistics()
+        :
+        m_count(0),
+        m_mean(0.0),
+        m_m2(0.0)
+    {
+    }
+
+    void RunningStatistics::add(const double x)
+    {
+        ++m_count;
+        const double delta = x - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (x - m_mean);
+    }
+
+    void RunningStatistics::merge(const RunningStatistics& other)
+    {
+        if (other.m_count == 0)
+            return;
+        const size_t count = m_count + other.m_count;
+        const double delta = other.m_mean - m_mean;
+        const double weight = double(other.m_count) / count;
+        m_mean += delta * weight;
+        m_m2 += other.m_m2 + delta * delta * m_count * weight;
+        m_count = count;
+    }
+
+    void RunningStatistics::reset()
+    {
+        m_count = 0;
+        m_mean = 0.0;
+        m_m2 = 0.0;
+    }
+
+    size_t RunningStatistics::count() const
+    {
+        return m_count;
+    }
+
+    double RunningStatistics::mean() const
+    {
+        return m_count > 0 ? m_mean : std::nan("");
+    }
+
+    double RunningStatistics::variance() const
+    {
+        return m_count > 1 ? m_m2 / (m_count - 1) : std::nan("");
+    }
+
+    double RunningStatistics::std_dev() const
+    {
+        return std::sqrt(variance());
+    }
+
+    double RunningStatistics::standard_error() const
+    {
+        return std::sqrt(variance() / m_count);
+    }
+
+    RunningCovariance::RunningCovariance()
+        :
+        m_count(0),
+        m_mean_x(0.0),
+        m_mean_y(0.0),
+        m_m2_x(0.0),
+        m_m2_y(0.0),
+        m_cross(0.0)
+    {
+    }
+
+    void RunningCovariance::add(const double x, const double y)
+    {
+        ++m_count;
+        const double delta_x = x - m_mean_x;
+        const double delta_y = y - m_mean_y;
+        m_mean_x += delta_x / m_count;
+        m_mean_y += delta_y / m_count;
+        m_m2_x += delta_x * (x - m_mean_x);
+        m_m2_y += delta_y * (y - m_mean_y);
+        m_cross += delta_x * (y - m_mean_y);
+    }
+
+    void RunningCovariance::merge(const RunningCovariance& other)
+    {
+        if (other.m_count == 0)
+            return;
+        const size_t count = m_count + other.m_count;
+        const double delta_x = other.m_mean_x - m_mean_x;
+        const double delta_y = other.m_mean_y - m_mean_y;
+        const double weight = double(other.m_count) / count;
+        m_mean_x += delta_x * weight;
+        m_mean_y += delta_y * weight;
+        m_m2_x += other.m_m2_x + delta_x * delta_x * m_count * weight;
+        m_m2_y += other.m_m2_y + delta_y * delta_y * m_count * weight;
+        m_cross += other.m_cross + delta_x * delta_y * m_count * weight;
+        m_count = count;
+    }
+
+    void RunningCovariance::reset()
+    {
+        m_count = 0;
+        m_mean_x = 0.0;
+        m_mean_y = 0.0;
+        m_m2_x = 0.0;
+        m_m2_y = 0.0;
+        m_cross = 0.0;
+    }
+
+    size_t RunningCovariance::count() const
+    {
+        return m_count;
+    }
+
+    double RunningCovariance::mean_x() const
+    {
+        return m_count > 0 ? m_mean_x : std::nan("");
+    }
+
+    double RunningCovariance::mean_y() const
+    {
+        return m_count > 0 ? m_mean_y : std::nan("");
+    }
+
+    double RunningCovariance::variance_x() const
+    {
+        return m_count > 1 ? m_m2_x / (m_count - 1) : std::nan("");
+    }
+
+    double RunningCovariance::variance_y() const
+    {
+        return m_count > 1 ? m_m2_y / (m_count - 1) : std::nan("");
+    }
+
+    double RunningCovariance::covariance() const
+    {
+        return m_count > 1 ? m_cross / (m_count - 1) : std::nan("");
+    }
+
+    void StatisticsAccumulator::add(const double level)
+    {
+        m_stats.add(value(level));
+    }
+
+    void StatisticsAccumulator::merge(const Accumulator& other)
+    {
+        ASSERT(typeid(other) == typeid(*this), "can only merge accumulators of the same type");
+        m_stats.merge(static_cast<const StatisticsAccumulator&>(other).m_stats);
+    }
+
+    void StatisticsAccumulator::reset()
+    {
+        m_stats.reset();
+    }
+
+    const RunningStatistics& StatisticsAccumulator::statistics() const
+    {
+        return m_stats;
+    }
+
+    AccumulatorPtr LevelStatistics::clone() const
+    {
+        return std::make_shared<LevelStatistics>();
+    }
+
+    double LevelStatistics::value(const double level) const
+    {
+        return level;
+    }
+
+    LogLevelStatistics::LogLevelStatistics(const double init_level)
+        :
+        m_init_level(init_level)
+    {
+        ASSERT(m_init_level > 0.0, "init_level must be positive");
+    }
+
+    AccumulatorPtr LogLevelStatistics::clone() const
+    {
+        return std::make_shared<LogLevelStatistics>(m_init_level);
+    }
+
+    double LogLevelStatistics::value(const double level) const
+    {
+        return std::log(level / m_init_level);
+    }
+
+    CallPayoffStatistics::CallPayoffStatistics(const double strike, const double discount_factor)
+        :
+        m_strike(strike),
+        m_discount_factor(discount_factor)
+    {
+    }
+
+    AccumulatorPtr CallPayoffStatistics::clone() const
+    {
+        return std::make_shared<CallPayoffStatistics>(m_strike, m_discount_factor);
+    }
+
+    double CallPayoffStatistics::value(const double level) const
+    {
+        return m_discount_factor * std::max(level - m_strike, 0.0);
+    }
+
+    size_t num_partial_ranges(const size_t num_samples)
+    {
+        return std::min(num_blocks(num_samples), MAX_PARTIAL_ACCUMULATORS);
+    }
+}
\ No newline at end of file
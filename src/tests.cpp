@@ -1,538 +1,1850 @@
-#include <tests.hpp>
-#include <volatility_target.hpp>
-#include <special_functions.hpp>
-#include <integration.hpp>
-#include <algorithm>
-#include <fstream>
-
-namespace cltvt
-{
-    double sample_mean(const std::vector<double>& vec)
-    {
-        if (vec.empty())
-            return 0.0;
-
-        double s = 0.0;
-        for (double x : vec)
-            s += x;
-        return s / vec.size();
-    }
-
-    double sample_std(const std::vector<double>& vec)
-    {
-        if (vec.empty())
-            return std::nan("");
-
-        const double m = sample_mean(vec);
-        double s = 0.0;
-        for (double x : vec)
-            s += x * x;
-        return std::sqrt(s / vec.size() - m * m);
-    }
-
-    double multiplier_U(const double lambda)
-    {
-        auto f = [lambda](const double t) {
-            return 1.0 / std::sqrt(q_pochhammer(-t * t, lambda));
-        };
-
-        return std::sqrt(2.0 / PI / (1.0 - lambda)) * integrate(f, 0.0, 20.0);
-    }
-
-    double multiplier_V(const double lambda)
-    {
-        auto f = [lambda](const double t) {
-            return 1.0 / std::sqrt(q_pochhammer(-t, lambda));
-        };
-
-        return 0.5 / (1.0 - lambda) * integrate(f, 0.0, 20.0);
-    }
-
-    #define BEGIN_TEST(test_name) std::cout << "Running " + std::string(test_name) + "..." << std::endl;
-    #define END_TEST(test_name) std::cout << "Test results saved to tests/" + std::string(test_name) + ".csv\n" << std::endl;
-
-    void test_multiplier_U_bounds()
-    {
-        BEGIN_TEST("test_multiplier_U_bounds");
-
-        std::vector<double> lamb_vec;
-        double lamb = 0.7;
-        while (lamb < 1.0)
-        {
-            lamb_vec.push_back(lamb);
-            lamb += 0.02;
-        }
-
-        std::vector<double> vals;
-        std::vector<double> upper_bounds;
-        std::vector<double> lower_bounds;
-        for (const double lamb : lamb_vec)
-        {
-            const double val = multiplier_U(lamb);
-            const double one_by_lamb = 1.0 / lamb;
-            const double upper_bound = std::sqrt(std::pow(one_by_lamb, 1.25) * std::log(one_by_lamb) / (one_by_lamb - 1.0))
-                / (1.0 - std::exp(-2.0 * PI * PI / std::log(one_by_lamb)));
-            const double lower_bound = std::sqrt(std::pow(one_by_lamb, 1.2) * std::log(one_by_lamb) / (one_by_lamb - 1.0));
-            vals.push_back(val);
-            upper_bounds.push_back(upper_bound);
-            lower_bounds.push_back(lower_bound);
-            std::cout << "lambda=" << lamb << ", U=" << val << ", upper_bound=" << upper_bound << ", lower_bound=" << lower_bound << std::endl;
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_multiplier_U_bounds.csv");
-        outfile << "lambda,U,upper_bound,lower_bound\n";
-        for (size_t i = 0; i < lamb_vec.size(); ++i)
-        {
-            outfile << lamb_vec[i] << "," << vals[i] << "," << upper_bounds[i] << "," << lower_bounds[i] << "\n";
-        }
-        outfile.close();
-
-        END_TEST("test_multiplier_U_bounds");
-    }
-
-    void test_multiplier_V_bounds()
-    {
-        BEGIN_TEST("test_multiplier_V_bounds");
-
-        std::vector<double> lamb_vec;
-        double lamb = 0.7;
-        while (lamb < 1.0)
-        {
-            lamb_vec.push_back(lamb);
-            lamb += 0.02;
-        }
-
-        std::vector<double> vals;
-        std::vector<double> upper_bounds;
-        std::vector<double> lower_bounds;
-        for (const double lamb : lamb_vec)
-        {
-            const double val = multiplier_V(lamb);
-            const double one_by_lamb = 1.0 / lamb;
-            const double upper_bound = std::pow(one_by_lamb, 1.5) * std::log(one_by_lamb) / (one_by_lamb - 1.0);
-            const double lower_bound = std::pow(one_by_lamb, 1.45) * std::log(one_by_lamb) / (one_by_lamb - 1.0);
-            vals.push_back(val);
-            upper_bounds.push_back(upper_bound);
-            lower_bounds.push_back(lower_bound);
-            std::cout << "lambda=" << lamb << ", V=" << val << ", upper_bound=" << upper_bound << ", lower_bound=" << lower_bound << std::endl;
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_multiplier_V_bounds.csv");
-        outfile << "lambda,V,upper_bound,lower_bound\n";
-        for (size_t i = 0; i < lamb_vec.size(); ++i)
-        {
-            outfile << lamb_vec[i] << "," << vals[i] << "," << upper_bounds[i] << "," << lower_bounds[i] << "\n";
-        }
-        outfile.close();
-
-        END_TEST("test_multiplier_V_bounds");
-    }
-
-    void test_vt_volatility(const size_t num_samples)
-    {
-        BEGIN_TEST("test_vt_volatility");
-
-        const double discount_rate = 0.05;
-        const double rho = 0.03;
-        const double volatility = 0.5;
-        const double target_volatility = 0.2;
-        const double tenor = 1.0;
-        const double init_var = 0.02;
-        const double init_stock_level = 1.0;
-        const double init_vt_level = 1.0;
-        const double repo_rate = discount_rate - rho;
-
-        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
-        std::vector<double> lamb_vec;
-        double lamb = 0.7;
-        while (lamb < 1.0)
-        {
-            lamb_vec.push_back(lamb);
-            lamb += 0.05;
-        }
-        if (lamb_vec.back() < 0.97)
-            lamb_vec.push_back(0.97);
-
-        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
-        std::vector<std::vector<double>> vt_vol_array(0);
-        std::vector<std::vector<double>> limit_vol_array(0);
-        vt_vol_array.reserve(num_time_steps.size());
-        limit_vol_array.reserve(num_time_steps.size());
-        std::vector<double> log_vt_levels;
-        for (const size_t num_steps : num_time_steps)
-        {
-            std::vector<double> vols;
-            std::vector<double> limit_vols;
-            vols.reserve(lamb_vec.size());
-            limit_vols.reserve(lamb_vec.size());
-            for (const double lamb : lamb_vec)
-            {
-                VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
-                vt.simulate_vt_levels(log_vt_levels, num_samples);
-                for (std::vector<double>::iterator itv = log_vt_levels.begin(); itv != log_vt_levels.end(); ++itv)
-                    *itv = std::log(*itv / vt.init_level());
-                const double vol = sample_std(log_vt_levels) / std::sqrt(tenor);
-                const double limit_vol = target_volatility * std::sqrt(multiplier_V(lamb));
-                vols.push_back(vol);
-                limit_vols.push_back(limit_vol);
-                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", vt_vol=" << vol << ", limit_vol=" << limit_vol << std::endl;
-            }
-            vt_vol_array.push_back(vols);
-            limit_vol_array.push_back(limit_vols);
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_vt_volatility.csv");
-        outfile << "N,lambda,vt_vol,limit_vol\n";
-        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
-        {
-            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
-            {
-                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," 
-                    << vt_vol_array[i_num_step][i_lamb] << "," << limit_vol_array[i_num_step][i_lamb] << "\n";
-            }
-        }
-        outfile.close();
-
-        END_TEST("test_vt_volatility");
-    }
-
-    void test_vt_volatility_simultaneous_limit(const size_t num_samples)
-    {
-        BEGIN_TEST("test_vt_volatility_simultaneous_limit");
-
-        const double discount_rate = 0.05;
-        const double rho = 0.03;
-        const double volatility = 0.5;
-        const double target_volatility = 0.2;
-        const double tenor = 1.0;
-        const double init_var = volatility * volatility;
-        const double init_stock_level = 1.0;
-        const double init_vt_level = 1.0;
-        const double repo_rate = discount_rate - rho;
-
-        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
-        std::vector<double> lamb_vec;
-        double lamb = 0.7;
-        while (lamb < 1.0)
-        {
-            lamb_vec.push_back(lamb);
-            lamb += 0.05;
-        }
-        if (lamb_vec.back() < 0.97)
-            lamb_vec.push_back(0.97);
-        if (lamb_vec.back() < 0.99)
-            lamb_vec.push_back(0.99);
-
-        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
-        std::vector<std::vector<double>> vt_vol_array(0);
-        vt_vol_array.reserve(num_time_steps.size());
-        std::vector<double> log_vt_levels;
-        for (const size_t num_steps : num_time_steps)
-        {
-            std::vector<double> vols;
-            std::vector<double> lim_vols;
-            vols.reserve(lamb_vec.size());
-            for (const double lamb : lamb_vec)
-            {
-                VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
-                vt.simulate_vt_levels(log_vt_levels, num_samples);
-                for (std::vector<double>::iterator itv = log_vt_levels.begin(); itv != log_vt_levels.end(); ++itv)
-                    *itv = std::log(*itv / vt.init_level());
-                const double vol = sample_std(log_vt_levels) / std::sqrt(tenor);
-                vols.push_back(vol);
-                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", vt_vol=" << vol << ", target_vol=" << target_volatility << std::endl;
-            }
-            vt_vol_array.push_back(vols);
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_vt_volatility_simultaneous_limit.csv");
-        outfile << "N,lambda,vt_vol,target_vol\n";
-        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
-        {
-            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
-            {
-                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << ","
-                    << vt_vol_array[i_num_step][i_lamb] << "," << target_volatility << "\n";
-            }
-        }
-        outfile.close();
-
-        END_TEST("test_vt_volatility_simultaneous_limit");
-    }
-
-    void test_vt_volatility_limit_along_path_1(const size_t num_samples)
-    {
-        BEGIN_TEST("test_vt_volatility_limit_along_path_1");
-
-        const double discount_rate = 0.05;
-        const double rho = 0.03;
-        const double volatility = 0.5;
-        const double target_volatility = 0.2;
-        const double tenor = 1.0;
-        const double init_var = 0.02;
-        const double init_stock_level = 1.0;
-        const double init_vt_level = 1.0;
-        const double repo_rate = discount_rate - rho;
-        const double kappa = 1.0;
-
-        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
-        std::vector<double> lamb_vec;
-        for (const size_t num_steps : num_time_steps)
-            lamb_vec.push_back(1.0 - 1.0 / (num_steps * num_steps));
-
-        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
-        std::vector<double> vt_vols;
-        std::vector<double> log_vt_levels;
-        for (size_t i = 0; i < num_time_steps.size(); ++i)
-        {
-            const size_t num_steps = num_time_steps[i];
-            const double lamb = lamb_vec[i];
-            VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
-            vt.simulate_vt_levels(log_vt_levels, num_samples);
-            for (std::vector<double>::iterator itv = log_vt_levels.begin(); itv != log_vt_levels.end(); ++itv)
-                *itv = std::log(*itv / vt.init_level());
-            const double vol = sample_std(log_vt_levels) / std::sqrt(tenor);
-            vt_vols.push_back(vol);
-            std::cout << "N=" << num_steps << ", lamb=" << lamb << ", v0=" << init_var << ", stock_vol=" << volatility 
-                << ", target_vol=" << target_volatility << ", vt_vol=" << vol << std::endl;
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_vt_volatility_limit_along_path_1.csv");
-        outfile << "N,lambda,v0,stock_vol,target_vol,vt_vol\n";
-        for (size_t i = 0; i < num_time_steps.size(); ++i)
-            outfile << num_time_steps[i] << "," << lamb_vec[i] << "," << init_var << "," << volatility 
-                << "," << target_volatility << "," << vt_vols[i] << "\n";
-        outfile.close();
-
-        END_TEST("test_vt_volatility_limit_along_path_1");
-    }
-
-    void test_vt_volatility_limit_along_path_2(const size_t num_samples)
-    {
-        BEGIN_TEST("test_vt_volatility_limit_along_path_2");
-
-        const double discount_rate = 0.05;
-        const double rho = 0.03;
-        const double volatility = 0.5;
-        const double target_volatility = 0.2;
-        const double tenor = 1.0;
-        const double init_var = 0.02;
-        const double init_stock_level = 1.0;
-        const double init_vt_level = 1.0;
-        const double repo_rate = discount_rate - rho;
-        const double kappa = 1.0;
-
-        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
-        std::vector<double> lamb_vec;
-        for (const size_t num_steps : num_time_steps)
-            lamb_vec.push_back(1.0 - std::log(num_steps) / std::sqrt(num_steps));
-
-        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
-        std::vector<double> vt_vols;
-        std::vector<double> log_vt_levels;
-        for (size_t i = 0; i < num_time_steps.size(); ++i)
-        {
-            const size_t num_steps = num_time_steps[i];
-            const double lamb = lamb_vec[i];
-            VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
-            vt.simulate_vt_levels(log_vt_levels, num_samples);
-            for (std::vector<double>::iterator itv = log_vt_levels.begin(); itv != log_vt_levels.end(); ++itv)
-                *itv = std::log(*itv / vt.init_level());
-            const double vol = sample_std(log_vt_levels) / std::sqrt(tenor);
-            vt_vols.push_back(vol);
-            std::cout << "N=" << num_steps << ", lamb=" << lamb << ", v0=" << init_var << ", stock_vol=" << volatility
-                << ", target_vol=" << target_volatility << ", vt_vol=" << vol << std::endl;
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_vt_volatility_limit_along_path_2.csv");
-        outfile << "N,lambda,v0,stock_vol,target_vol,vt_vol\n";
-        for (size_t i = 0; i < num_time_steps.size(); ++i)
-            outfile << num_time_steps[i] << "," << lamb_vec[i] << "," << init_var << "," << volatility
-                << "," << target_volatility << "," << vt_vols[i] << "\n";
-        outfile.close();
-
-        END_TEST("test_vt_volatility_limit_along_path_2");
-    }
-
-    void test_vt_pricing(const size_t num_samples)
-    {
-        BEGIN_TEST("test_vt_pricing");
-
-        const double discount_rate = 0.05;
-        const double rho = 0.03;
-        const double volatility = 0.5;
-        const double target_volatility = 0.2;
-        const double tenor = 1.0;
-        const double init_var = 0.02;
-        const double init_stock_level = 1.0;
-        const double init_vt_level = 1.0;
-        const double repo_rate = discount_rate - rho;
-
-        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
-        std::vector<double> lamb_vec;
-        double lamb = 0.7;
-        while (lamb < 1.0)
-        {
-            lamb_vec.push_back(lamb);
-            lamb += 0.05;
-        }
-        if (lamb_vec.back() < 0.97)
-            lamb_vec.push_back(0.97);
-
-        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
-        std::vector<std::vector<double>> mc_vt_price_array(0);
-        std::vector<std::vector<double>> bs_limit_price_array(0);
-        mc_vt_price_array.reserve(num_time_steps.size());
-        bs_limit_price_array.reserve(num_time_steps.size());
-        std::vector<double> vt_levels;
-        std::vector<double> stock_levels;
-        for (const size_t num_steps : num_time_steps)
-        {
-            std::vector<double> mc_vt_prices;
-            std::vector<double> bs_limit_prices;
-            mc_vt_prices.reserve(lamb_vec.size());
-            bs_limit_prices.reserve(lamb_vec.size());
-            for (const double lamb : lamb_vec)
-            {
-                VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
-                vt.simulate_vt_levels(vt_levels, num_samples);
-                double mc_vt_price = 0.0;
-                for (const double level : vt_levels)
-                {
-                    mc_vt_price += std::max(level - vt.init_level(), 0.0);
-                }
-                mc_vt_price *= std::exp(-discount_rate * tenor);
-                mc_vt_price /= vt_levels.size();
-
-                const double limit_vol = target_volatility * std::sqrt(multiplier_V(lamb));
-                const double limit_repo = multiplier_U(lamb) * target_volatility / volatility * repo_rate;
-                const BlackScholesPtr limit_bs = BlackScholes::create(discount_rate, limit_repo, limit_vol, vt.init_level());
-                const double bs_limit_price = limit_bs->get_call_price(vt.init_level(), tenor);
-
-                mc_vt_prices.push_back(mc_vt_price);
-                bs_limit_prices.push_back(bs_limit_price);
-                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", mc_vt_price=" 
-                    << mc_vt_price << ", bs_limit_price=" << bs_limit_price << std::endl;
-            }
-            mc_vt_price_array.push_back(mc_vt_prices);
-            bs_limit_price_array.push_back(bs_limit_prices);
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_vt_pricing.csv");
-        outfile << "N,lambda,mc_vt_price,bs_limit_price\n";
-        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
-        {
-            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
-            {
-                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << mc_vt_price_array[i_num_step][i_lamb] 
-                    << "," << bs_limit_price_array[i_num_step][i_lamb] << "\n";
-            }
-        }
-        outfile.close();
-
-        END_TEST("test_vt_pricing");
-    }
-
-    void test_vt_vega(const size_t num_samples)
-    {
-        BEGIN_TEST("test_vt_vega");
-
-        const double discount_rate = 0.05;
-        const double rho = 0.03;
-        const double volatility = 0.5;
-        const double target_volatility = 0.2;
-        const double tenor = 1.0;
-        const double init_var = 0.02;
-        const double init_stock_level = 1.0;
-        const double init_vt_level = 1.0;
-        const double repo_rate = discount_rate - rho;
-
-        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
-        std::vector<double> lamb_vec;
-        double lamb = 0.7;
-        while (lamb < 1.0)
-        {
-            lamb_vec.push_back(lamb);
-            lamb += 0.05;
-        }
-        if (lamb_vec.back() < 0.97)
-            lamb_vec.push_back(0.97);
-
-        const double vol_bump = 0.001;
-        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
-        const BlackScholesPtr sde_bumped = BlackScholes::create(discount_rate, repo_rate, volatility + vol_bump, init_stock_level);
-        std::vector<std::vector<double>> mc_vt_vega_array(0);
-        std::vector<std::vector<double>> bs_limit_vega_array(0);
-        mc_vt_vega_array.reserve(num_time_steps.size());
-        bs_limit_vega_array.reserve(num_time_steps.size());
-        std::vector<double> vt_levels;
-        std::vector<double> stock_levels;
-        for (const size_t num_steps : num_time_steps)
-        {
-            std::vector<double> mc_vt_vegas;
-            std::vector<double> bs_limit_vegas;
-            mc_vt_vegas.reserve(lamb_vec.size());
-            bs_limit_vegas.reserve(lamb_vec.size());
-            for (const double lamb : lamb_vec)
-            {
-                VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
-                vt.simulate_vt_levels(vt_levels, num_samples);
-                double mc_vt_price = 0.0;
-                for (const double level : vt_levels)
-                {
-                    mc_vt_price += std::max(level - vt.init_level(), 0.0);
-                }
-                mc_vt_price *= std::exp(-discount_rate * tenor);
-                mc_vt_price /= vt_levels.size();
-
-                VolatilityTarget vt_bumped(sde_bumped, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
-                vt_bumped.simulate_vt_levels(vt_levels, num_samples);
-                double mc_vt_price_bumped = 0.0;
-                for (const double level : vt_levels)
-                {
-                    mc_vt_price_bumped += std::max(level - vt.init_level(), 0.0);
-                }
-                mc_vt_price_bumped *= std::exp(-discount_rate * tenor);
-                mc_vt_price_bumped /= vt_levels.size();
-
-                const double mc_vt_vega = (mc_vt_price_bumped - mc_vt_price) / vol_bump;
-
-                const double limit_vol = target_volatility * std::sqrt(multiplier_V(lamb));
-                const double limit_repo = multiplier_U(lamb) * target_volatility / volatility * repo_rate;
-                const BlackScholesPtr limit_bs = BlackScholes::create(discount_rate, limit_repo, limit_vol, vt.init_level());
-                const double bs_limit_rho = limit_bs->get_call_rho(vt.init_level(), tenor);
-                const double bs_limit_vega = limit_repo / volatility * bs_limit_rho;
-
-                mc_vt_vegas.push_back(mc_vt_vega);
-                bs_limit_vegas.push_back(bs_limit_vega);
-                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", mc_vt_vega="
-                    << mc_vt_vega << ", bs_limit_vega=" << bs_limit_vega << std::endl;
-            }
-            mc_vt_vega_array.push_back(mc_vt_vegas);
-            bs_limit_vega_array.push_back(bs_limit_vegas);
-        }
-
-        std::ofstream outfile;
-        outfile.open(root_dir() + "/tests/test_vt_vega.csv");
-        outfile << "N,lambda,mc_vt_vega,bs_limit_vega\n";
-        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
-        {
-            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
-            {
-                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << mc_vt_vega_array[i_num_step][i_lamb]
-                    << "," << bs_limit_vega_array[i_num_step][i_lamb] << "\n";
-            }
-        }
-        outfile.close();
-
-        END_TEST("test_vt_vega");
-    }
-
-}
+#include <tests.hpp>
+#include <volatility_target.hpp>
+#include <multilevel.hpp>
+#include <extrapolation.hpp>
+#include <workspace.hpp>
+#include <model_volatility_target.hpp>
+#include <heston.hpp>
+#include <special_functions.hpp>
+#include <limit_multipliers.hpp>
+#include <integration.hpp>
+#include <statistics.hpp>
+#include <dispatch.hpp>
+#include <algorithm>
+#include <fstream>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+    std::atomic<size_t> g_num_heap_allocations(0);
+
+#ifdef __cpp_aligned_new
+    void* aligned_malloc(const size_t size, const std::align_val_t alignment)
+    {
+#ifdef _MSC_VER
+        return _aligned_malloc(size > 0 ? size : 1, size_t(alignment));
+#else
+        void* p = nullptr;
+        return posix_memalign(&p, std::max(size_t(alignment), sizeof(void*)), size > 0 ? size : 1) == 0 ? p : nullptr;
+#endif
+    }
+
+    void aligned_free(void* p)
+    {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+#endif
+}
+
+// Counting allocator: every heap allocation of the program goes through it, the nothrow and, from C++17, the aligned
+// forms included (the array forms call these), so that test_simulation_workspace can check that warm simulations
+// make none. GCC takes the std::free of the replaced deletes, once inlined next to a call
+// of the replaced operator new, for a mismatched deallocation.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t size)
+{
+    ++g_num_heap_allocations;
+    void* p = std::malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    ++g_num_heap_allocations;
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    std::free(p);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    ++g_num_heap_allocations;
+    void* p = aligned_malloc(size, alignment);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    ++g_num_heap_allocations;
+    return aligned_malloc(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    aligned_free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    aligned_free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    aligned_free(p);
+}
+#endif
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+namespace cltvt
+{
+    VolatilityTargetSweep lambda_sweep(
+        const BlackScholesPtr& sde,
+        const std::vector<double>& lamb_vec,
+        const size_t num_time_steps,
+        const double target_volatility,
+        const double tenor,
+        const double init_var,
+        const double init_level
+    )
+    {
+        std::vector<VolatilityTarget> vts;
+        for (const double lamb : lamb_vec)
+            vts.emplace_back(sde, lamb, num_time_steps, target_volatility, tenor, init_var, init_level);
+        return VolatilityTargetSweep(vts);
+    }
+
+    const LimitMultipliers& limit_multipliers()
+    {
+        static const LimitMultipliers multipliers;
+        return multipliers;
+    }
+
+    const RunningStatistics& statistics(const AccumulatorPtr& acc)
+    {
+        return static_cast<const StatisticsAccumulator&>(*acc).statistics();
+    }
+
+    #define BEGIN_TEST(test_name) std::cout << "Running " + std::string(test_name) + "..." << std::endl;
+    #define END_TEST(test_name) std::cout << "Test results saved to tests/" + std::string(test_name) + ".csv\n" << std::endl;
+
+    void test_multiplier_U_bounds()
+    {
+        BEGIN_TEST("test_multiplier_U_bounds");
+
+        std::vector<double> lamb_vec;
+        double lamb = 0.7;
+        while (lamb < 1.0)
+        {
+            lamb_vec.push_back(lamb);
+            lamb += 0.02;
+        }
+
+        std::vector<double> vals;
+        std::vector<double> upper_bounds;
+        std::vector<double> lower_bounds;
+        for (const double lamb : lamb_vec)
+        {
+            const double val = multiplier_U(lamb);
+            const double one_by_lamb = 1.0 / lamb;
+            const double upper_bound = std::sqrt(std::pow(one_by_lamb, 1.25) * std::log(one_by_lamb) / (one_by_lamb - 1.0))
+                / (1.0 - std::exp(-2.0 * PI * PI / std::log(one_by_lamb)));
+            const double lower_bound = std::sqrt(std::pow(one_by_lamb, 1.2) * std::log(one_by_lamb) / (one_by_lamb - 1.0));
+            vals.push_back(val);
+            upper_bounds.push_back(upper_bound);
+            lower_bounds.push_back(lower_bound);
+            std::cout << "lambda=" << lamb << ", U=" << val << ", upper_bound=" << upper_bound << ", lower_bound=" << lower_bound << std::endl;
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_multiplier_U_bounds.csv");
+        outfile << "lambda,U,upper_bound,lower_bound\n";
+        for (size_t i = 0; i < lamb_vec.size(); ++i)
+        {
+            outfile << lamb_vec[i] << "," << vals[i] << "," << upper_bounds[i] << "," << lower_bounds[i] << "\n";
+        }
+        outfile.close();
+
+        END_TEST("test_multiplier_U_bounds");
+    }
+
+    void test_multiplier_V_bounds()
+    {
+        BEGIN_TEST("test_multiplier_V_bounds");
+
+        std::vector<double> lamb_vec;
+        double lamb = 0.7;
+        while (lamb < 1.0)
+        {
+            lamb_vec.push_back(lamb);
+            lamb += 0.02;
+        }
+
+        std::vector<double> vals;
+        std::vector<double> upper_bounds;
+        std::vector<double> lower_bounds;
+        for (const double lamb : lamb_vec)
+        {
+            const double val = multiplier_V(lamb);
+            const double one_by_lamb = 1.0 / lamb;
+            const double upper_bound = std::pow(one_by_lamb, 1.5) * std::log(one_by_lamb) / (one_by_lamb - 1.0);
+            const double lower_bound = std::pow(one_by_lamb, 1.45) * std::log(one_by_lamb) / (one_by_lamb - 1.0);
+            vals.push_back(val);
+            upper_bounds.push_back(upper_bound);
+            lower_bounds.push_back(lower_bound);
+            std::cout << "lambda=" << lamb << ", V=" << val << ", upper_bound=" << upper_bound << ", lower_bound=" << lower_bound << std::endl;
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_multiplier_V_bounds.csv");
+        outfile << "lambda,V,upper_bound,lower_bound\n";
+        for (size_t i = 0; i < lamb_vec.size(); ++i)
+        {
+            outfile << lamb_vec[i] << "," << vals[i] << "," << upper_bounds[i] << "," << lower_bounds[i] << "\n";
+        }
+        outfile.close();
+
+        END_TEST("test_multiplier_V_bounds");
+    }
+
+    void test_vt_volatility(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_volatility");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
+        std::vector<double> lamb_vec;
+        double lamb = 0.7;
+        while (lamb < 1.0)
+        {
+            lamb_vec.push_back(lamb);
+            lamb += 0.05;
+        }
+        if (lamb_vec.back() < 0.97)
+            lamb_vec.push_back(0.97);
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<std::vector<double>> vt_vol_array(0);
+        std::vector<std::vector<double>> limit_vol_array(0);
+        vt_vol_array.reserve(num_time_steps.size());
+        limit_vol_array.reserve(num_time_steps.size());
+        for (const size_t num_steps : num_time_steps)
+        {
+            std::vector<double> vols;
+            std::vector<double> limit_vols;
+            vols.reserve(lamb_vec.size());
+            limit_vols.reserve(lamb_vec.size());
+            const VolatilityTargetSweep sweep = lambda_sweep(sde, lamb_vec, num_steps, target_volatility, tenor, init_var, init_vt_level);
+            std::vector<AccumulatorPtr> log_vt_levels;
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+                log_vt_levels.push_back(std::make_shared<LogLevelStatistics>(init_vt_level));
+            sweep.simulate_vt_levels(log_vt_levels, num_samples);
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const double lamb = lamb_vec[i_lamb];
+                const double vol = statistics(log_vt_levels[i_lamb]).std_dev() / std::sqrt(tenor);
+                const double limit_vol = target_volatility * std::sqrt(limit_multipliers().V(lamb));
+                vols.push_back(vol);
+                limit_vols.push_back(limit_vol);
+                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", vt_vol=" << vol << ", limit_vol=" << limit_vol << std::endl;
+            }
+            vt_vol_array.push_back(vols);
+            limit_vol_array.push_back(limit_vols);
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_volatility.csv");
+        outfile << "N,lambda,vt_vol,limit_vol\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," 
+                    << vt_vol_array[i_num_step][i_lamb] << "," << limit_vol_array[i_num_step][i_lamb] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_volatility");
+    }
+
+    void test_vt_volatility_simultaneous_limit(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_volatility_simultaneous_limit");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = volatility * volatility;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
+        std::vector<double> lamb_vec;
+        double lamb = 0.7;
+        while (lamb < 1.0)
+        {
+            lamb_vec.push_back(lamb);
+            lamb += 0.05;
+        }
+        if (lamb_vec.back() < 0.97)
+            lamb_vec.push_back(0.97);
+        if (lamb_vec.back() < 0.99)
+            lamb_vec.push_back(0.99);
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<std::vector<double>> vt_vol_array(0);
+        vt_vol_array.reserve(num_time_steps.size());
+        for (const size_t num_steps : num_time_steps)
+        {
+            std::vector<double> vols;
+            std::vector<double> lim_vols;
+            vols.reserve(lamb_vec.size());
+            const VolatilityTargetSweep sweep = lambda_sweep(sde, lamb_vec, num_steps, target_volatility, tenor, init_var, init_vt_level);
+            std::vector<AccumulatorPtr> log_vt_levels;
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+                log_vt_levels.push_back(std::make_shared<LogLevelStatistics>(init_vt_level));
+            sweep.simulate_vt_levels(log_vt_levels, num_samples);
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const double lamb = lamb_vec[i_lamb];
+                const double vol = statistics(log_vt_levels[i_lamb]).std_dev() / std::sqrt(tenor);
+                vols.push_back(vol);
+                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", vt_vol=" << vol << ", target_vol=" << target_volatility << std::endl;
+            }
+            vt_vol_array.push_back(vols);
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_volatility_simultaneous_limit.csv");
+        outfile << "N,lambda,vt_vol,target_vol\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << ","
+                    << vt_vol_array[i_num_step][i_lamb] << "," << target_volatility << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_volatility_simultaneous_limit");
+    }
+
+    void test_vt_volatility_limit_along_path_1(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_volatility_limit_along_path_1");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+        const double kappa = 1.0;
+
+        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
+        std::vector<double> lamb_vec;
+        for (const size_t num_steps : num_time_steps)
+            lamb_vec.push_back(1.0 - 1.0 / (num_steps * num_steps));
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<double> vt_vols;
+        for (size_t i = 0; i < num_time_steps.size(); ++i)
+        {
+            const size_t num_steps = num_time_steps[i];
+            const double lamb = lamb_vec[i];
+            VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+            LogLevelStatistics log_vt_levels(vt.init_level());
+            vt.simulate_vt_levels(log_vt_levels, num_samples);
+            const double vol = log_vt_levels.statistics().std_dev() / std::sqrt(tenor);
+            vt_vols.push_back(vol);
+            std::cout << "N=" << num_steps << ", lamb=" << lamb << ", v0=" << init_var << ", stock_vol=" << volatility 
+                << ", target_vol=" << target_volatility << ", vt_vol=" << vol << std::endl;
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_volatility_limit_along_path_1.csv");
+        outfile << "N,lambda,v0,stock_vol,target_vol,vt_vol\n";
+        for (size_t i = 0; i < num_time_steps.size(); ++i)
+            outfile << num_time_steps[i] << "," << lamb_vec[i] << "," << init_var << "," << volatility 
+                << "," << target_volatility << "," << vt_vols[i] << "\n";
+        outfile.close();
+
+        END_TEST("test_vt_volatility_limit_along_path_1");
+    }
+
+    void test_vt_volatility_limit_along_path_2(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_volatility_limit_along_path_2");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+        const double kappa = 1.0;
+
+        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
+        std::vector<double> lamb_vec;
+        for (const size_t num_steps : num_time_steps)
+            lamb_vec.push_back(1.0 - std::log(num_steps) / std::sqrt(num_steps));
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<double> vt_vols;
+        for (size_t i = 0; i < num_time_steps.size(); ++i)
+        {
+            const size_t num_steps = num_time_steps[i];
+            const double lamb = lamb_vec[i];
+            VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+            LogLevelStatistics log_vt_levels(vt.init_level());
+            vt.simulate_vt_levels(log_vt_levels, num_samples);
+            const double vol = log_vt_levels.statistics().std_dev() / std::sqrt(tenor);
+            vt_vols.push_back(vol);
+            std::cout << "N=" << num_steps << ", lamb=" << lamb << ", v0=" << init_var << ", stock_vol=" << volatility
+                << ", target_vol=" << target_volatility << ", vt_vol=" << vol << std::endl;
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_volatility_limit_along_path_2.csv");
+        outfile << "N,lambda,v0,stock_vol,target_vol,vt_vol\n";
+        for (size_t i = 0; i < num_time_steps.size(); ++i)
+            outfile << num_time_steps[i] << "," << lamb_vec[i] << "," << init_var << "," << volatility
+                << "," << target_volatility << "," << vt_vols[i] << "\n";
+        outfile.close();
+
+        END_TEST("test_vt_volatility_limit_along_path_2");
+    }
+
+    void test_vt_pricing(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_pricing");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
+        std::vector<double> lamb_vec;
+        double lamb = 0.7;
+        while (lamb < 1.0)
+        {
+            lamb_vec.push_back(lamb);
+            lamb += 0.05;
+        }
+        if (lamb_vec.back() < 0.97)
+            lamb_vec.push_back(0.97);
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<std::vector<double>> mc_vt_price_array(0);
+        std::vector<std::vector<double>> mc_vt_stderr_array(0);
+        std::vector<std::vector<double>> bs_limit_price_array(0);
+        std::vector<std::vector<double>> mc_vt_implied_vol_array(0);
+        std::vector<std::vector<double>> bs_limit_vol_array(0);
+        mc_vt_price_array.reserve(num_time_steps.size());
+        mc_vt_stderr_array.reserve(num_time_steps.size());
+        bs_limit_price_array.reserve(num_time_steps.size());
+        mc_vt_implied_vol_array.reserve(num_time_steps.size());
+        bs_limit_vol_array.reserve(num_time_steps.size());
+        std::vector<double> stock_levels;
+        for (const size_t num_steps : num_time_steps)
+        {
+            std::vector<double> mc_vt_prices;
+            std::vector<double> mc_vt_stderrs;
+            std::vector<double> bs_limit_prices;
+            std::vector<double> mc_vt_implied_vols;
+            std::vector<double> bs_limit_vols;
+            mc_vt_prices.reserve(lamb_vec.size());
+            mc_vt_stderrs.reserve(lamb_vec.size());
+            bs_limit_prices.reserve(lamb_vec.size());
+            mc_vt_implied_vols.reserve(lamb_vec.size());
+            bs_limit_vols.reserve(lamb_vec.size());
+            const VolatilityTargetSweep sweep = lambda_sweep(sde, lamb_vec, num_steps, target_volatility, tenor, init_var, init_vt_level);
+            std::vector<AccumulatorPtr> payoffs;
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+                payoffs.push_back(std::make_shared<CallPayoffStatistics>(init_vt_level, std::exp(-discount_rate * tenor)));
+            sweep.simulate_vt_levels(payoffs, num_samples);
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const double lamb = lamb_vec[i_lamb];
+                const double mc_vt_price = statistics(payoffs[i_lamb]).mean();
+                const double mc_vt_stderr = statistics(payoffs[i_lamb]).standard_error();
+
+                const BlackScholesPtr limit_bs = limit_multipliers().limit_sde(*sde, lamb, target_volatility, init_vt_level);
+                const double bs_limit_price = limit_bs->get_call_price(init_vt_level, tenor);
+                // The Monte Carlo price quoted in volatility with the rates of the limit, next to the limit volatility.
+                const double mc_vt_implied_vol = limit_bs->get_call_implied_volatility(mc_vt_price, init_vt_level, tenor);
+                const double bs_limit_vol = limit_bs->volatility();
+
+                mc_vt_prices.push_back(mc_vt_price);
+                mc_vt_stderrs.push_back(mc_vt_stderr);
+                bs_limit_prices.push_back(bs_limit_price);
+                mc_vt_implied_vols.push_back(mc_vt_implied_vol);
+                bs_limit_vols.push_back(bs_limit_vol);
+                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", mc_vt_price=" << mc_vt_price 
+                    << ", mc_vt_stderr=" << mc_vt_stderr << ", bs_limit_price=" << bs_limit_price
+                    << ", mc_vt_implied_vol=" << mc_vt_implied_vol << ", bs_limit_vol=" << bs_limit_vol << std::endl;
+            }
+            mc_vt_price_array.push_back(mc_vt_prices);
+            mc_vt_stderr_array.push_back(mc_vt_stderrs);
+            bs_limit_price_array.push_back(bs_limit_prices);
+            mc_vt_implied_vol_array.push_back(mc_vt_implied_vols);
+            bs_limit_vol_array.push_back(bs_limit_vols);
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_pricing.csv");
+        outfile << "N,lambda,mc_vt_price,mc_vt_stderr,bs_limit_price,mc_vt_implied_vol,bs_limit_vol\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << mc_vt_price_array[i_num_step][i_lamb] 
+                    << "," << mc_vt_stderr_array[i_num_step][i_lamb] << "," << bs_limit_price_array[i_num_step][i_lamb]
+                    << "," << mc_vt_implied_vol_array[i_num_step][i_lamb] << "," << bs_limit_vol_array[i_num_step][i_lamb] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_pricing");
+    }
+
+    void test_vt_vega(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_vega");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 2000, 5000, 10000, 50000 };
+        std::vector<double> lamb_vec;
+        double lamb = 0.7;
+        while (lamb < 1.0)
+        {
+            lamb_vec.push_back(lamb);
+            lamb += 0.05;
+        }
+        if (lamb_vec.back() < 0.97)
+            lamb_vec.push_back(0.97);
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<std::vector<double>> mc_vt_vega_array(0);
+        std::vector<std::vector<double>> mc_vt_vega_stderr_array(0);
+        std::vector<std::vector<double>> bs_limit_vega_array(0);
+        mc_vt_vega_array.reserve(num_time_steps.size());
+        mc_vt_vega_stderr_array.reserve(num_time_steps.size());
+        bs_limit_vega_array.reserve(num_time_steps.size());
+        std::vector<double> stock_levels;
+        for (const size_t num_steps : num_time_steps)
+        {
+            std::vector<double> mc_vt_vegas;
+            std::vector<double> mc_vt_vega_stderrs;
+            std::vector<double> bs_limit_vegas;
+            mc_vt_vegas.reserve(lamb_vec.size());
+            mc_vt_vega_stderrs.reserve(lamb_vec.size());
+            bs_limit_vegas.reserve(lamb_vec.size());
+            const VolatilityTargetSweep sweep = lambda_sweep(sde, lamb_vec, num_steps, target_volatility, tenor, init_var, init_vt_level);
+            const std::vector<CallSensitivities> sensitivities = sweep.simulate_call_sensitivities(init_vt_level, num_samples);
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const double lamb = lamb_vec[i_lamb];
+                const double mc_vt_vega = sensitivities[i_lamb].vega.mean();
+                const double mc_vt_vega_stderr = sensitivities[i_lamb].vega.standard_error();
+
+                const BlackScholesPtr limit_bs = limit_multipliers().limit_sde(*sde, lamb, target_volatility, init_vt_level);
+                // Only the limit repo rate depends on volatility, and it is proportional to 1 / volatility.
+                const BlackScholesGreeks bs_limit_greeks = limit_bs->get_call_greeks(init_vt_level, tenor);
+                const double bs_limit_vega = -limit_bs->repo_rate() / volatility * bs_limit_greeks.repo_rho;
+
+                mc_vt_vegas.push_back(mc_vt_vega);
+                mc_vt_vega_stderrs.push_back(mc_vt_vega_stderr);
+                bs_limit_vegas.push_back(bs_limit_vega);
+                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", mc_vt_vega=" << mc_vt_vega 
+                    << ", mc_vt_vega_stderr=" << mc_vt_vega_stderr << ", bs_limit_vega=" << bs_limit_vega << std::endl;
+            }
+            mc_vt_vega_array.push_back(mc_vt_vegas);
+            mc_vt_vega_stderr_array.push_back(mc_vt_vega_stderrs);
+            bs_limit_vega_array.push_back(bs_limit_vegas);
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_vega.csv");
+        outfile << "N,lambda,mc_vt_vega,mc_vt_vega_stderr,bs_limit_vega\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << mc_vt_vega_array[i_num_step][i_lamb]
+                    << "," << mc_vt_vega_stderr_array[i_num_step][i_lamb] << "," << bs_limit_vega_array[i_num_step][i_lamb] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_vega");
+    }
+
+    void test_vt_pricing_sobol(const size_t num_samples, const size_t num_replications)
+    {
+        BEGIN_TEST("test_vt_pricing_sobol");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+        const double discount_factor = std::exp(-discount_rate * tenor);
+
+        const std::vector<size_t> num_time_steps { 1000, 5000 };
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95 };
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<double> mc_vt_prices;
+        std::vector<double> mc_vt_stderrs;
+        std::vector<double> qmc_vt_prices;
+        std::vector<double> qmc_vt_stderrs;
+        for (const size_t num_steps : num_time_steps)
+        {
+            for (const double lamb : lamb_vec)
+            {
+                const VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+                CallPayoffStatistics mc_payoffs(init_vt_level, discount_factor);
+                vt.simulate_vt_levels_parallel(mc_payoffs, num_samples * num_replications);
+
+                std::vector<AccumulatorPtr> qmc_payoffs;
+                for (size_t r = 0; r < num_replications; ++r)
+                    qmc_payoffs.push_back(std::make_shared<CallPayoffStatistics>(init_vt_level, discount_factor));
+                vt.simulate_vt_levels_sobol(qmc_payoffs, num_samples);
+                RunningStatistics qmc_estimates;
+                for (const AccumulatorPtr& payoffs : qmc_payoffs)
+                    qmc_estimates.add(statistics(payoffs).mean());
+
+                mc_vt_prices.push_back(mc_payoffs.statistics().mean());
+                mc_vt_stderrs.push_back(mc_payoffs.statistics().standard_error());
+                qmc_vt_prices.push_back(qmc_estimates.mean());
+                qmc_vt_stderrs.push_back(qmc_estimates.standard_error());
+                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", mc_vt_price=" << mc_vt_prices.back()
+                    << ", mc_vt_stderr=" << mc_vt_stderrs.back() << ", qmc_vt_price=" << qmc_vt_prices.back()
+                    << ", qmc_vt_stderr=" << qmc_vt_stderrs.back() << std::endl;
+            }
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_pricing_sobol.csv");
+        outfile << "N,lambda,mc_vt_price,mc_vt_stderr,qmc_vt_price,qmc_vt_stderr,variance_ratio\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const size_t i = i_num_step * lamb_vec.size() + i_lamb;
+                const double variance_ratio = (mc_vt_stderrs[i] * mc_vt_stderrs[i]) / (qmc_vt_stderrs[i] * qmc_vt_stderrs[i]);
+                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << mc_vt_prices[i] << "," << mc_vt_stderrs[i]
+                    << "," << qmc_vt_prices[i] << "," << qmc_vt_stderrs[i] << "," << variance_ratio << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_pricing_sobol");
+    }
+
+    void test_vt_multilevel(const double target_standard_error)
+    {
+        BEGIN_TEST("test_vt_multilevel");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const size_t num_time_steps = 50000;
+        const size_t num_levels = 5;
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95, 0.97 };
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<std::string> quantities;
+        std::vector<double> lambdas;
+        std::vector<double> limit_values;
+        std::vector<MultilevelEstimate> estimates;
+        for (const double lamb : lamb_vec)
+        {
+            const VolatilityTarget vt(sde, lamb, num_time_steps, target_volatility, tenor, init_var, init_vt_level);
+            const MultilevelVolatilityTarget multilevel(vt, num_levels);
+            const BlackScholesPtr limit_bs = limit_multipliers().limit_sde(*sde, lamb, target_volatility, init_vt_level);
+
+            quantities.push_back("price");
+            lambdas.push_back(lamb);
+            limit_values.push_back(limit_bs->get_call_price(init_vt_level, tenor));
+            estimates.push_back(multilevel.estimate_call_price(init_vt_level, target_standard_error));
+
+            quantities.push_back("volatility");
+            lambdas.push_back(lamb);
+            limit_values.push_back(limit_bs->volatility());
+            estimates.push_back(multilevel.estimate_volatility(target_standard_error));
+
+            for (size_t i = estimates.size() - 2; i < estimates.size(); ++i)
+            {
+                std::cout << "N=" << num_time_steps << ", lamb=" << lamb << ", " << quantities[i] << "=" << estimates[i].value
+                    << ", stderr=" << estimates[i].standard_error << ", limit=" << limit_values[i]
+                    << ", coarsest_N=" << estimates[i].levels.front().num_time_steps
+                    << ", cost_reduction=" << estimates[i].cost_reduction() << ", seconds=" << estimates[i].seconds << std::endl;
+            }
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_multilevel.csv");
+        outfile << "quantity,lambda,value,stderr,limit_value,cost,single_level_cost,level_N,level_samples,level_mean,"
+            << "level_variance,level_cost,level_seconds\n";
+        for (size_t i = 0; i < estimates.size(); ++i)
+        {
+            for (const MultilevelLevel& level : estimates[i].levels)
+            {
+                outfile << quantities[i] << "," << lambdas[i] << "," << estimates[i].value << "," << estimates[i].standard_error
+                    << "," << limit_values[i] << "," << estimates[i].cost << "," << estimates[i].single_level_cost
+                    << "," << level.num_time_steps << "," << level.num_samples << "," << level.mean << "," << level.variance
+                    << "," << level.cost << "," << level.seconds << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_multilevel");
+    }
+
+    void test_vt_extrapolation(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_extrapolation");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        // Ladder 625, 1250, 2500, 5000 with an error in 1 / N.
+        const size_t num_time_steps = 5000;
+        const size_t num_grids = 4;
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95, 0.97 };
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<std::string> quantities;
+        std::vector<double> lambdas;
+        std::vector<double> limit_values;
+        std::vector<ExtrapolatedEstimate> estimates;
+        for (const double lamb : lamb_vec)
+        {
+            const VolatilityTarget vt(sde, lamb, num_time_steps, target_volatility, tenor, init_var, init_vt_level);
+            const VolatilityTargetLadder ladder(vt, num_grids);
+            const BlackScholesPtr limit_bs = limit_multipliers().limit_sde(*sde, lamb, target_volatility, init_vt_level);
+
+            quantities.push_back("price");
+            lambdas.push_back(lamb);
+            limit_values.push_back(limit_bs->get_call_price(init_vt_level, tenor));
+            estimates.push_back(ladder.extrapolate_call_price(init_vt_level, num_samples));
+
+            quantities.push_back("volatility");
+            lambdas.push_back(lamb);
+            limit_values.push_back(target_volatility * std::sqrt(limit_multipliers().V(lamb)));
+            estimates.push_back(ladder.extrapolate_volatility(num_samples));
+
+            for (size_t i = estimates.size() - 2; i < estimates.size(); ++i)
+            {
+                std::cout << "N=" << num_time_steps << ", lamb=" << lamb << ", " << quantities[i] << "="
+                    << estimates[i].estimates.back() << ", extrapolated=" << estimates[i].value << ", ci=["
+                    << estimates[i].lower << ", " << estimates[i].upper << "], limit=" << limit_values[i] << std::endl;
+            }
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_extrapolation.csv");
+        outfile << "quantity,lambda,extrapolated,stderr,lower,upper,limit_value,N,estimate,estimate_stderr,residual\n";
+        for (size_t i = 0; i < estimates.size(); ++i)
+        {
+            const ExtrapolatedEstimate& e = estimates[i];
+            for (size_t k = 0; k < e.estimates.size(); ++k)
+            {
+                outfile << quantities[i] << "," << lambdas[i] << "," << e.value << "," << e.standard_error << "," << e.lower
+                    << "," << e.upper << "," << limit_values[i] << "," << e.num_time_steps[k] << "," << e.estimates[k]
+                    << "," << e.standard_errors[k] << "," << e.residuals[k] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_extrapolation");
+    }
+
+    void test_simulation_workspace(const size_t num_samples)
+    {
+        BEGIN_TEST("test_simulation_workspace");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+        const double discount_factor = std::exp(-discount_rate * tenor);
+
+        const std::vector<size_t> num_time_steps { 1000, 2000, 5000 };
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95 };
+
+        // Set-up: the strategies and the accumulators are built once for the whole sweep.
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<VolatilityTargetSweep> sweeps;
+        for (const size_t num_steps : num_time_steps)
+            sweeps.push_back(lambda_sweep(sde, lamb_vec, num_steps, target_volatility, tenor, init_var, init_vt_level));
+        std::vector<AccumulatorPtr> payoffs;
+        for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            payoffs.push_back(std::make_shared<CallPayoffStatistics>(init_vt_level, discount_factor));
+        std::vector<double> vt_levels(lamb_vec.size());
+        SimulationWorkspace workspace;
+
+        auto run_sweep = [&]() {
+            for (const VolatilityTargetSweep& sweep : sweeps)
+            {
+                for (const AccumulatorPtr& acc : payoffs)
+                    acc->reset();
+                sweep.simulate_vt_levels(payoffs, num_samples, DEFAULT_RNG_SEED, workspace);
+                StandardNormalGenerator rng;
+                sweep.simulate_vt_levels(vt_levels.data(), rng);
+                for (size_t i_lamb = 0; i_lamb < sweep.size(); ++i_lamb)
+                    sweep.target(i_lamb).simulate_call_gradient(init_vt_level, num_samples / 10, DEFAULT_RNG_SEED, workspace);
+
+                const VolatilityTarget& vt = sweep.target(0);
+                const SimulationWorkspace::Frame frame(workspace);
+                double* dtimes = workspace.allocate<double>(vt.num_time_steps());
+                double* normals = workspace.allocate<double>(vt.num_time_steps());
+                double* stock_path = workspace.allocate<double>(vt.num_time_steps() + 1);
+                std::fill(dtimes, dtimes + vt.num_time_steps(), vt.rebalance_time_step());
+                rng.generate(normals, vt.num_time_steps());
+                sde->populate_path(stock_path, dtimes, normals, vt.num_time_steps());
+            }
+        };
+
+        std::vector<std::string> passes { "cold", "warm" };
+        std::vector<size_t> heap_allocations;
+        std::vector<size_t> workspace_capacities;
+        for (const std::string& pass : passes)
+        {
+            const size_t start = g_num_heap_allocations.load();
+            run_sweep();
+            heap_allocations.push_back(g_num_heap_allocations.load() - start);
+            workspace_capacities.push_back(workspace.capacity());
+            std::cout << "pass=" << pass << ", heap_allocations=" << heap_allocations.back()
+                << ", workspace_capacity=" << workspace_capacities.back() << std::endl;
+        }
+        ASSERT(heap_allocations.back() == 0, "a warm sweep must not allocate from the heap");
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_simulation_workspace.csv");
+        outfile << "pass,heap_allocations,workspace_capacity\n";
+        for (size_t i = 0; i < passes.size(); ++i)
+            outfile << passes[i] << "," << heap_allocations[i] << "," << workspace_capacities[i] << "\n";
+        outfile.close();
+
+        END_TEST("test_simulation_workspace");
+    }
+
+    void test_model_volatility_target(const size_t num_samples)
+    {
+        BEGIN_TEST("test_model_volatility_target");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 5000 };
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95 };
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<double> mean_levels;
+        std::vector<double> model_differences;
+        std::vector<double> any_differences;
+        for (const size_t num_steps : num_time_steps)
+        {
+            for (const double lamb : lamb_vec)
+            {
+                const VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+                const BlackScholesVolatilityTarget model_vt(*sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+                const AnyVolatilityTargetPtr any_vt = create_any_volatility_target(vt);
+                std::vector<double> vt_levels;
+                std::vector<double> model_levels;
+                std::vector<double> any_levels;
+                vt.simulate_vt_levels_parallel(vt_levels, num_samples);
+                model_vt.simulate_vt_levels_parallel(model_levels, num_samples);
+                any_vt->simulate_vt_levels_parallel(any_levels, num_samples);
+
+                RunningStatistics levels;
+                double model_difference = 0.0;
+                double any_difference = 0.0;
+                for (size_t i = 0; i < num_samples; ++i)
+                {
+                    levels.add(vt_levels[i]);
+                    model_difference = std::max(model_difference, std::abs(model_levels[i] - vt_levels[i]));
+                    any_difference = std::max(any_difference, std::abs(any_levels[i] - vt_levels[i]));
+                }
+                ASSERT(model_difference < 1e-12 && any_difference < 1e-12, "model levels must match VolatilityTarget");
+
+                mean_levels.push_back(levels.mean());
+                model_differences.push_back(model_difference);
+                any_differences.push_back(any_difference);
+                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", mean_level=" << mean_levels.back()
+                    << ", max_model_difference=" << model_difference << ", max_any_difference=" << any_difference << std::endl;
+            }
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_model_volatility_target.csv");
+        outfile << "N,lambda,mean_level,max_model_difference,max_any_difference\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const size_t i = i_num_step * lamb_vec.size() + i_lamb;
+                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << mean_levels[i] << ","
+                    << model_differences[i] << "," << any_differences[i] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_model_volatility_target");
+    }
+
+    void test_vt_heston(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_heston");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double kappa = 2.0;
+        const double theta = 0.25;
+        const double vol_of_vol = 0.5;
+        const double correlation = -0.7;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 5000 };
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95 };
+
+        // The discretisation keeps the forward and the expected variance: check them on paths of a few coarse steps,
+        // where a bias of the scheme would show, of a model far from the Feller condition (2 kappa theta >= xi^2), so
+        // that the variance often hits zero and the exponential branch of the scheme is taken, with a negative and a
+        // positive correlation.
+        const size_t num_path_steps = 10;
+        const std::vector<double> dtimes(num_path_steps, tenor / num_path_steps);
+        const PathNormalGenerator path_rng;
+        std::vector<double> normals;
+        std::vector<double> stock_path(num_path_steps + 1);
+        std::vector<double> var_path(num_path_steps + 1);
+        for (const double stressed_correlation : { correlation, -correlation })
+        {
+            const HestonPtr stressed_model = Heston::create(
+                discount_rate, repo_rate, 1.0, 0.04, 1.0, stressed_correlation, 0.04, init_stock_level
+            );
+            RunningStatistics final_levels;
+            RunningStatistics final_vars;
+            for (size_t i = 0; i < num_samples; ++i)
+            {
+                path_rng.populate_standard_normals(normals, i, 2 * num_path_steps);
+                stressed_model->populate_path(stock_path.data(), var_path.data(), dtimes.data(), normals.data(), num_path_steps);
+                final_levels.add(stock_path.back());
+                final_vars.add(var_path.back());
+            }
+            const double forward = init_stock_level * std::exp((discount_rate - repo_rate) * tenor);
+            const double expected_var = stressed_model->expected_var(tenor);
+            std::cout << "correlation=" << stressed_correlation << ", mean_level=" << final_levels.mean() << " ("
+                << final_levels.standard_error() << "), forward=" << forward << ", mean_var=" << final_vars.mean() << " ("
+                << final_vars.standard_error() << "), expected_var=" << expected_var << std::endl;
+            ASSERT(std::abs(final_levels.mean() - forward) < 4.0 * final_levels.standard_error(), "QE paths must keep the forward");
+            ASSERT(
+                std::abs(final_vars.mean() - expected_var) < 4.0 * final_vars.standard_error(),
+                "QE paths must keep the expected variance"
+            );
+        }
+
+        // With a positive correlation, a step of a year from a variance of 10 has no martingale correction and falls
+        // back to the uncorrected drift: the levels must be finite, and the same with the batch kernels.
+        const HestonPtr extreme_model = Heston::create(discount_rate, repo_rate, 1.0, 0.04, 3.0, 0.9, 10.0, init_stock_level);
+        const HestonVolatilityTarget extreme_vt(*extreme_model, lamb_vec.back(), 2, target_volatility, 2.0, init_var, init_vt_level);
+        std::vector<double> extreme_levels;
+        std::vector<double> extreme_batch_levels;
+        extreme_vt.simulate_vt_levels_parallel(extreme_levels, num_samples / 100);
+        extreme_vt.simulate_vt_levels_batch(extreme_batch_levels, num_samples / 100);
+        double extreme_batch_difference = 0.0;
+        for (size_t i = 0; i < extreme_levels.size(); ++i)
+        {
+            ASSERT(std::isfinite(extreme_levels[i]) && std::isfinite(extreme_batch_levels[i]), "uncorrected QE steps must give finite levels");
+            extreme_batch_difference = std::max(extreme_batch_difference, std::abs(extreme_batch_levels[i] - extreme_levels[i]));
+        }
+        ASSERT(extreme_batch_difference < 1e-10, "batch and scalar uncorrected Heston paths must agree");
+        std::cout << "uncorrected steps: max_batch_difference=" << extreme_batch_difference << std::endl;
+
+        // VT volatility on Heston and on Black-Scholes with volatility sqrt(theta) against the Black-Scholes limit.
+        const HestonPtr model = Heston::create(discount_rate, repo_rate, kappa, theta, vol_of_vol, correlation, theta, init_stock_level);
+        const BlackScholes sde(discount_rate, repo_rate, std::sqrt(theta), init_stock_level);
+        std::vector<double> heston_vols;
+        std::vector<double> black_scholes_vols;
+        std::vector<double> limit_vols;
+        std::vector<double> batch_differences;
+        for (const size_t num_steps : num_time_steps)
+        {
+            for (const double lamb : lamb_vec)
+            {
+                const HestonVolatilityTarget heston_vt(*model, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+                const BlackScholesVolatilityTarget black_scholes_vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+                LogLevelStatistics heston_log_levels(init_vt_level);
+                LogLevelStatistics black_scholes_log_levels(init_vt_level);
+                heston_vt.simulate_vt_levels_batch(heston_log_levels, num_samples);
+                black_scholes_vt.simulate_vt_levels_batch(black_scholes_log_levels, num_samples);
+
+                // The batch kernels and the fused scalar path agree up to rounding.
+                std::vector<double> levels;
+                std::vector<double> batch_levels;
+                heston_vt.simulate_vt_levels_parallel(levels, num_samples / 100);
+                heston_vt.simulate_vt_levels_batch(batch_levels, num_samples / 100);
+                double batch_difference = 0.0;
+                for (size_t i = 0; i < levels.size(); ++i)
+                    batch_difference = std::max(batch_difference, std::abs(batch_levels[i] - levels[i]));
+                ASSERT(batch_difference < 1e-10, "batch and scalar Heston paths must agree");
+
+                heston_vols.push_back(heston_log_levels.statistics().std_dev() / std::sqrt(tenor));
+                black_scholes_vols.push_back(black_scholes_log_levels.statistics().std_dev() / std::sqrt(tenor));
+                limit_vols.push_back(target_volatility * std::sqrt(limit_multipliers().V(lamb)));
+                batch_differences.push_back(batch_difference);
+                std::cout << "N=" << num_steps << ", lamb=" << lamb << ", heston_vt_vol=" << heston_vols.back()
+                    << ", bs_vt_vol=" << black_scholes_vols.back() << ", limit_vol=" << limit_vols.back()
+                    << ", max_batch_difference=" << batch_difference << std::endl;
+            }
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_heston.csv");
+        outfile << "N,lambda,heston_vt_vol,bs_vt_vol,limit_vol,max_batch_difference\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const size_t i = i_num_step * lamb_vec.size() + i_lamb;
+                outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << heston_vols[i] << ","
+                    << black_scholes_vols[i] << "," << limit_vols[i] << "," << batch_differences[i] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_heston");
+    }
+
+    void test_simd_lane_equivalence(const size_t num_samples)
+    {
+        BEGIN_TEST("test_simd_lane_equivalence");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 5000 };
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95 };
+
+        // Batch levels of the same seed with Vec1 and with the widest Vec the CPU runs must be the same bits.
+        const SimdIsa initial_isa = simd_isa();
+        const SimdIsa widest_isa = detect_simd_isa();
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<double> mean_levels;
+        std::vector<size_t> num_differences;
+        for (const size_t num_steps : num_time_steps)
+        {
+            for (const double lamb : lamb_vec)
+            {
+                const VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+                std::vector<double> scalar_levels;
+                std::vector<double> widest_levels;
+                set_simd_isa(SimdIsa::SCALAR);
+                vt.simulate_vt_levels_batch(scalar_levels, num_samples);
+                set_simd_isa(widest_isa);
+                vt.simulate_vt_levels_batch(widest_levels, num_samples);
+
+                RunningStatistics levels;
+                size_t num_different = 0;
+                for (size_t i = 0; i < num_samples; ++i)
+                {
+                    levels.add(scalar_levels[i]);
+                    if (std::memcmp(&scalar_levels[i], &widest_levels[i], sizeof(double)) != 0)
+                        ++num_different;
+                }
+                ASSERT(num_different == 0, simd_isa_name(widest_isa) + " levels must be those of the scalar kernels");
+
+                mean_levels.push_back(levels.mean());
+                num_differences.push_back(num_different);
+                std::cout << "isa=" << simd_isa_name(widest_isa) << ", N=" << num_steps << ", lamb=" << lamb
+                    << ", mean_level=" << mean_levels.back() << ", num_differences=" << num_different << std::endl;
+            }
+        }
+        set_simd_isa(initial_isa);
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_simd_lane_equivalence.csv");
+        outfile << "isa,N,lambda,mean_level,num_differences\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                const size_t i = i_num_step * lamb_vec.size() + i_lamb;
+                outfile << simd_isa_name(widest_isa) << "," << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb]
+                    << "," << mean_levels[i] << "," << num_differences[i] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_simd_lane_equivalence");
+    }
+
+    void test_vt_call_gradient(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_call_gradient");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+        const size_t num_time_steps = 1000;
+        const double strike = init_vt_level;
+        const double bump = 1e-5;
+
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95 };
+        const std::vector<std::string> parameters {
+            "discount_rate", "repo_rate", "volatility", "lambda", "target_volatility", "init_var", "init_level"
+        };
+
+        // Call price on the paths of simulate_call_gradient_parallel with the parameters p, so that central differences
+        // of it share their random numbers.
+        auto call_price = [&](const std::vector<double>& p) {
+            const BlackScholesPtr sde = BlackScholes::create(p[0], p[1], p[2], init_stock_level);
+            const VolatilityTarget vt(sde, p[3], num_time_steps, p[4], tenor, p[5], p[6]);
+            CallPayoffStatistics payoffs(strike, std::exp(-p[0] * tenor));
+            vt.simulate_vt_levels_parallel(payoffs, num_samples);
+            return payoffs.statistics().mean();
+        };
+
+        std::vector<double> adjoints;
+        std::vector<double> adjoint_stderrs;
+        std::vector<double> finite_differences;
+        for (const double lamb : lamb_vec)
+        {
+            const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+            const VolatilityTarget vt(sde, lamb, num_time_steps, target_volatility, tenor, init_var, init_vt_level);
+            const CallGradient gradient = vt.simulate_call_gradient_parallel(strike, num_samples);
+            const std::vector<const RunningStatistics*> derivatives {
+                &gradient.discount_rate, &gradient.repo_rate, &gradient.volatility, &gradient.lambda,
+                &gradient.target_volatility, &gradient.init_var, &gradient.init_level
+            };
+            const std::vector<double> base { discount_rate, repo_rate, volatility, lamb, target_volatility, init_var, init_vt_level };
+            for (size_t i_param = 0; i_param < parameters.size(); ++i_param)
+            {
+                std::vector<double> up = base;
+                std::vector<double> down = base;
+                up[i_param] += bump;
+                down[i_param] -= bump;
+                const double finite_difference = (call_price(up) - call_price(down)) / (2.0 * bump);
+                const double adjoint = derivatives[i_param]->mean();
+                ASSERT(
+                    std::abs(adjoint - finite_difference) < 1e-3 * (1.0 + std::abs(finite_difference)),
+                    "adjoint " + parameters[i_param] + " derivative must match the finite difference"
+                );
+
+                adjoints.push_back(adjoint);
+                adjoint_stderrs.push_back(derivatives[i_param]->standard_error());
+                finite_differences.push_back(finite_difference);
+                std::cout << "lamb=" << lamb << ", parameter=" << parameters[i_param] << ", adjoint=" << adjoint
+                    << ", adjoint_stderr=" << adjoint_stderrs.back() << ", finite_difference=" << finite_difference << std::endl;
+            }
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_call_gradient.csv");
+        outfile << "lambda,parameter,adjoint,adjoint_stderr,finite_difference\n";
+        for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+        {
+            for (size_t i_param = 0; i_param < parameters.size(); ++i_param)
+            {
+                const size_t i = i_lamb * parameters.size() + i_param;
+                outfile << lamb_vec[i_lamb] << "," << parameters[i_param] << "," << adjoints[i] << ","
+                    << adjoint_stderrs[i] << "," << finite_differences[i] << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_call_gradient");
+    }
+
+    void test_vt_pricing_control_variate(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_pricing_control_variate");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+
+        const std::vector<size_t> num_time_steps { 1000, 5000 };
+        std::vector<double> lamb_vec;
+        double lamb = 0.7;
+        while (lamb < 1.0)
+        {
+            lamb_vec.push_back(lamb);
+            lamb += 0.05;
+        }
+        if (lamb_vec.back() < 0.97)
+            lamb_vec.push_back(0.97);
+        const std::vector<bool> antithetic_vec { false, true };
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        std::vector<ControlVariatePrice> prices;
+        std::vector<ControlVariatePrice> tolerance_prices;
+        std::vector<double> plain_paths_needed;
+        for (const size_t num_steps : num_time_steps)
+        {
+            for (const double lamb : lamb_vec)
+            {
+                const VolatilityTarget vt(sde, lamb, num_steps, target_volatility, tenor, init_var, init_vt_level);
+                for (const bool antithetic : antithetic_vec)
+                {
+                    const ControlVariatePrice price = vt.simulate_call_price_cv(init_vt_level, num_samples, antithetic);
+                    ASSERT(
+                        std::abs(price.price - price.plain_price) < 4.0 * price.plain_standard_error,
+                        "control variate and plain prices must agree"
+                    );
+                    ASSERT(price.variance_reduction() > 1.0, "the control variate must reduce the variance");
+
+                    // Half the plain standard error, which plain Monte Carlo reaches with 4 times the paths.
+                    const double target_standard_error = 0.5 * price.plain_standard_error;
+                    const double plain_paths = price.plain_standard_error * price.plain_standard_error * price.num_paths
+                        / (target_standard_error * target_standard_error);
+                    const ControlVariatePrice tolerance_price = vt.simulate_call_price_cv_to_tolerance(
+                        init_vt_level, target_standard_error, 4 * num_samples, antithetic
+                    );
+                    ASSERT(tolerance_price.standard_error <= target_standard_error, "the target standard error must be reached");
+                    ASSERT(tolerance_price.num_paths < 0.5 * plain_paths, "the control variate must need fewer paths");
+
+                    prices.push_back(price);
+                    tolerance_prices.push_back(tolerance_price);
+                    plain_paths_needed.push_back(plain_paths);
+                    std::cout << "N=" << num_steps << ", lamb=" << lamb << ", antithetic=" << antithetic
+                        << ", plain_price=" << price.plain_price << ", plain_stderr=" << price.plain_standard_error
+                        << ", cv_price=" << price.price << ", cv_stderr=" << price.standard_error
+                        << ", variance_reduction=" << price.variance_reduction()
+                        << ", target_stderr=" << target_standard_error << ", tolerance_cv_stderr=" << tolerance_price.standard_error
+                        << ", tolerance_num_paths=" << tolerance_price.num_paths << ", plain_num_paths=" << plain_paths << std::endl;
+                }
+            }
+        }
+
+        // A target that cannot be reached stops at max_samples samples.
+        const VolatilityTarget capped_vt(sde, lamb_vec[0], num_time_steps[0], target_volatility, tenor, init_var, init_vt_level);
+        const size_t max_samples = num_samples / 10;
+        const ControlVariatePrice capped_price = capped_vt.simulate_call_price_cv_to_tolerance(init_vt_level, 1e-9, max_samples, false);
+        ASSERT(capped_price.num_paths == max_samples, "max_samples must cap the number of paths");
+        std::cout << "max_samples=" << max_samples << ", capped_num_paths=" << capped_price.num_paths
+            << ", capped_cv_stderr=" << capped_price.standard_error << std::endl;
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_pricing_control_variate.csv");
+        outfile << "N,lambda,antithetic,plain_price,plain_stderr,cv_price,cv_stderr,beta,variance_reduction,"
+            << "target_stderr,tolerance_cv_stderr,tolerance_num_paths,plain_num_paths\n";
+        for (size_t i_num_step = 0; i_num_step < num_time_steps.size(); ++i_num_step)
+        {
+            for (size_t i_lamb = 0; i_lamb < lamb_vec.size(); ++i_lamb)
+            {
+                for (size_t i_anti = 0; i_anti < antithetic_vec.size(); ++i_anti)
+                {
+                    const size_t i = (i_num_step * lamb_vec.size() + i_lamb) * antithetic_vec.size() + i_anti;
+                    const ControlVariatePrice& price = prices[i];
+                    const ControlVariatePrice& tolerance_price = tolerance_prices[i];
+                    outfile << num_time_steps[i_num_step] << "," << lamb_vec[i_lamb] << "," << antithetic_vec[i_anti] << ","
+                        << price.plain_price << "," << price.plain_standard_error << "," << price.price << ","
+                        << price.standard_error << "," << price.beta << "," << price.variance_reduction() << ","
+                        << 0.5 * price.plain_standard_error << "," << tolerance_price.standard_error << ","
+                        << tolerance_price.num_paths << "," << plain_paths_needed[i] << "\n";
+                }
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_vt_pricing_control_variate");
+    }
+
+    void test_simd_dispatch(const size_t num_samples)
+    {
+        BEGIN_TEST("test_simd_dispatch");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+        const size_t num_time_steps = 1000;
+        // Sizes that are not multiples of MAX_SIMD_WIDTH, so that the remainders are compared too.
+        const size_t size = 1003;
+
+        const std::vector<double> lamb_vec { 0.7, 0.8, 0.9, 0.95 };
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        const HestonPtr heston = Heston::create(discount_rate, repo_rate, 2.0, 0.25, 0.5, -0.7, 0.25, init_stock_level);
+        const VolatilityTargetSweep sweep = lambda_sweep(sde, lamb_vec, num_time_steps, target_volatility, tenor, init_var, init_vt_level);
+        const VolatilityTarget& vt = sweep.target(0);
+        const BlackScholesVolatilityTarget model_vt(*sde, lamb_vec[0], num_time_steps, target_volatility, tenor, init_var, init_vt_level);
+        const HestonVolatilityTarget heston_vt(*heston, lamb_vec[0], num_time_steps, target_volatility, tenor, init_var, init_vt_level);
+        const QPochhammer q_pochhammer(0.5);
+
+        std::vector<double> uniforms(size);
+        std::vector<double> strikes(size);
+        std::vector<double> tenors(size);
+        std::vector<double> lambdas(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            uniforms[i] = (i + 0.5) / size;
+            strikes[i] = 0.5 + uniforms[i];
+            tenors[i] = 0.1 + 2.0 * uniforms[(7 * i) % size];
+            lambdas[i] = 0.05 + 0.94 * uniforms[i];
+        }
+        std::vector<double> forwards(size);
+        std::vector<double> total_vols(size);
+        std::vector<double> discount_factors(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            forwards[i] = init_stock_level * std::exp((discount_rate - repo_rate) * tenors[i]);
+            total_vols[i] = volatility * std::sqrt(tenors[i]);
+            discount_factors[i] = std::exp(-discount_rate * tenors[i]);
+        }
+
+        // Outputs of the library functions that dispatch to each kernel, run with the kernels in use.
+        const std::vector<std::string> kernels {
+            "normals_from_bits", "inverse_normal_cdf", "q_pochhammer_log+exp", "black_prices", "black_strike_prices",
+            "black_scholes_greeks", "limit_multipliers", "advance_vt_lanes", "advance_vt_sweep", "advance_vt_derivatives",
+            "lognormal_returns+advance_vt_returns", "advance_heston_lanes+advance_vt_returns",
+            "black_scholes_implied_volatilities"
+        };
+        auto kernel_outputs = [&]() {
+            std::vector<std::vector<double>> outputs(kernels.size());
+
+            outputs[0].resize(size);
+            PathNormalGenerator().generate(0, 0, outputs[0].data(), size);
+
+            SobolGenerator sobol(SobolGenerator::MAX_DIMENSION, true);
+            outputs[1].resize(SobolGenerator::MAX_DIMENSION * 64);
+            for (size_t i = 0; i < 64; ++i)
+                sobol.next_normals(outputs[1].data() + i * SobolGenerator::MAX_DIMENSION);
+
+            std::vector<double> a(size);
+            for (size_t i = 0; i < size; ++i)
+                a[i] = 2.0 * uniforms[i] - 1.0;
+            outputs[2].resize(2 * size);
+            q_pochhammer.evaluate_log(a.data(), outputs[2].data(), size);
+            q_pochhammer.evaluate(a.data(), outputs[2].data() + size, size);
+
+            outputs[3].resize(2 * size);
+            black_call_prices(forwards.data(), strikes.data(), total_vols.data(), discount_factors.data(), outputs[3].data(), size);
+            black_put_prices(forwards.data(), strikes.data(), total_vols.data(), discount_factors.data(), outputs[3].data() + size, size);
+
+            sde->get_call_price_surface(strikes, std::vector<double>(tenors.begin(), tenors.begin() + 11), outputs[4]);
+
+            std::vector<BlackScholesGreeks> greeks(size);
+            sde->get_call_greeks(strikes.data(), tenors.data(), greeks.data(), size);
+            const double* greek_values = reinterpret_cast<const double*>(greeks.data());
+            outputs[5].assign(greek_values, greek_values + size * sizeof(BlackScholesGreeks) / sizeof(double));
+
+            outputs[6].resize(2 * size);
+            limit_multipliers().evaluate(lambdas.data(), outputs[6].data(), outputs[6].data() + size, size);
+
+            vt.simulate_vt_levels_batch(outputs[7], num_samples);
+
+            outputs[8].resize(num_samples * sweep.size());
+            StandardNormalGenerator rng;
+            for (size_t i = 0; i < num_samples; ++i)
+                sweep.simulate_vt_levels(outputs[8].data() + i * sweep.size(), rng);
+
+            for (const CallSensitivities& sensitivities : sweep.simulate_call_sensitivities(init_vt_level, num_samples))
+            {
+                for (const RunningStatistics* stats : { &sensitivities.price, &sensitivities.vega, &sensitivities.rho, &sensitivities.delta })
+                    outputs[9].push_back(stats->mean());
+            }
+
+            model_vt.simulate_vt_levels_batch(outputs[10], num_samples);
+
+            heston_vt.simulate_vt_levels_batch(outputs[11], num_samples);
+
+            outputs[12].resize(2 * size);
+            sde->get_call_implied_volatilities(outputs[3].data(), strikes.data(), tenors.data(), outputs[12].data(), size);
+            sde->get_put_implied_volatilities(outputs[3].data() + size, strikes.data(), tenors.data(), outputs[12].data() + size, size);
+            return outputs;
+        };
+
+        // Every available variant against the scalar reference, bit for bit.
+        const SimdIsa initial_isa = simd_isa();
+        set_simd_isa(SimdIsa::SCALAR);
+        const std::vector<std::vector<double>> scalar_outputs = kernel_outputs();
+        std::vector<std::string> isas;
+        std::vector<size_t> num_values;
+        std::vector<size_t> num_differences;
+        for (const SimdIsa isa : { SimdIsa::AVX2, SimdIsa::AVX512 })
+        {
+            if (!simd_isa_available(isa))
+            {
+                std::cout << "isa=" << simd_isa_name(isa) << " is not available, skipped" << std::endl;
+                continue;
+            }
+            set_simd_isa(isa);
+            const std::vector<std::vector<double>> outputs = kernel_outputs();
+            for (size_t k = 0; k < kernels.size(); ++k)
+            {
+                ASSERT(outputs[k].size() == scalar_outputs[k].size(), kernels[k] + " must give as many values as the scalar kernels");
+                size_t num_different = 0;
+                for (size_t i = 0; i < outputs[k].size(); ++i)
+                {
+                    if (std::memcmp(&outputs[k][i], &scalar_outputs[k][i], sizeof(double)) != 0)
+                        ++num_different;
+                }
+                isas.push_back(simd_isa_name(isa));
+                num_values.push_back(outputs[k].size());
+                num_differences.push_back(num_different);
+                std::cout << "isa=" << isas.back() << ", kernel=" << kernels[k] << ", num_values=" << num_values.back()
+                    << ", num_differences=" << num_different << std::endl;
+            }
+        }
+        set_simd_isa(initial_isa);
+        for (size_t i = 0; i < num_differences.size(); ++i)
+            ASSERT(num_differences[i] == 0, isas[i] + " " + kernels[i % kernels.size()] + " must give the bits of the scalar kernels");
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_simd_dispatch.csv");
+        outfile << "isa,kernel,num_values,num_differences\n";
+        for (size_t i = 0; i < num_differences.size(); ++i)
+            outfile << isas[i] << "," << kernels[i % kernels.size()] << "," << num_values[i] << "," << num_differences[i] << "\n";
+        outfile.close();
+
+        END_TEST("test_simd_dispatch");
+    }
+
+    void test_vt_parallel_reproducibility(const size_t num_samples)
+    {
+        BEGIN_TEST("test_vt_parallel_reproducibility");
+
+        const double discount_rate = 0.05;
+        const double rho = 0.03;
+        const double volatility = 0.5;
+        const double target_volatility = 0.2;
+        const double tenor = 1.0;
+        const double init_var = 0.02;
+        const double init_stock_level = 1.0;
+        const double init_vt_level = 1.0;
+        const double repo_rate = discount_rate - rho;
+        const size_t num_time_steps = 1000;
+        const double lamb = 0.9;
+
+        const std::vector<size_t> num_threads_vec { 1, 2, 3, 7, 16 };
+
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, volatility, init_stock_level);
+        const VolatilityTarget vt(sde, lamb, num_time_steps, target_volatility, tenor, init_var, init_vt_level);
+        const std::vector<double> dtimes(num_time_steps, tenor / num_time_steps);
+
+        // Levels, accumulated statistics and stock levels of the same seed must be the same bits for every num_threads.
+        auto same_bits = [](const double x, const double y) { return std::memcmp(&x, &y, sizeof(double)) == 0; };
+        std::vector<double> ref_vt_levels;
+        std::vector<double> ref_stock_levels;
+        RunningStatistics ref_stats;
+        std::vector<size_t> num_vt_differences;
+        std::vector<size_t> num_stock_differences;
+        std::vector<bool> same_statistics;
+        for (const size_t num_threads : num_threads_vec)
+        {
+            std::vector<double> vt_levels;
+            std::vector<double> stock_levels;
+            LogLevelStatistics log_levels(init_vt_level);
+            vt.simulate_vt_levels_parallel(vt_levels, num_samples, num_threads);
+            vt.simulate_vt_levels_parallel(log_levels, num_samples, num_threads);
+            sde->simulate_stock_levels_parallel(stock_levels, dtimes, num_samples, num_threads);
+            if (num_threads == num_threads_vec.front())
+            {
+                ref_vt_levels = vt_levels;
+                ref_stock_levels = stock_levels;
+                ref_stats = log_levels.statistics();
+            }
+
+            size_t num_vt_different = 0;
+            size_t num_stock_different = 0;
+            for (size_t i = 0; i < num_samples; ++i)
+            {
+                if (!same_bits(vt_levels[i], ref_vt_levels[i]))
+                    ++num_vt_different;
+                if (!same_bits(stock_levels[i], ref_stock_levels[i]))
+                    ++num_stock_different;
+            }
+            const RunningStatistics& stats = log_levels.statistics();
+            const bool same_stats = stats.count() == ref_stats.count() && same_bits(stats.mean(), ref_stats.mean())
+                && same_bits(stats.variance(), ref_stats.variance());
+            ASSERT(num_vt_different == 0 && num_stock_different == 0 && same_stats, "results must not depend on num_threads");
+
+            num_vt_differences.push_back(num_vt_different);
+            num_stock_differences.push_back(num_stock_different);
+            same_statistics.push_back(same_stats);
+            std::cout << "num_threads=" << num_threads << ", num_vt_differences=" << num_vt_different
+                << ", num_stock_differences=" << num_stock_different << ", same_statistics=" << same_stats << std::endl;
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_vt_parallel_reproducibility.csv");
+        outfile << "num_threads,num_vt_differences,num_stock_differences,same_statistics\n";
+        for (size_t i = 0; i < num_threads_vec.size(); ++i)
+            outfile << num_threads_vec[i] << "," << num_vt_differences[i] << "," << num_stock_differences[i] << ","
+                << same_statistics[i] << "\n";
+        outfile.close();
+
+        END_TEST("test_vt_parallel_reproducibility");
+    }
+
+    void test_integrate_adaptive()
+    {
+        BEGIN_TEST("test_integrate_adaptive");
+
+        // PI has 12 digits, too few for the exact values.
+        const double pi = 4.0 * std::atan(1.0);
+        struct Integral
+        {
+            std::string name;
+            Function f;
+            double a;
+            double b;
+            double exact;
+        };
+        const std::vector<Integral> integrals {
+            { "gaussian", [](const double x) { return std::exp(-0.5 * x * x); }, 0.0, INF, std::sqrt(0.5 * pi) },
+            { "cauchy", [](const double x) { return 1.0 / (1.0 + x * x); }, 0.0, INF, 0.5 * pi },
+            { "cauchy", [](const double x) { return 1.0 / (1.0 + x * x); }, 0.0, 1.0, 0.25 * pi },
+            { "sqrt", [](const double x) { return std::sqrt(x); }, 0.0, 1.0, 2.0 / 3.0 }
+        };
+        // The default budget, and one too small for the default tolerance, which must then be reported.
+        const std::vector<size_t> max_intervals_vec { 100, 2 };
+
+        std::vector<QuadratureResult> results;
+        for (const Integral& integral : integrals)
+        {
+            for (const size_t max_intervals : max_intervals_vec)
+            {
+                const QuadratureResult result = integrate_adaptive(integral.f, integral.a, integral.b, 1e-10, 1e-10, max_intervals);
+                const double actual_error = std::abs(result.value - integral.exact);
+                ASSERT(actual_error <= result.error, "the error must be within the reported bound");
+                ASSERT(result.converged == (result.error <= 1e-10 * std::max(1.0, std::abs(result.value))), "converged must match the tolerance");
+                if (max_intervals == max_intervals_vec.front())
+                    ASSERT(result.converged, "the default budget must be enough");
+
+                results.push_back(result);
+                std::cout << "integrand=" << integral.name << ", b=" << integral.b << ", max_intervals=" << max_intervals
+                    << ", value=" << result.value << ", error=" << result.error << ", actual_error=" << actual_error
+                    << ", num_evaluations=" << result.num_evaluations << ", converged=" << result.converged << std::endl;
+            }
+        }
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_integrate_adaptive.csv");
+        outfile << "integrand,a,b,max_intervals,value,exact,error,actual_error,num_evaluations,converged\n";
+        for (size_t i = 0; i < integrals.size(); ++i)
+        {
+            for (size_t j = 0; j < max_intervals_vec.size(); ++j)
+            {
+                const Integral& integral = integrals[i];
+                const QuadratureResult& result = results[i * max_intervals_vec.size() + j];
+                outfile << integral.name << "," << integral.a << "," << integral.b << "," << max_intervals_vec[j] << ","
+                    << result.value << "," << integral.exact << "," << result.error << ","
+                    << std::abs(result.value - integral.exact) << "," << result.num_evaluations << "," << result.converged << "\n";
+            }
+        }
+        outfile.close();
+
+        END_TEST("test_integrate_adaptive");
+    }
+
+    void test_limit_multipliers()
+    {
+        BEGIN_TEST("test_limit_multipliers");
+
+        const LimitMultipliers& multipliers = limit_multipliers();
+        const size_t num_nodes = multipliers.num_nodes();
+        const double u_scale = -2.0 / std::log(multipliers.lambda_min());
+
+        // Midpoints between consecutive Chebyshev nodes, where the interpolation error is largest, and lambdas near 1.
+        std::vector<double> lamb_vec;
+        for (size_t k = 0; k + 1 < num_nodes; ++k)
+        {
+            const double x = 0.5 * (std::cos(PI * k / (num_nodes - 1)) + std::cos(PI * (k + 1) / (num_nodes - 1)));
+            lamb_vec.push_back(std::exp(-(x + 1.0) / u_scale));
+        }
+        for (const double eps : { 1e-3, 1e-4, 1e-5, 1e-6 })
+            lamb_vec.push_back(1.0 - eps);
+
+        std::vector<double> us(lamb_vec.size());
+        std::vector<double> vs(lamb_vec.size());
+        multipliers.evaluate(lamb_vec.data(), us.data(), vs.data(), lamb_vec.size());
+
+        std::vector<double> u_errors;
+        std::vector<double> v_errors;
+        double max_error = 0.0;
+        for (size_t i = 0; i < lamb_vec.size(); ++i)
+        {
+            const double u_error = std::abs(us[i] / multiplier_U(lamb_vec[i]) - 1.0);
+            const double v_error = std::abs(vs[i] / multiplier_V(lamb_vec[i]) - 1.0);
+            ASSERT(us[i] == multipliers.U(lamb_vec[i]) && vs[i] == multipliers.V(lamb_vec[i]), "evaluate must match U and V");
+            u_errors.push_back(u_error);
+            v_errors.push_back(v_error);
+            max_error = std::max(max_error, std::max(u_error, v_error));
+            std::cout << "lambda=" << lamb_vec[i] << ", U=" << us[i] << ", V=" << vs[i] << ", U_relative_error=" << u_error
+                << ", V_relative_error=" << v_error << std::endl;
+        }
+        std::cout << "max_relative_error=" << max_error << std::endl;
+        ASSERT(max_error < 2e-11, "the table must match the quadratures to about 1e-11");
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_limit_multipliers.csv");
+        outfile << "lambda,U,V,U_relative_error,V_relative_error\n";
+        for (size_t i = 0; i < lamb_vec.size(); ++i)
+            outfile << lamb_vec[i] << "," << us[i] << "," << vs[i] << "," << u_errors[i] << "," << v_errors[i] << "\n";
+        outfile.close();
+
+        END_TEST("test_limit_multipliers");
+    }
+
+    void test_implied_volatility()
+    {
+        BEGIN_TEST("test_implied_volatility");
+
+        const double discount_rate = 0.05;
+        const double repo_rate = 0.02;
+        const double init_stock_level = 1.0;
+
+        const std::vector<double> vol_vec { 0.01, 0.03, 0.1, 0.2, 0.5, 1.0, 2.0, 4.0 };
+        const std::vector<double> strike_vec { 0.25, 0.5, 0.8, 0.95, 1.0, 1.05, 1.25, 2.0, 4.0 };
+        const std::vector<double> tenor_vec { 0.01, 0.1, 0.5, 1.0, 5.0 };
+        // Batches of odd sizes, so that every lane position and the remainders are used.
+        const std::vector<size_t> batch_sizes { 1, 3, 5, 7, 11, 13 };
+        const BlackScholesPtr sde = BlackScholes::create(discount_rate, repo_rate, vol_vec[0], init_stock_level);
+
+        std::vector<bool> calls;
+        std::vector<double> vols;
+        std::vector<double> strikes;
+        std::vector<double> tenors;
+        std::vector<double> prices;
+        std::vector<double> implied_vols;
+        std::vector<double> errors;
+        std::vector<double> tolerances;
+        for (const bool call : { true, false })
+        {
+            std::vector<double> type_vols;
+            std::vector<double> type_strikes;
+            std::vector<double> type_tenors;
+            std::vector<double> type_prices;
+            std::vector<double> type_vegas;
+            for (const double vol : vol_vec)
+            {
+                const BlackScholesPtr vol_sde = BlackScholes::create(discount_rate, repo_rate, vol, init_stock_level);
+                for (const double strike : strike_vec)
+                {
+                    for (const double tenor : tenor_vec)
+                    {
+                        type_vols.push_back(vol);
+                        type_strikes.push_back(strike);
+                        type_tenors.push_back(tenor);
+                        type_prices.push_back(call ? vol_sde->get_call_price(strike, tenor) : vol_sde->get_put_price(strike, tenor));
+                        type_vegas.push_back(vol_sde->get_vega(strike, tenor));
+                    }
+                }
+            }
+
+            const size_t size = type_prices.size();
+            std::vector<double> type_implied_vols(size);
+            if (call)
+                sde->get_call_implied_volatilities(type_prices.data(), type_strikes.data(), type_tenors.data(), type_implied_vols.data(), size);
+            else
+                sde->get_put_implied_volatilities(type_prices.data(), type_strikes.data(), type_tenors.data(), type_implied_vols.data(), size);
+
+            // Each lane converges on its own, so the batch sizes and the scalar function give the same bits.
+            std::vector<double> batch_implied_vols(size);
+            size_t begin = 0;
+            for (size_t i_batch = 0; begin < size; ++i_batch)
+            {
+                const size_t batch_size = std::min(batch_sizes[i_batch % batch_sizes.size()], size - begin);
+                if (call)
+                    sde->get_call_implied_volatilities(&type_prices[begin], &type_strikes[begin], &type_tenors[begin], &batch_implied_vols[begin], batch_size);
+                else
+                    sde->get_put_implied_volatilities(&type_prices[begin], &type_strikes[begin], &type_tenors[begin], &batch_implied_vols[begin], batch_size);
+                begin += batch_size;
+            }
+            ASSERT(std::memcmp(batch_implied_vols.data(), type_implied_vols.data(), size * sizeof(double)) == 0, "batch sizes must not change the volatilities");
+
+            for (size_t i = 0; i < size; ++i)
+            {
+                const double implied_vol = call
+                    ? sde->get_call_implied_volatility(type_prices[i], type_strikes[i], type_tenors[i])
+                    : sde->get_put_implied_volatility(type_prices[i], type_strikes[i], type_tenors[i]);
+                ASSERT(std::memcmp(&implied_vol, &type_implied_vols[i], sizeof(double)) == 0, "the scalar and batch volatilities must be the same");
+
+                // The documented accuracy, away from the prices that are at the bounds in floating point, e.g. those
+                // that underflow: 1e-12 relative plus the effect of a relative price error of 1e-14, which is large with
+                // little time value in the money and near the upper bound.
+                const double discount_factor = std::exp(-discount_rate * type_tenors[i]);
+                const double forward = init_stock_level * std::exp((discount_rate - repo_rate) * type_tenors[i]);
+                const double intrinsic = discount_factor * std::max(call ? forward - type_strikes[i] : type_strikes[i] - forward, 0.0);
+                const double upper_bound = discount_factor * (call ? forward : type_strikes[i]);
+                const bool inside = type_prices[i] - intrinsic > 1e-300 && upper_bound - type_prices[i] > 1e-300;
+                const double error = std::abs(type_implied_vols[i] / type_vols[i] - 1.0);
+                const double tolerance = inside ? 1e-12 + 1e-14 * type_prices[i] / (type_vegas[i] * type_vols[i]) : INF;
+                ASSERT(error <= tolerance, "the implied volatility must be within the documented tolerance");
+
+                calls.push_back(call);
+                vols.push_back(type_vols[i]);
+                strikes.push_back(type_strikes[i]);
+                tenors.push_back(type_tenors[i]);
+                prices.push_back(type_prices[i]);
+                implied_vols.push_back(type_implied_vols[i]);
+                errors.push_back(error);
+                tolerances.push_back(tolerance);
+            }
+        }
+
+        // Prices at or below the intrinsic value give 0, at or above the upper bound INF.
+        size_t num_bound_checks = 0;
+        for (const double strike : strike_vec)
+        {
+            for (const double tenor : tenor_vec)
+            {
+                const double discount_factor = std::exp(-discount_rate * tenor);
+                const double forward = init_stock_level * std::exp((discount_rate - repo_rate) * tenor);
+                const double call_intrinsic = discount_factor * std::max(forward - strike, 0.0);
+                const double put_intrinsic = discount_factor * std::max(strike - forward, 0.0);
+                ASSERT(sde->get_call_implied_volatility(0.5 * call_intrinsic, strike, tenor) == 0.0, "below the intrinsic value must give 0");
+                ASSERT(sde->get_put_implied_volatility(0.5 * put_intrinsic, strike, tenor) == 0.0, "below the intrinsic value must give 0");
+                ASSERT(sde->get_call_implied_volatility(discount_factor * forward, strike, tenor) == INF, "the upper bound must give INF");
+                ASSERT(sde->get_put_implied_volatility(discount_factor * strike, strike, tenor) == INF, "the upper bound must give INF");
+                ASSERT(sde->get_call_implied_volatility(2.0 * discount_factor * forward, strike, tenor) == INF, "above the upper bound must give INF");
+                ASSERT(sde->get_put_implied_volatility(2.0 * discount_factor * strike, strike, tenor) == INF, "above the upper bound must give INF");
+                num_bound_checks += 6;
+            }
+        }
+
+        double max_relative_error = 0.0;
+        size_t num_within_1e13 = 0;
+        for (size_t i = 0; i < errors.size(); ++i)
+        {
+            if (tolerances[i] < 2e-12)
+                max_relative_error = std::max(max_relative_error, errors[i]);
+            if (errors[i] <= 1e-13)
+                ++num_within_1e13;
+        }
+        std::cout << "num_options=" << errors.size() << ", num_within_1e-13=" << num_within_1e13
+            << ", max_relative_error_well_conditioned=" << max_relative_error << ", num_bound_checks=" << num_bound_checks << std::endl;
+
+        std::ofstream outfile;
+        outfile.open(root_dir() + "/tests/test_implied_volatility.csv");
+        outfile << "option,volatility,strike,tenor,price,implied_volatility,relative_error,tolerance\n";
+        for (size_t i = 0; i < errors.size(); ++i)
+        {
+            outfile << (calls[i] ? "call" : "put") << "," << vols[i] << "," << strikes[i] << "," << tenors[i] << ","
+                << prices[i] << "," << implied_vols[i] << "," << errors[i] << "," << tolerances[i] << "\n";
+        }
+        outfile.close();
+
+        END_TEST("test_implied_volatility");
+    }
+
+}
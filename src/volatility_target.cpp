@@ -1,100 +1,884 @@
-#include <volatility_target.hpp>
-#include <random_number_generator.hpp>
-#include <cmath>
-
-namespace cltvt
-{
-    VolatilityTarget::VolatilityTarget(
-        const BlackScholesPtr& sde,
-        const double lamb,
-        const size_t num_time_steps,
-        const double target_volatility,
-        const double tenor,
-        const double init_var,
-        const double init_level
-    )
-        :
-        m_sde(sde),
-        m_lamb(lamb),
-        m_num_time_steps(num_time_steps),
-        m_target_vol(target_volatility),
-        m_tenor(tenor),
-        m_init_var(init_var),
-        m_init_level(init_level),
-        m_dt(tenor / num_time_steps)
-    {
-        ASSERT(m_lamb > 0.0 && m_lamb < 1.0, "0.0 < lamb < 1.0 must be true (lamb=" + std::to_string(m_lamb) + ")");
-        ASSERT(m_target_vol > 0.0, "target_volatility must be positive");
-        ASSERT(m_tenor > 0.0, "tenor must be positive");
-        ASSERT(m_num_time_steps > 1, "num_time_steps > 1 must be true");
-        ASSERT(m_init_var > 1e-12, "init_var must be positive");
-        ASSERT(m_init_level > 1e-12, "init_level must be positive");
-    }
-
-    double VolatilityTarget::lambda() const
-    {
-        return m_lamb;
-    }
-
-    double VolatilityTarget::target_volatility() const
-    {
-        return m_target_vol;
-    }
-
-    double VolatilityTarget::tenor() const
-    {
-        return m_tenor;
-    }
-
-    double VolatilityTarget::init_var() const
-    {
-        return m_init_var;
-    }
-
-    double VolatilityTarget::init_level() const
-    {
-        return m_init_level;
-    }
-
-    size_t VolatilityTarget::num_time_steps() const
-    {
-        return m_num_time_steps;
-    }
-
-    double VolatilityTarget::rebalance_time_step() const
-    {
-        return m_dt;
-    }
-
-    double VolatilityTarget::compute_vt_level(const std::vector<double>& stock_path) const
-    {
-        ASSERT(stock_path.size() == m_num_time_steps + 1, "stock_path size should be num_time_step + 1");
-        double level = m_init_level;
-        double var = m_init_var;
-        for (size_t i = 1; i < stock_path.size(); ++i)
-        {
-            const double ret = stock_path[i] / stock_path[i - 1] - 1.0;
-            const double w = m_target_vol / std::sqrt(var);
-            level *= 1.0 + (1.0 - w) * m_sde->discount_rate() * m_dt + w * ret;
-            var = m_lamb * var + (1.0 - m_lamb) * ret * ret / m_dt;
-        }
-        return level;
-    }
-
-    void VolatilityTarget::simulate_vt_levels(std::vector<double>& vt_levels, const size_t num_samples, const size_t seed) const
-    {
-        vt_levels.resize(0);
-        vt_levels.reserve(num_samples);
-        StandardNormalGenerator rng(seed);
-        const std::vector<double> dtimes(m_num_time_steps, m_dt);
-        std::vector<double> random_normals;
-        std::vector<double> stock_path;
-        for (size_t i = 0; i < num_samples; ++i)
-        {
-            rng.populate_standard_normals(random_normals, m_num_time_steps);
-            m_sde->populate_path(stock_path, dtimes, random_normals);
-            const double level = compute_vt_level(stock_path);
-            vt_levels.push_back(level);
-        }
-    }
+#include <volatility_target.hpp>
+#include <random_number_generator.hpp>
+#include <parallel.hpp>
+#include <statistics.hpp>
+#include <dispatch.hpp>
+#include <instrumentation.hpp>
+#include <cmath>
+#include <algorithm>
+
+namespace cltvt
+{
+    namespace
+    {
+        const size_t BATCH_STEPS = 64;
+
+        // Stock returns of num_steps steps and their derivatives with respect to the volatility (first num_steps values
+        // of d_rets) and the discount rate (next num_steps values).
+        void stock_returns(
+            const BlackScholes& sde,
+            const double dt,
+            const double* normals,
+            const size_t num_steps,
+            double* rets,
+            double* d_rets
+        )
+        {
+            const double vol = sde.volatility();
+            const double drift_dt = (sde.discount_rate() - sde.repo_rate() - 0.5 * vol * vol) * dt;
+            const double sqrt_dt = std::sqrt(dt);
+            const double vol_sqrt_dt = vol * sqrt_dt;
+            for (size_t i = 0; i < num_steps; ++i)
+            {
+                rets[i] = std::expm1(drift_dt + vol_sqrt_dt * normals[i]);
+                d_rets[i] = (1.0 + rets[i]) * (sqrt_dt * normals[i] - vol * dt);
+                d_rets[num_steps + i] = (1.0 + rets[i]) * dt;
+            }
+        }
+
+        void add_call_sample(
+            CallSensitivities& sensitivities,
+            const PathwiseLevel& path,
+            const double strike,
+            const double discount_factor,
+            const double tenor
+        )
+        {
+            const double in_the_money = path.level > strike ? discount_factor : 0.0;
+            const double price = in_the_money * (path.level - strike);
+            sensitivities.price.add(price);
+            sensitivities.vega.add(in_the_money * path.d_volatility);
+            sensitivities.rho.add(in_the_money * path.d_discount_rate - tenor * price);
+            sensitivities.delta.add(in_the_money * path.d_init_level);
+        }
+
+        struct ControlVariateSamples
+        {
+            RunningCovariance samples;
+            RunningStatistics paths;
+        };
+    }
+
+    void CallGradient::merge(const CallGradient& other)
+    {
+        price.merge(other.price);
+        discount_rate.merge(other.discount_rate);
+        repo_rate.merge(other.repo_rate);
+        volatility.merge(other.volatility);
+        lambda.merge(other.lambda);
+        target_volatility.merge(other.target_volatility);
+        init_var.merge(other.init_var);
+        init_level.merge(other.init_level);
+    }
+
+    double ControlVariatePrice::variance_reduction() const
+    {
+        return (plain_standard_error * plain_standard_error) / (standard_error * standard_error);
+    }
+
+    VolatilityTarget::VolatilityTarget(
+        const BlackScholesPtr& sde,
+        const double lamb,
+        const size_t num_time_steps,
+        const double target_volatility,
+        const double tenor,
+        const double init_var,
+        const double init_level
+    )
+        :
+        m_sde(sde),
+        m_lamb(lamb),
+        m_num_time_steps(num_time_steps),
+        m_target_vol(target_volatility),
+        m_tenor(tenor),
+        m_init_var(init_var),
+        m_init_level(init_level),
+        m_dt(tenor / num_time_steps)
+    {
+        ASSERT(m_lamb > 0.0 && m_lamb < 1.0, "0.0 < lamb < 1.0 must be true (lamb=" + std::to_string(m_lamb) + ")");
+        ASSERT(m_target_vol > 0.0, "target_volatility must be positive");
+        ASSERT(m_tenor > 0.0, "tenor must be positive");
+        ASSERT(m_num_time_steps > 1, "num_time_steps > 1 must be true");
+        ASSERT(m_init_var > 1e-12, "init_var must be positive");
+        ASSERT(m_init_level > 1e-12, "init_level must be positive");
+    }
+
+    const BlackScholesPtr& VolatilityTarget::sde() const
+    {
+        return m_sde;
+    }
+
+    double VolatilityTarget::lambda() const
+    {
+        return m_lamb;
+    }
+
+    double VolatilityTarget::target_volatility() const
+    {
+        return m_target_vol;
+    }
+
+    double VolatilityTarget::tenor() const
+    {
+        return m_tenor;
+    }
+
+    double VolatilityTarget::init_var() const
+    {
+        return m_init_var;
+    }
+
+    double VolatilityTarget::init_level() const
+    {
+        return m_init_level;
+    }
+
+    size_t VolatilityTarget::num_time_steps() const
+    {
+        return m_num_time_steps;
+    }
+
+    double VolatilityTarget::rebalance_time_step() const
+    {
+        return m_dt;
+    }
+
+    double VolatilityTarget::compute_vt_level(const std::vector<double>& stock_path) const
+    {
+        ASSERT(stock_path.size() == m_num_time_steps + 1, "stock_path size should be num_time_step + 1");
+        const double rate_dt = m_sde->discount_rate() * m_dt;
+        double level = m_init_level;
+        double var = m_init_var;
+        for (size_t i = 1; i < stock_path.size(); ++i)
+        {
+            const double ret = stock_path[i] / stock_path[i - 1] - 1.0;
+            const double w = m_target_vol / std::sqrt(var);
+            level *= 1.0 + (1.0 - w) * rate_dt + w * ret;
+            var = m_lamb * var + (1.0 - m_lamb) * ret * ret / m_dt;
+        }
+        return level;
+    }
+
+    void VolatilityTarget::advance_vt_path(double& level, double& var, const double* normals, const size_t num_steps) const
+    {
+        const double vol = m_sde->volatility();
+        const double drift_dt = (m_sde->discount_rate() - m_sde->repo_rate() - 0.5 * vol * vol) * m_dt;
+        const double vol_sqrt_dt = vol * std::sqrt(m_dt);
+        const double rate_dt = m_sde->discount_rate() * m_dt;
+        const double var_weight = (1.0 - m_lamb) / m_dt;
+        for (size_t i = 0; i < num_steps; ++i)
+        {
+            const double ret = std::expm1(drift_dt + vol_sqrt_dt * normals[i]);
+            const double w = m_target_vol / std::sqrt(var);
+            level *= 1.0 + (1.0 - w) * rate_dt + w * ret;
+            var = m_lamb * var + var_weight * ret * ret;
+        }
+    }
+
+    double VolatilityTarget::simulate_vt_level(StandardNormalGenerator& rng) const
+    {
+        double normals[BATCH_STEPS];
+        double level = m_init_level;
+        double var = m_init_var;
+        for (size_t step = 0; step < m_num_time_steps; step += BATCH_STEPS)
+        {
+            const size_t num_steps = std::min(BATCH_STEPS, m_num_time_steps - step);
+            CLTVT_TIME_PHASE(SimulationPhase::RNG, rng.generate(normals, num_steps));
+            CLTVT_TIME_PHASE(SimulationPhase::VT_RECURSION, advance_vt_path(level, var, normals, num_steps));
+        }
+        return level;
+    }
+
+    double VolatilityTarget::simulate_vt_level(const PathNormalGenerator& rng, const size_t path) const
+    {
+        double normals[BATCH_STEPS];
+        double level = m_init_level;
+        double var = m_init_var;
+        for (size_t step = 0; step < m_num_time_steps; step += BATCH_STEPS)
+        {
+            const size_t num_steps = std::min(BATCH_STEPS, m_num_time_steps - step);
+            CLTVT_TIME_PHASE(SimulationPhase::RNG, rng.generate(path, step, normals, num_steps));
+            CLTVT_TIME_PHASE(SimulationPhase::VT_RECURSION, advance_vt_path(level, var, normals, num_steps));
+        }
+        return level;
+    }
+
+    double VolatilityTarget::simulate_vt_level(SobolPathGenerator& rng) const
+    {
+        ASSERT(rng.size() == m_num_time_steps, "rng must generate num_time_steps normals per path");
+        double level = m_init_level;
+        double var = m_init_var;
+        advance_vt_path(level, var, rng.next_path(), m_num_time_steps);
+        return level;
+    }
+
+    void VolatilityTarget::advance_vt_path_derivatives(double* state, const double* normals, const size_t num_steps) const
+    {
+        double rets[BATCH_STEPS];
+        double d_rets[2 * BATCH_STEPS];
+        const double var_weight = (1.0 - m_lamb) / m_dt;
+        stock_returns(*m_sde, m_dt, normals, num_steps, rets, d_rets);
+        scalar_kernels().advance_vt_derivatives(
+            state,
+            1,
+            rets,
+            d_rets,
+            num_steps,
+            m_dt,
+            m_sde->discount_rate() * m_dt,
+            &m_target_vol,
+            &m_lamb,
+            &var_weight
+        );
+    }
+
+    PathwiseLevel VolatilityTarget::simulate_vt_level_with_derivatives(StandardNormalGenerator& rng) const
+    {
+        double normals[BATCH_STEPS];
+        double state[6] = { m_init_level, m_init_var, 0.0, 0.0, 0.0, 0.0 };
+        for (size_t step = 0; step < m_num_time_steps; step += BATCH_STEPS)
+        {
+            const size_t num_steps = std::min(BATCH_STEPS, m_num_time_steps - step);
+            rng.generate(normals, num_steps);
+            advance_vt_path_derivatives(state, normals, num_steps);
+        }
+        return PathwiseLevel{ state[0], state[2], state[4], state[0] / m_init_level };
+    }
+
+    CallSensitivities VolatilityTarget::simulate_call_sensitivities(
+        const double strike,
+        const size_t num_samples,
+        const size_t seed
+    ) const
+    {
+        CallSensitivities sensitivities;
+        const double discount_factor = std::exp(-m_sde->discount_rate() * m_tenor);
+        StandardNormalGenerator rng(seed);
+        for (size_t i = 0; i < num_samples; ++i)
+            add_call_sample(sensitivities, simulate_vt_level_with_derivatives(rng), strike, discount_factor, m_tenor);
+        return sensitivities;
+    }
+
+    void VolatilityTarget::add_call_gradient(CallGradient& gradient, const double strike, double* tape) const
+    {
+        const double* normals = tape;
+        double* rets = tape + m_num_time_steps;
+        double* vars = tape + 2 * m_num_time_steps;
+        double* levels = tape + 3 * m_num_time_steps;
+        const double vol = m_sde->volatility();
+        const double drift_dt = (m_sde->discount_rate() - m_sde->repo_rate() - 0.5 * vol * vol) * m_dt;
+        const double vol_sqrt_dt = vol * std::sqrt(m_dt);
+        const double rate_dt = m_sde->discount_rate() * m_dt;
+        const double var_weight = (1.0 - m_lamb) / m_dt;
+
+        double level = m_init_level;
+        double var = m_init_var;
+        for (size_t i = 0; i < m_num_time_steps; ++i)
+        {
+            const double ret = std::expm1(drift_dt + vol_sqrt_dt * normals[i]);
+            const double w = m_target_vol / std::sqrt(var);
+            rets[i] = ret;
+            vars[i] = var;
+            levels[i] = level;
+            level *= 1.0 + (1.0 - w) * rate_dt + w * ret;
+            var = m_lamb * var + var_weight * ret * ret;
+        }
+
+        const double discount_factor = std::exp(-m_sde->discount_rate() * m_tenor);
+        const double in_the_money = level > strike ? discount_factor : 0.0;
+        const double price = in_the_money * (level - strike);
+        double level_bar = in_the_money;
+        double var_bar = 0.0;
+        double drift_dt_bar = 0.0;
+        double vol_sqrt_dt_bar = 0.0;
+        double rate_dt_bar = 0.0;
+        double lamb_bar = 0.0;
+        double var_weight_bar = 0.0;
+        double target_vol_bar = 0.0;
+        for (size_t i = m_num_time_steps; i-- > 0;)
+        {
+            const double ret = rets[i];
+            const double w = m_target_vol / std::sqrt(vars[i]);
+            const double growth_bar = level_bar * levels[i];
+            const double ret_bar = var_bar * 2.0 * var_weight * ret + growth_bar * w;
+            const double w_bar = growth_bar * (ret - rate_dt);
+            const double x_bar = ret_bar * (1.0 + ret);
+            level_bar *= 1.0 + (1.0 - w) * rate_dt + w * ret;
+            lamb_bar += var_bar * vars[i];
+            var_weight_bar += var_bar * ret * ret;
+            rate_dt_bar += growth_bar * (1.0 - w);
+            target_vol_bar += w_bar * w / m_target_vol;
+            var_bar = m_lamb * var_bar - 0.5 * w_bar * w / vars[i];
+            drift_dt_bar += x_bar;
+            vol_sqrt_dt_bar += x_bar * normals[i];
+        }
+
+        gradient.price.add(price);
+        gradient.discount_rate.add((drift_dt_bar + rate_dt_bar) * m_dt - m_tenor * price);
+        gradient.repo_rate.add(-drift_dt_bar * m_dt);
+        gradient.volatility.add(-drift_dt_bar * vol * m_dt + vol_sqrt_dt_bar * std::sqrt(m_dt));
+        gradient.lambda.add(lamb_bar - var_weight_bar / m_dt);
+        gradient.target_volatility.add(target_vol_bar);
+        gradient.init_var.add(var_bar);
+        gradient.init_level.add(level_bar);
+    }
+
+    CallGradient VolatilityTarget::simulate_call_gradient(
+        const double strike,
+        const size_t num_samples,
+        const size_t seed,
+        SimulationWorkspace& workspace
+    ) const
+    {
+        const SimulationWorkspace::Frame frame(workspace);
+        double* tape = workspace.allocate<double>(4 * m_num_time_steps);
+        CallGradient gradient;
+        StandardNormalGenerator rng(seed);
+        for (size_t i = 0; i < num_samples; ++i)
+        {
+            rng.generate(tape, m_num_time_steps);
+            add_call_gradient(gradient, strike, tape);
+        }
+        return gradient;
+    }
+
+    CallGradient VolatilityTarget::simulate_call_gradient_parallel(
+        const double strike,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        const PathNormalGenerator rng(seed);
+        auto simulate_range = [&](const size_t begin, const size_t end, CallGradient& partial) {
+            SimulationWorkspace& workspace = thread_workspace();
+            const SimulationWorkspace::Frame frame(workspace);
+            double* tape = workspace.allocate<double>(4 * m_num_time_steps);
+            for (size_t i = begin; i < end; ++i)
+            {
+                rng.generate(i, 0, tape, m_num_time_steps);
+                add_call_gradient(partial, strike, tape);
+            }
+        };
+        std::vector<CallGradient> partials(num_partial_ranges(num_samples));
+        simulate_partials(partials, num_samples, num_threads, simulate_range);
+        CallGradient gradient;
+        for (const CallGradient& partial : partials)
+            gradient.merge(partial);
+        return gradient;
+    }
+
+    void VolatilityTarget::add_call_cv_samples(
+        RunningCovariance& samples,
+        RunningStatistics& paths,
+        const double strike,
+        const PathNormalGenerator& rng,
+        const size_t begin,
+        const size_t end,
+        const bool antithetic
+    ) const
+    {
+        const double vol = m_sde->volatility();
+        const double leverage = m_target_vol / vol;
+        const double control_drift = (m_sde->discount_rate() - leverage * m_sde->repo_rate() - 0.5 * leverage * leverage * vol * vol) * m_tenor;
+        const double control_vol_sqrt_dt = leverage * vol * std::sqrt(m_dt);
+        const double discount_factor = std::exp(-m_sde->discount_rate() * m_tenor);
+        double normals[BATCH_STEPS];
+        for (size_t i = begin; i < end; ++i)
+        {
+            double level = m_init_level;
+            double var = m_init_var;
+            double mirror_level = m_init_level;
+            double mirror_var = m_init_var;
+            double sum_normals = 0.0;
+            for (size_t step = 0; step < m_num_time_steps; step += BATCH_STEPS)
+            {
+                const size_t num_steps = std::min(BATCH_STEPS, m_num_time_steps - step);
+                rng.generate(i, step, normals, num_steps);
+                advance_vt_path(level, var, normals, num_steps);
+                for (size_t j = 0; j < num_steps; ++j)
+                    sum_normals += normals[j];
+                if (antithetic)
+                {
+                    for (size_t j = 0; j < num_steps; ++j)
+                        normals[j] = -normals[j];
+                    advance_vt_path(mirror_level, mirror_var, normals, num_steps);
+                }
+            }
+            const double payoff = discount_factor * std::max(level - strike, 0.0);
+            const double control = discount_factor * std::max(m_init_level * std::exp(control_drift + control_vol_sqrt_dt * sum_normals) - strike, 0.0);
+            paths.add(payoff);
+            if (antithetic)
+            {
+                const double mirror_payoff = discount_factor * std::max(mirror_level - strike, 0.0);
+                const double mirror_control = discount_factor * std::max(m_init_level * std::exp(control_drift - control_vol_sqrt_dt * sum_normals) - strike, 0.0);
+                paths.add(mirror_payoff);
+                samples.add(0.5 * (control + mirror_control), 0.5 * (payoff + mirror_payoff));
+            }
+            else
+                samples.add(control, payoff);
+        }
+    }
+
+    ControlVariatePrice VolatilityTarget::simulate_call_price_cv(
+        RunningCovariance& samples,
+        RunningStatistics& paths,
+        const double strike,
+        const size_t first_sample,
+        const size_t num_samples,
+        const bool antithetic,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        const PathNormalGenerator rng(seed);
+        auto simulate_range = [&](const size_t begin, const size_t end, ControlVariateSamples& partial) {
+            add_call_cv_samples(partial.samples, partial.paths, strike, rng, first_sample + begin, first_sample + end, antithetic);
+        };
+        std::vector<ControlVariateSamples> partials(num_partial_ranges(num_samples));
+        simulate_partials(partials, num_samples, num_threads, simulate_range);
+        for (const ControlVariateSamples& partial : partials)
+        {
+            samples.merge(partial.samples);
+            paths.merge(partial.paths);
+        }
+
+        const double leverage = m_target_vol / m_sde->volatility();
+        const BlackScholes control_sde(m_sde->discount_rate(), leverage * m_sde->repo_rate(), leverage * m_sde->volatility(), m_init_level);
+        const size_t n = samples.count();
+        ControlVariatePrice result;
+        result.control_price = control_sde.get_call_price(strike, m_tenor);
+        result.beta = samples.covariance() / samples.variance_x();
+        result.price = samples.mean_y() - result.beta * (samples.mean_x() - result.control_price);
+        const double residual_variance = (samples.variance_y() - result.beta * samples.covariance()) * (n - 1) / (n - 2);
+        result.standard_error = std::sqrt(residual_variance / n);
+        result.plain_price = paths.mean();
+        result.plain_standard_error = paths.standard_error();
+        result.num_paths = paths.count();
+        return result;
+    }
+
+    ControlVariatePrice VolatilityTarget::simulate_call_price_cv(
+        const double strike,
+        const size_t num_samples,
+        const bool antithetic,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        ASSERT(num_samples > 2, "num_samples > 2 must be true");
+        RunningCovariance samples;
+        RunningStatistics paths;
+        return simulate_call_price_cv(samples, paths, strike, 0, num_samples, antithetic, num_threads, seed);
+    }
+
+    ControlVariatePrice VolatilityTarget::simulate_call_price_cv_to_tolerance(
+        const double strike,
+        const double target_standard_error,
+        const size_t max_samples,
+        const bool antithetic,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        ASSERT(target_standard_error > 0.0, "target_standard_error must be positive");
+        ASSERT(max_samples > 2, "max_samples > 2 must be true");
+        RunningCovariance samples;
+        RunningStatistics paths;
+        const size_t pilot_samples = std::min(max_samples, SIMULATION_BLOCK_SIZE);
+        ControlVariatePrice result = simulate_call_price_cv(samples, paths, strike, 0, pilot_samples, antithetic, num_threads, seed);
+        while (result.standard_error > target_standard_error && samples.count() < max_samples)
+        {
+            const double ratio = result.standard_error / target_standard_error;
+            const size_t needed = size_t(std::ceil(1.1 * ratio * ratio * samples.count()));
+            const size_t num_samples = std::min(std::max(needed, samples.count() + 1) - samples.count(), max_samples - samples.count());
+            result = simulate_call_price_cv(samples, paths, strike, samples.count(), num_samples, antithetic, num_threads, seed);
+        }
+        return result;
+    }
+
+    void VolatilityTarget::advance_vt_batch(double* levels, double* vars, const double* normals, const size_t num_steps) const
+    {
+        const double vol = m_sde->volatility();
+        simd_kernels().advance_vt_lanes(
+            levels,
+            vars,
+            normals,
+            num_steps,
+            BATCH_LANES,
+            (m_sde->discount_rate() - m_sde->repo_rate() - 0.5 * vol * vol) * m_dt,
+            vol * std::sqrt(m_dt),
+            m_sde->discount_rate() * m_dt,
+            m_target_vol,
+            m_lamb,
+            (1.0 - m_lamb) / m_dt
+        );
+    }
+
+    void VolatilityTarget::simulate_vt_batch(const PathNormalGenerator& rng, const size_t first_path, double* levels) const
+    {
+        double vars[BATCH_LANES];
+        double normals[BATCH_STEPS * BATCH_LANES];
+        std::fill(levels, levels + BATCH_LANES, m_init_level);
+        std::fill(vars, vars + BATCH_LANES, m_init_var);
+        for (size_t step = 0; step < m_num_time_steps; step += BATCH_STEPS)
+        {
+            const size_t num_steps = std::min(BATCH_STEPS, m_num_time_steps - step);
+            CLTVT_TIME_PHASE(SimulationPhase::RNG, rng.generate_paths(first_path, BATCH_LANES, step, num_steps, normals));
+            CLTVT_TIME_PHASE(SimulationPhase::VT_RECURSION, advance_vt_batch(levels, vars, normals, num_steps));
+        }
+    }
+
+    void VolatilityTarget::simulate_vt_levels(std::vector<double>& vt_levels, const size_t num_samples, const size_t seed) const
+    {
+        CLTVT_COUNT_ALLOCATION(vt_levels, num_samples);
+        vt_levels.resize(0);
+        vt_levels.reserve(num_samples);
+        StandardNormalGenerator rng(seed);
+        for (size_t i = 0; i < num_samples; ++i)
+        {
+            const double level = simulate_vt_level(rng);
+            CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, vt_levels.push_back(level));
+        }
+        CLTVT_COUNT_PATHS(num_samples);
+    }
+
+    void VolatilityTarget::simulate_vt_levels(Accumulator& acc, const size_t num_samples, const size_t seed) const
+    {
+        StandardNormalGenerator rng(seed);
+        for (size_t i = 0; i < num_samples; ++i)
+        {
+            const double level = simulate_vt_level(rng);
+            CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, acc.add(level));
+        }
+        CLTVT_COUNT_PATHS(num_samples);
+    }
+
+    void VolatilityTarget::simulate_vt_levels_parallel(
+        std::vector<double>& vt_levels,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        CLTVT_COUNT_ALLOCATION(vt_levels, num_samples);
+        vt_levels.resize(num_samples);
+        const PathNormalGenerator rng(seed);
+        auto simulate_block = [&](const size_t block, const size_t) {
+            const size_t begin = block * SIMULATION_BLOCK_SIZE;
+            const size_t end = std::min(begin + SIMULATION_BLOCK_SIZE, num_samples);
+            for (size_t i = begin; i < end; ++i)
+            {
+                const double level = simulate_vt_level(rng, i);
+                CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, vt_levels[i] = level);
+            }
+            CLTVT_COUNT_PATHS(end - begin);
+        };
+        ThreadPool::instance().run(num_blocks(num_samples), num_threads, simulate_block);
+    }
+
+    void VolatilityTarget::simulate_vt_levels_parallel(
+        Accumulator& acc,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        const PathNormalGenerator rng(seed);
+        auto simulate_range = [&](const size_t begin, const size_t end, Accumulator& partial) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const double level = simulate_vt_level(rng, i);
+                CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, partial.add(level));
+            }
+            CLTVT_COUNT_PATHS(end - begin);
+        };
+        accumulate_parallel(acc, num_samples, num_threads, simulate_range);
+    }
+
+    void VolatilityTarget::simulate_vt_levels_batch(
+        std::vector<double>& vt_levels,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        CLTVT_COUNT_ALLOCATION(vt_levels, num_samples);
+        vt_levels.resize(num_samples);
+        const PathNormalGenerator rng(seed);
+        auto simulate_block = [&](const size_t block, const size_t) {
+            double levels[BATCH_LANES];
+            const size_t begin = block * SIMULATION_BLOCK_SIZE;
+            const size_t end = std::min(begin + SIMULATION_BLOCK_SIZE, num_samples);
+            for (size_t first = begin; first < end; first += BATCH_LANES)
+            {
+                simulate_vt_batch(rng, first, levels);
+                CLTVT_TIME_PHASE(
+                    SimulationPhase::OUTPUT,
+                    std::copy(levels, levels + std::min(BATCH_LANES, end - first), vt_levels.begin() + first)
+                );
+            }
+            CLTVT_COUNT_PATHS(end - begin);
+        };
+        ThreadPool::instance().run(num_blocks(num_samples), num_threads, simulate_block);
+    }
+
+    void VolatilityTarget::simulate_vt_levels_batch(
+        Accumulator& acc,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        const PathNormalGenerator rng(seed);
+        auto simulate_range = [&](const size_t begin, const size_t end, Accumulator& partial) {
+            double levels[BATCH_LANES];
+            for (size_t first = begin; first < end; first += BATCH_LANES)
+            {
+                simulate_vt_batch(rng, first, levels);
+                const size_t num_lanes = std::min(BATCH_LANES, end - first);
+                CLTVT_TIME_PHASE(SimulationPhase::OUTPUT, for (size_t lane = 0; lane < num_lanes; ++lane) partial.add(levels[lane]));
+            }
+            CLTVT_COUNT_PATHS(end - begin);
+        };
+        accumulate_parallel(acc, num_samples, num_threads, simulate_range);
+    }
+
+    void VolatilityTarget::simulate_vt_levels_sobol(
+        const std::vector<AccumulatorPtr>& replications,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        const std::vector<double> dtimes(m_num_time_steps, m_dt);
+        auto simulate_replication = [&](const size_t replication, const size_t) {
+            SobolPathGenerator rng(dtimes, seed, replication);
+            for (size_t i = 0; i < num_samples; ++i)
+                replications[replication]->add(simulate_vt_level(rng));
+        };
+        ThreadPool::instance().run(replications.size(), num_threads, simulate_replication);
+    }
+
+    VolatilityTargetSweep::VolatilityTargetSweep(const std::vector<VolatilityTarget>& targets)
+        :
+        m_targets(targets)
+    {
+        ASSERT(!m_targets.empty(), "targets must not be empty");
+        const VolatilityTarget& first = m_targets.front();
+        for (const VolatilityTarget& vt : m_targets)
+        {
+            ASSERT(
+                vt.sde()->discount_rate() == first.sde()->discount_rate() && vt.sde()->repo_rate() == first.sde()->repo_rate()
+                    && vt.sde()->volatility() == first.sde()->volatility(),
+                "targets must have the same sde parameters"
+            );
+            ASSERT(vt.tenor() == first.tenor(), "targets must have the same tenor");
+            ASSERT(vt.num_time_steps() == first.num_time_steps(), "targets must have the same num_time_steps");
+        }
+
+        m_num_lanes = (m_targets.size() + MAX_SIMD_WIDTH - 1) / MAX_SIMD_WIDTH * MAX_SIMD_WIDTH;
+        for (size_t lane = 0; lane < m_num_lanes; ++lane)
+        {
+            const VolatilityTarget& vt = m_targets[std::min(lane, m_targets.size() - 1)];
+            m_target_vols.push_back(vt.target_volatility());
+            m_lambs.push_back(vt.lambda());
+            m_var_weights.push_back((1.0 - vt.lambda()) / vt.rebalance_time_step());
+            m_init_levels.push_back(vt.init_level());
+            m_init_vars.push_back(vt.init_var());
+        }
+    }
+
+    size_t VolatilityTargetSweep::size() const
+    {
+        return m_targets.size();
+    }
+
+    const VolatilityTarget& VolatilityTargetSweep::target(const size_t i) const
+    {
+        return m_targets[i];
+    }
+
+    void VolatilityTargetSweep::advance_vt_paths(double* levels, double* vars, const double* normals, const size_t num_steps) const
+    {
+        const BlackScholesPtr& sde = m_targets.front().sde();
+        const double dt = m_targets.front().rebalance_time_step();
+        const double vol = sde->volatility();
+        const double drift_dt = (sde->discount_rate() - sde->repo_rate() - 0.5 * vol * vol) * dt;
+        const double vol_sqrt_dt = vol * std::sqrt(dt);
+        double rets[BATCH_STEPS];
+        for (size_t i = 0; i < num_steps; ++i)
+            rets[i] = std::expm1(drift_dt + vol_sqrt_dt * normals[i]);
+        simd_kernels().advance_vt_sweep(
+            levels,
+            vars,
+            rets,
+            num_steps,
+            m_num_lanes,
+            sde->discount_rate() * dt,
+            m_target_vols.data(),
+            m_lambs.data(),
+            m_var_weights.data()
+        );
+    }
+
+    void VolatilityTargetSweep::simulate_path(double* levels, double* vars, StandardNormalGenerator& rng) const
+    {
+        double normals[BATCH_STEPS];
+        const size_t num_time_steps = m_targets.front().num_time_steps();
+        std::copy(m_init_levels.begin(), m_init_levels.end(), levels);
+        std::copy(m_init_vars.begin(), m_init_vars.end(), vars);
+        for (size_t step = 0; step < num_time_steps; step += BATCH_STEPS)
+        {
+            const size_t num_steps = std::min(BATCH_STEPS, num_time_steps - step);
+            rng.generate(normals, num_steps);
+            advance_vt_paths(levels, vars, normals, num_steps);
+        }
+    }
+
+    void VolatilityTargetSweep::simulate_path(double* levels, double* vars, const PathNormalGenerator& rng, const size_t path) const
+    {
+        double normals[BATCH_STEPS];
+        const size_t num_time_steps = m_targets.front().num_time_steps();
+        std::copy(m_init_levels.begin(), m_init_levels.end(), levels);
+        std::copy(m_init_vars.begin(), m_init_vars.end(), vars);
+        for (size_t step = 0; step < num_time_steps; step += BATCH_STEPS)
+        {
+            const size_t num_steps = std::min(BATCH_STEPS, num_time_steps - step);
+            rng.generate(path, step, normals, num_steps);
+            advance_vt_paths(levels, vars, normals, num_steps);
+        }
+    }
+
+    void VolatilityTargetSweep::advance_vt_path_derivatives(double* state, const double* normals, const size_t num_steps) const
+    {
+        double rets[BATCH_STEPS];
+        double d_rets[2 * BATCH_STEPS];
+        const VolatilityTarget& first = m_targets.front();
+        const double dt = first.rebalance_time_step();
+        stock_returns(*first.sde(), dt, normals, num_steps, rets, d_rets);
+        simd_kernels().advance_vt_derivatives(
+            state,
+            m_num_lanes,
+            rets,
+            d_rets,
+            num_steps,
+            dt,
+            first.sde()->discount_rate() * dt,
+            m_target_vols.data(),
+            m_lambs.data(),
+            m_var_weights.data()
+        );
+    }
+
+    void VolatilityTargetSweep::simulate_vt_levels(
+        double* vt_levels,
+        StandardNormalGenerator& rng,
+        SimulationWorkspace& workspace
+    ) const
+    {
+        const SimulationWorkspace::Frame frame(workspace);
+        double* levels = workspace.allocate<double>(m_num_lanes);
+        double* vars = workspace.allocate<double>(m_num_lanes);
+        simulate_path(levels, vars, rng);
+        std::copy(levels, levels + size(), vt_levels);
+    }
+
+    void VolatilityTargetSweep::simulate_vt_levels(
+        double* vt_levels,
+        const PathNormalGenerator& rng,
+        const size_t path,
+        SimulationWorkspace& workspace
+    ) const
+    {
+        const SimulationWorkspace::Frame frame(workspace);
+        double* levels = workspace.allocate<double>(m_num_lanes);
+        double* vars = workspace.allocate<double>(m_num_lanes);
+        simulate_path(levels, vars, rng, path);
+        std::copy(levels, levels + size(), vt_levels);
+    }
+
+    void VolatilityTargetSweep::simulate_vt_levels(
+        const std::vector<AccumulatorPtr>& accs,
+        const size_t num_samples,
+        const size_t seed,
+        SimulationWorkspace& workspace
+    ) const
+    {
+        ASSERT(accs.size() == size(), "accs must hold one accumulator per target");
+        const SimulationWorkspace::Frame frame(workspace);
+        double* levels = workspace.allocate<double>(m_num_lanes);
+        double* vars = workspace.allocate<double>(m_num_lanes);
+        StandardNormalGenerator rng(seed);
+        for (size_t i = 0; i < num_samples; ++i)
+        {
+            simulate_path(levels, vars, rng);
+            for (size_t j = 0; j < size(); ++j)
+                accs[j]->add(levels[j]);
+        }
+    }
+
+    void VolatilityTargetSweep::simulate_vt_levels_parallel(
+        const std::vector<AccumulatorPtr>& accs,
+        const size_t num_samples,
+        const size_t num_threads,
+        const size_t seed
+    ) const
+    {
+        ASSERT(accs.size() == size(), "accs must hold one accumulator per target");
+        const PathNormalGenerator rng(seed);
+        auto simulate_range = [&](const size_t begin, const size_t end, const std::vector<AccumulatorPtr>& partials) {
+            SimulationWorkspace& workspace = thread_workspace();
+            const SimulationWorkspace::Frame frame(workspace);
+            double* levels = workspace.allocate<double>(m_num_lanes);
+            double* vars = workspace.allocate<double>(m_num_lanes);
+            for (size_t i = begin; i < end; ++i)
+            {
+                simulate_path(levels, vars, rng, i);
+                for (size_t j = 0; j < size(); ++j)
+                    partials[j]->add(levels[j]);
+            }
+        };
+        accumulate_parallel(accs, num_samples, num_threads, simulate_range);
+    }
+
+    std::vector<CallSensitivities> VolatilityTargetSweep::simulate_call_sensitivities(
+        const double strike,
+        const size_t num_samples,
+        const size_t seed,
+        SimulationWorkspace& workspace
+    ) const
+    {
+        std::vector<CallSensitivities> sensitivities(size());
+        const VolatilityTarget& first = m_targets.front();
+        const size_t num_time_steps = first.num_time_steps();
+        const double discount_factor = std::exp(-first.sde()->discount_rate() * first.tenor());
+        const SimulationWorkspace::Frame frame(workspace);
+        double* state = workspace.allocate<double>(6 * m_num_lanes);
+        double normals[BATCH_STEPS];
+        StandardNormalGenerator rng(seed);
+        for (size_t i = 0; i < num_samples; ++i)
+        {
+            std::copy(m_init_levels.begin(), m_init_levels.end(), state);
+            std::copy(m_init_vars.begin(), m_init_vars.end(), state + m_num_lanes);
+            std::fill(state + 2 * m_num_lanes, state + 6 * m_num_lanes, 0.0);
+            for (size_t step = 0; step < num_time_steps; step += BATCH_STEPS)
+            {
+                const size_t num_steps = std::min(BATCH_STEPS, num_time_steps - step);
+                rng.generate(normals, num_steps);
+                advance_vt_path_derivatives(state, normals, num_steps);
+            }
+            for (size_t j = 0; j < size(); ++j)
+            {
+                const PathwiseLevel path{
+                    state[j],
+                    state[2 * m_num_lanes + j],
+                    state[4 * m_num_lanes + j],
+                    state[j] / m_targets[j].init_level()
+                };
+                add_call_sample(sensitivities[j], path, strike, discount_factor, first.tenor());
+            }
+        }
+        return sensitivities;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <workspace.hpp>
+#include <algorithm>
+
+namespace cltvt
+{
+    namespace
+    {
+        const size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+        size_t round_up(const size_t bytes)
+        {
+            const size_t alignment = SimulationWorkspace::ALIGNMENT;
+            return (bytes + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    SimulationWorkspace::Frame::Frame(SimulationWorkspace& workspace)
+        :
+        m_workspace(workspace),
+        m_chunk(workspace.m_chunk),
+        m_offset(workspace.m_offset)
+    {
+        ++m_workspace.m_num_frames;
+    }
+
+    SimulationWorkspace::Frame::~Frame()
+    {
+        --m_workspace.m_num_frames;
+        m_workspace.release(m_chunk, m_offset);
+    }
+
+    SimulationWorkspace::SimulationWorkspace(const size_t initial_bytes)
+        :
+        m_chunk(0),
+        m_offset(0),
+        m_num_frames(0),
+        m_num_heap_allocations(0)
+    {
+        if (initial_bytes > 0)
+            add_chunk(initial_bytes);
+    }
+
+    SimulationWorkspacePtr SimulationWorkspace::create(const size_t initial_bytes)
+    {
+        return std::make_shared<SimulationWorkspace>(initial_bytes);
+    }
+
+    size_t SimulationWorkspace::capacity() const
+    {
+        size_t bytes = 0;
+        for (const Chunk& chunk : m_chunks)
+            bytes += chunk.size;
+        return bytes;
+    }
+
+    size_t SimulationWorkspace::num_heap_allocations() const
+    {
+        return m_num_heap_allocations;
+    }
+
+    void SimulationWorkspace::add_chunk(const size_t bytes)
+    {
+        Chunk chunk;
+        chunk.size = round_up(bytes);
+        chunk.storage.reset(new char[chunk.size + ALIGNMENT - 1]);
+        const size_t address = reinterpret_cast<size_t>(chunk.storage.get());
+        chunk.data = chunk.storage.get() + (round_up(address) - address);
+        m_chunks.push_back(std::move(chunk));
+        ++m_num_heap_allocations;
+    }
+
+    void* SimulationWorkspace::allocate_bytes(const size_t bytes)
+    {
+        ASSERT(m_num_frames > 0, "workspace allocations must be made inside a SimulationWorkspace::Frame");
+        const size_t size = round_up(std::max(bytes, size_t(1)));
+        // Chunks after the current one are free, only used once the current one is full.
+        while (m_chunk < m_chunks.size() && m_offset + size > m_chunks[m_chunk].size)
+        {
+            ++m_chunk;
+            m_offset = 0;
+        }
+        if (m_chunk == m_chunks.size())
+            add_chunk(std::max(size, std::max(capacity(), MIN_CHUNK_BYTES)));
+        void* data = m_chunks[m_chunk].data + m_offset;
+        m_offset += size;
+        return data;
+    }
+
+    void SimulationWorkspace::release(const size_t chunk, const size_t offset)
+    {
+        m_chunk = chunk;
+        m_offset = offset;
+        if (m_num_frames == 0 && m_chunks.size() > 1)
+        {
+            const size_t bytes = capacity();
+            m_chunks.clear();
+            add_chunk(bytes);
+            m_chunk = 0;
+            m_offset = 0;
+        }
+    }
+
+    SimulationWorkspace& thread_workspace()
+    {
+        thread_local SimulationWorkspace workspace;
+        return workspace;
+    }
+}
\ No newline at end of file